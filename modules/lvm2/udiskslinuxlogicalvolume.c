@@ -474,21 +474,26 @@ wait_for_logical_volume_object (UDisksDaemon *daemon,
 static const gchar *
 wait_for_logical_volume_path (UDisksLinuxVolumeGroupObject  *group_object,
                               const gchar                   *name,
+                              GDBusMethodInvocation         *invocation,
                               GError                       **error)
 {
   struct WaitData data;
   UDisksDaemon *daemon;
   UDisksObject *volume_object;
+  GCancellable *cancellable;
 
   data.group_object = group_object;
   data.name = name;
   daemon = udisks_linux_volume_group_object_get_daemon (group_object);
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   volume_object = udisks_daemon_wait_for_object_sync (daemon,
                                                       wait_for_logical_volume_object,
                                                       &data,
                                                       NULL,
                                                       10, /* timeout_seconds */
+                                                      cancellable,
                                                       error);
+  g_object_unref (cancellable);
   if (volume_object == NULL)
     return NULL;
 
@@ -571,7 +576,7 @@ handle_rename (UDisksLogicalVolume   *_volume,
       goto out;
     }
 
-  lv_objpath = wait_for_logical_volume_path (group_object, new_name, &error);
+  lv_objpath = wait_for_logical_volume_path (group_object, new_name, invocation, &error);
   if (lv_objpath == NULL)
     {
       g_prefix_error (&error,
@@ -736,6 +741,7 @@ handle_activate (UDisksLogicalVolume *_volume,
                  GVariant *options)
 {
   GError *error = NULL;
+  GCancellable *cancellable;
   UDisksLinuxLogicalVolume *volume = UDISKS_LINUX_LOGICAL_VOLUME (_volume);
   UDisksLinuxLogicalVolumeObject *object = NULL;
   UDisksDaemon *daemon;
@@ -802,12 +808,15 @@ handle_activate (UDisksLogicalVolume *_volume,
       goto out;
     }
 
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   block_object = udisks_daemon_wait_for_object_sync (daemon,
                                                      wait_for_logical_volume_block_object,
                                                      object,
                                                      NULL,
                                                      10, /* timeout_seconds */
+                                                     cancellable,
                                                      &error);
+  g_object_unref (cancellable);
   if (block_object == NULL)
     {
       g_prefix_error (&error,
@@ -999,7 +1008,7 @@ handle_create_snapshot (UDisksLogicalVolume   *_volume,
       goto out;
     }
 
-  lv_objpath = wait_for_logical_volume_path (group_object, name, &error);
+  lv_objpath = wait_for_logical_volume_path (group_object, name, invocation, &error);
   if (lv_objpath == NULL)
     {
       g_prefix_error (&error,
@@ -208,6 +208,7 @@ handle_volume_group_create (UDisksManagerLVM2     *_object,
                             GVariant              *arg_options)
 {
   UDisksLinuxManagerLVM2 *manager = UDISKS_LINUX_MANAGER_LVM2(_object);
+  GCancellable *cancellable;
   uid_t caller_uid;
   GError *error = NULL;
   GList *blocks = NULL;
@@ -334,12 +335,15 @@ handle_volume_group_create (UDisksManagerLVM2     *_object,
     }
 
   /* ... then, sit and wait for the object to show up */
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   group_object = udisks_daemon_wait_for_object_sync (manager->daemon,
                                                      wait_for_volume_group_object,
                                                      (gpointer) arg_name,
                                                      NULL,
                                                      10, /* timeout_seconds */
+                                                     cancellable,
                                                      &error);
+  g_object_unref (cancellable);
   if (group_object == NULL)
     {
       g_prefix_error (&error,
@@ -378,6 +378,7 @@ handle_rename (UDisksVolumeGroup     *_group,
                GVariant              *options)
 {
   GError *error = NULL;
+  GCancellable *cancellable;
   UDisksLinuxVolumeGroup *group = UDISKS_LINUX_VOLUME_GROUP (_group);
   UDisksLinuxVolumeGroupObject *object = NULL;
   UDisksDaemon *daemon;
@@ -442,12 +443,15 @@ handle_rename (UDisksVolumeGroup     *_group,
       goto out;
     }
 
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   group_object = udisks_daemon_wait_for_object_sync (daemon,
                                                      wait_for_volume_group_object,
                                                      (gpointer) new_name,
                                                      NULL,
                                                      10, /* timeout_seconds */
+                                                     cancellable,
                                                      &error);
+  g_object_unref (cancellable);
   if (group_object == NULL)
     {
       g_prefix_error (&error,
@@ -840,21 +844,26 @@ wait_for_logical_volume_object (UDisksDaemon *daemon,
 static const gchar *
 wait_for_logical_volume_path (UDisksLinuxVolumeGroupObject  *group_object,
                               const gchar                   *name,
+                              GDBusMethodInvocation         *invocation,
                               GError                       **error)
 {
   struct WaitData data;
   UDisksDaemon *daemon;
   UDisksObject *volume_object;
+  GCancellable *cancellable;
 
   data.group_object = group_object;
   data.name = name;
   daemon = udisks_linux_volume_group_object_get_daemon (group_object);
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   volume_object = udisks_daemon_wait_for_object_sync (daemon,
                                                       wait_for_logical_volume_object,
                                                       &data,
                                                       NULL,
                                                       10, /* timeout_seconds */
+                                                      cancellable,
                                                       error);
+  g_object_unref (cancellable);
   if (volume_object == NULL)
     return NULL;
 
@@ -939,7 +948,7 @@ handle_create_plain_volume (UDisksVolumeGroup     *_group,
       goto out;
     }
 
-  lv_objpath = wait_for_logical_volume_path (object, arg_name, &error);
+  lv_objpath = wait_for_logical_volume_path (object, arg_name, invocation, &error);
   if (lv_objpath == NULL)
     {
       g_prefix_error (&error,
@@ -1055,7 +1064,7 @@ handle_create_thin_pool_volume (UDisksVolumeGroup     *_group,
       goto out;
     }
 
-  lv_objpath = wait_for_logical_volume_path (object, arg_name, &error);
+  lv_objpath = wait_for_logical_volume_path (object, arg_name, invocation, &error);
   if (lv_objpath == NULL)
     {
       g_prefix_error (&error,
@@ -1166,7 +1175,7 @@ handle_create_thin_volume (UDisksVolumeGroup     *_group,
       goto out;
     }
 
-  lv_objpath = wait_for_logical_volume_path (object, arg_name, &error);
+  lv_objpath = wait_for_logical_volume_path (object, arg_name, invocation, &error);
   if (lv_objpath == NULL)
     {
       g_prefix_error (&error,
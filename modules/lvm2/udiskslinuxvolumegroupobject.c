@@ -30,6 +30,7 @@
 #include <src/udiskslinuxprovider.h>
 #include <src/udisksdaemon.h>
 #include <src/udisksdaemonutil.h>
+#include <src/udisksmetrics.h>
 #include <src/udiskslinuxdevice.h>
 #include <src/udiskslinuxblockobject.h>
 
@@ -66,8 +67,15 @@ struct _UDisksLinuxVolumeGroupObject
   gchar *name;
 
   GHashTable *logical_volumes;
+
+  /* the block objects that were physical volumes of this group at the last update */
+  GHashTable *physical_volume_blocks;
+
   GPid poll_pid;
+  gint64 poll_start;
   guint poll_timeout_id;
+  /* kills the running poll if it takes too long, see poll_now() */
+  guint poll_watchdog_id;
   gboolean poll_requested;
 
   /* interface */
@@ -88,6 +96,16 @@ enum
 
 G_DEFINE_TYPE (UDisksLinuxVolumeGroupObject, udisks_linux_volume_group_object, UDISKS_TYPE_OBJECT_SKELETON);
 
+/* The next poll is started at least POLL_INTERVAL_FACTOR times as long
+ * as the last one took after it finished, clamped to the given bounds.
+ */
+#define POLL_MIN_INTERVAL_MSEC 5000
+#define POLL_MAX_INTERVAL_MSEC 60000
+#define POLL_INTERVAL_FACTOR 2
+
+/* A poll still running after this long is assumed to be stuck */
+#define POLL_MAX_DURATION_SEC 120
+
 static void etctabs_changed (UDisksFstabMonitor *monitor,
                              UDisksFstabEntry   *entry,
                              gpointer            user_data);
@@ -103,6 +121,7 @@ udisks_linux_volume_group_object_finalize (GObject *_object)
     g_object_unref (object->iface_volume_group);
 
   g_hash_table_unref (object->logical_volumes);
+  g_hash_table_unref (object->physical_volume_blocks);
   g_free (object->name);
 
   g_signal_handlers_disconnect_by_func (udisks_daemon_get_fstab_monitor (object->daemon),
@@ -186,6 +205,10 @@ udisks_linux_volume_group_object_constructed (GObject *_object)
                                                    g_str_equal,
                                                    g_free,
                                                    (GDestroyNotify) g_object_unref);
+  object->physical_volume_blocks = g_hash_table_new_full (g_direct_hash,
+                                                          g_direct_equal,
+                                                          (GDestroyNotify) g_object_unref,
+                                                          NULL);
 
   /* compute the object path */
   s = g_string_new ("/org/freedesktop/UDisks2/lvm/");
@@ -422,98 +445,49 @@ block_object_update_lvm_iface (UDisksLinuxBlockObject *object,
   udisks_block_lvm2_set_logical_volume (iface_block_lvm2, lv_obj_path);
 }
 
-static void
-update_block (UDisksLinuxBlockObject       *block_object,
-              UDisksLinuxVolumeGroupObject *group_object,
-              GHashTable                   *new_lvs,
-              GHashTable                   *new_pvs)
+/* Finds the block object for the physical volume with the given
+ * device file, as reported by LVM - this may also be a symlink
+ */
+static UDisksLinuxBlockObject *
+find_physical_volume_block (UDisksDaemon *daemon,
+                            const gchar  *device_file)
 {
-  UDisksBlock *block;
-  GVariant *pv_info;
-
-  block = udisks_object_peek_block (UDISKS_OBJECT (block_object));
-  if (block == NULL)
-    return;
-
-  // XXX - move this elsewhere?
-  {
-    UDisksLinuxDevice *device;
-    UDisksLinuxLogicalVolumeObject *lv_object;
-    const gchar *block_vg_name;
-    const gchar *block_lv_name;
-
-    device = udisks_linux_block_object_get_device (block_object);
-    if (device)
-      {
-        block_vg_name = g_udev_device_get_property (device->udev_device, "DM_VG_NAME");
-        block_lv_name = g_udev_device_get_property (device->udev_device, "DM_LV_NAME");
-
-        if (g_strcmp0 (block_vg_name, udisks_linux_volume_group_object_get_name (group_object)) == 0
-            && (lv_object = g_hash_table_lookup (new_lvs, block_lv_name)))
-          {
-            block_object_update_lvm_iface (block_object, g_dbus_object_get_object_path (G_DBUS_OBJECT (lv_object)));
-          }
-
-        g_object_unref(device);
-      }
-  }
-
-  pv_info = g_hash_table_lookup (new_pvs, udisks_block_get_device (block));
-  if (!pv_info)
-    {
-      const gchar *const *symlinks;
-      int i;
-      symlinks = udisks_block_get_symlinks (block);
-      for (i = 0; symlinks[i]; i++)
-        {
-          pv_info = g_hash_table_lookup (new_pvs, symlinks[i]);
-          if (pv_info)
-            break;
-        }
-    }
+  UDisksObject *object;
 
-  if (pv_info)
-    {
-      udisks_linux_block_object_update_lvm_pv (block_object, group_object, pv_info);
-    }
-  else
-    {
-      UDisksPhysicalVolume *pv = udisks_object_peek_physical_volume (UDISKS_OBJECT (block_object));
-      if (pv && g_strcmp0 (udisks_physical_volume_get_volume_group (pv),
-                           g_dbus_object_get_object_path (G_DBUS_OBJECT (group_object))) == 0)
-        udisks_linux_block_object_update_lvm_pv (block_object, NULL, NULL);
-    }
+  object = udisks_daemon_find_block_by_device_file (daemon, device_file);
+  if (object == NULL)
+    object = udisks_daemon_find_block_by_symlink (daemon, device_file);
+
+  if (object != NULL && !UDISKS_IS_LINUX_BLOCK_OBJECT (object))
+    g_clear_object (&object);
+
+  return (UDisksLinuxBlockObject *) object;
 }
 
-static void
-update_with_variant (GPid pid,
-                     GVariant *info,
-                     GError *error,
-                     gpointer user_data)
+/**
+ * udisks_linux_volume_group_object_update:
+ * @object: A #UDisksLinuxVolumeGroupObject.
+ * @info: The information about the volume group from the LVM2 helper.
+ *
+ * Updates @object, its logical volumes and the physical volume
+ * information of its block devices from @info.
+ */
+void
+udisks_linux_volume_group_object_update (UDisksLinuxVolumeGroupObject *object,
+                                         GVariant                     *info)
 {
-  UDisksLinuxVolumeGroupObject *object = user_data;
   UDisksDaemon *daemon;
   GDBusObjectManagerServer *manager;
   GVariantIter *iter;
   GHashTableIter volume_iter;
   gpointer key, value;
   GHashTable *new_lvs;
-  GHashTable *new_pvs;
-  GList *objects, *l;
+  GHashTable *pv_blocks;
   gboolean needs_polling = FALSE;
 
   daemon = udisks_linux_volume_group_object_get_daemon (object);
   manager = udisks_daemon_get_object_manager (daemon);
 
-  if (error)
-    {
-      udisks_warning ("Failed to update LVM volume group %s: %s",
-                      udisks_linux_volume_group_object_get_name (object),
-                      error->message);
-      g_object_unref (object);
-      return;
-    }
-
   udisks_linux_volume_group_update (UDISKS_LINUX_VOLUME_GROUP (object->iface_volume_group), info, &needs_polling);
 
   if (!g_dbus_object_manager_server_is_exported (manager, G_DBUS_OBJECT_SKELETON (object)))
@@ -575,49 +549,94 @@ update_with_variant (GPid pid,
   udisks_volume_group_set_needs_polling (UDISKS_VOLUME_GROUP (object->iface_volume_group),
                                          needs_polling);
 
-  /* Update block objects. */
+  /* Update block objects - only those of our own logical and
+   * physical volumes.
+   */
+
+  g_hash_table_iter_init (&volume_iter, new_lvs);
+  while (g_hash_table_iter_next (&volume_iter, &key, &value))
+    {
+      UDisksLinuxBlockObject *block_object;
+
+      block_object = udisks_daemon_util_lvm2_find_logical_volume_block (daemon, object->name, key);
+      if (block_object != NULL)
+        {
+          if (udisks_object_peek_block (UDISKS_OBJECT (block_object)) != NULL)
+            block_object_update_lvm_iface (block_object, g_dbus_object_get_object_path (G_DBUS_OBJECT (value)));
+          g_object_unref (block_object);
+        }
+    }
 
-  new_pvs = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_variant_unref);
+  pv_blocks = g_hash_table_new_full (g_direct_hash, g_direct_equal, (GDestroyNotify) g_object_unref, NULL);
   if (g_variant_lookup (info, "pvs", "aa{sv}", &iter))
     {
-      const gchar *name;
-      GVariant *pv_info;
-      while (g_variant_iter_next (iter, "@a{sv}", &pv_info))
+      const gchar *device_file;
+      GVariant *pv_info = NULL;
+      while (g_variant_iter_loop (iter, "@a{sv}", &pv_info))
         {
-          if (g_variant_lookup (pv_info, "device", "&s", &name))
-            g_hash_table_insert (new_pvs, (gchar *)name, pv_info);
+          UDisksLinuxBlockObject *block_object;
+
+          if (!g_variant_lookup (pv_info, "device", "&s", &device_file))
+            continue;
+
+          block_object = find_physical_volume_block (daemon, device_file);
+          if (block_object == NULL)
+            continue;
+
+          if (udisks_object_peek_block (UDISKS_OBJECT (block_object)) != NULL
+              && !g_hash_table_contains (pv_blocks, block_object))
+            {
+              udisks_linux_block_object_update_lvm_pv (block_object, object, pv_info);
+              g_hash_table_add (pv_blocks, block_object);
+            }
           else
-            g_variant_unref (pv_info);
+            g_object_unref (block_object);
         }
+      g_variant_iter_free (iter);
     }
 
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (manager));
-  for (l = objects; l != NULL; l = l->next)
+  /* Blocks that are no longer physical volumes of this group */
+  g_hash_table_iter_init (&volume_iter, object->physical_volume_blocks);
+  while (g_hash_table_iter_next (&volume_iter, &key, NULL))
     {
-      if (UDISKS_IS_LINUX_BLOCK_OBJECT (l->data))
-        update_block (UDISKS_LINUX_BLOCK_OBJECT (l->data), object, new_lvs, new_pvs);
+      UDisksPhysicalVolume *pv;
+
+      if (g_hash_table_contains (pv_blocks, key))
+        continue;
+
+      pv = udisks_object_peek_physical_volume (UDISKS_OBJECT (key));
+      if (pv && g_strcmp0 (udisks_physical_volume_get_volume_group (pv),
+                           g_dbus_object_get_object_path (G_DBUS_OBJECT (object))) == 0)
+        udisks_linux_block_object_update_lvm_pv (UDISKS_LINUX_BLOCK_OBJECT (key), NULL, NULL);
     }
-  g_list_free_full (objects, g_object_unref);
+  g_hash_table_unref (object->physical_volume_blocks);
+  object->physical_volume_blocks = pv_blocks;
 
   g_hash_table_destroy (new_lvs);
-  g_hash_table_destroy (new_pvs);
-
-  g_object_unref (object);
 }
 
-void
-udisks_linux_volume_group_object_update (UDisksLinuxVolumeGroupObject *object)
+static gboolean poll_timeout (gpointer user_data);
+
+/* Schedules the next poll, if any, depending on how long the last one took */
+static void
+poll_finished (UDisksLinuxVolumeGroupObject *object)
 {
-  UDisksDaemon *daemon = udisks_linux_volume_group_object_get_daemon (object);
+  gint64 duration;
+  gint64 interval;
 
-  const gchar *args[] = { NULL, "-b", "show", object->name, NULL };
-  if (udisks_daemon_get_uninstalled (daemon))
-    args[0] = BUILD_DIR "modules/lvm2/udisks-lvm";
-  else
-    args[0] = LVM_HELPER_DIR "udisks-lvm";
+  if (object->poll_watchdog_id != 0)
+    {
+      g_source_remove (object->poll_watchdog_id);
+      object->poll_watchdog_id = 0;
+    }
+
+  duration = g_get_monotonic_time () - object->poll_start;
+  udisks_metrics_add_duration (udisks_daemon_get_metrics (object->daemon), "lvm2-poll", duration);
 
-  udisks_daemon_util_lvm2_spawn_for_variant (args, G_VARIANT_TYPE("a{sv}"),
-                                             update_with_variant, g_object_ref (object));
+  interval = CLAMP (duration / 1000 * POLL_INTERVAL_FACTOR,
+                    POLL_MIN_INTERVAL_MSEC,
+                    POLL_MAX_INTERVAL_MSEC);
+  object->poll_timeout_id = g_timeout_add (interval, poll_timeout, g_object_ref (object));
 }
 
 static void
@@ -633,11 +652,13 @@ poll_with_variant (GPid pid,
 
   if (pid != object->poll_pid)
     {
+      /* a poll that was killed */
       g_object_unref (object);
       return;
     }
 
   object->poll_pid = 0;
+  poll_finished (object);
 
   if (error)
     {
@@ -679,8 +700,13 @@ poll_in_main_thread (gpointer user_data)
 {
   UDisksLinuxVolumeGroupObject *object = user_data;
 
-  if (object->poll_timeout_id)
-    object->poll_requested = TRUE;
+  if (object->poll_pid != 0 || object->poll_timeout_id != 0)
+    {
+      /* merge with the poll that is already due */
+      if (object->poll_requested)
+        udisks_metrics_add_count (udisks_daemon_get_metrics (object->daemon), "lvm2-polls-skipped", 1);
+      object->poll_requested = TRUE;
+    }
   else
     poll_now (object);
 
@@ -704,18 +730,47 @@ poll_timeout (gpointer user_data)
   return FALSE;
 }
 
+static gboolean
+poll_watchdog (gpointer user_data)
+{
+  UDisksLinuxVolumeGroupObject *object = user_data;
+
+  object->poll_watchdog_id = 0;
+  if (object->poll_pid != 0)
+    {
+      udisks_warning ("Polling LVM volume group %s took more than %d seconds, killing it",
+                      object->name, POLL_MAX_DURATION_SEC);
+      kill (object->poll_pid, SIGINT);
+      object->poll_pid = 0;
+      udisks_metrics_add_count (udisks_daemon_get_metrics (object->daemon), "lvm2-polls-killed", 1);
+      /* the next requested poll starts after the longest interval */
+      poll_finished (object);
+    }
+
+  g_object_unref (object);
+  return FALSE;
+}
+
+/* Polls by running a helper for just this volume group, so it can be
+ * killed if it gets stuck without affecting any other group. The next
+ * poll is only started after this one finished, see poll_finished().
+ */
 static void
 poll_now (UDisksLinuxVolumeGroupObject *object)
 {
   const gchar *args[] = { LVM_HELPER_DIR "udisks-lvm", "-b", "show", object->name, NULL };
 
-  object->poll_timeout_id = g_timeout_add (5000, poll_timeout, g_object_ref (object));
+  if (udisks_daemon_get_uninstalled (object->daemon))
+    args[0] = BUILD_DIR "modules/lvm2/udisks-lvm";
 
-  if (object->poll_pid)
-    kill (object->poll_pid, SIGINT);
+  object->poll_requested = FALSE;
+  object->poll_start = g_get_monotonic_time ();
+  udisks_metrics_add_count (udisks_daemon_get_metrics (object->daemon), "lvm2-polls", 1);
 
   object->poll_pid = udisks_daemon_util_lvm2_spawn_for_variant (args, G_VARIANT_TYPE("a{sv}"),
                                                                 poll_with_variant, g_object_ref (object));
+  if (object->poll_pid != 0)
+    object->poll_watchdog_id = g_timeout_add_seconds (POLL_MAX_DURATION_SEC, poll_watchdog, g_object_ref (object));
 }
 
 void
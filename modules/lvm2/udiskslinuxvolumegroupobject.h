@@ -38,7 +38,8 @@ UDisksLinuxVolumeGroupObject   *udisks_linux_volume_group_object_new           (
                                                                                 const gchar                  *name);
 const gchar                    *udisks_linux_volume_group_object_get_name      (UDisksLinuxVolumeGroupObject *object);
 UDisksDaemon                   *udisks_linux_volume_group_object_get_daemon    (UDisksLinuxVolumeGroupObject *object);
-void                            udisks_linux_volume_group_object_update        (UDisksLinuxVolumeGroupObject *object);
+void                            udisks_linux_volume_group_object_update        (UDisksLinuxVolumeGroupObject *object,
+                                                                                GVariant                     *info);
 
 void                            udisks_linux_volume_group_object_poll          (UDisksLinuxVolumeGroupObject *object);
 
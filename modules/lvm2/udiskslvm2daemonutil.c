@@ -25,6 +25,9 @@
 
 #include <stdio.h>
 #include <ctype.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -42,7 +45,9 @@
 #include <src/udisksdaemonutil.h>
 #include <src/udisksstate.h>
 #include <src/udiskslogging.h>
+#include <src/udisksmetrics.h>
 #include <src/udiskslinuxblockobject.h>
+#include <src/udiskslinuxdevice.h>
 #include <src/udiskslinuxdriveobject.h>
 #include <src/udisksmodulemanager.h>
 
@@ -379,6 +384,486 @@ udisks_daemon_util_lvm2_spawn_for_variant (const gchar        **argv,
   return pid;
 }
 
+/* -------------------------------------------------------------------------------- */
+
+/* A long-running "udisks-lvm serve" process that keeps its lvm handle
+ * open and answers requests one at a time, see udiskslvmhelper.c for
+ * the protocol.  It is started when the first request is made and
+ * restarted on the next request after it died or got stuck.
+ */
+
+typedef struct
+{
+  gchar *request;
+  const GVariantType *type;
+  void (*callback) (GPid pid, GVariant *result, GError *error, gpointer user_data);
+  gpointer user_data;
+  /* when the request was queued, for the lvm2-helper metric */
+  gint64 queued_at;
+} HelperRequest;
+
+/* Shared between the helper and the child watch of the process so
+ * the helper can tell whether the process has been reaped (and its
+ * pid possibly reused) even after the helper stopped watching it
+ */
+typedef struct
+{
+  gint ref_count;
+  GPid pid;
+  gboolean exited;
+} HelperProcess;
+
+struct _UDisksLVM2Helper
+{
+  UDisksDaemon *daemon;
+
+  HelperProcess *process;
+
+  gint input_fd;
+  GIOChannel *input_channel;
+  guint input_watch;
+  GString *input;
+
+  GIOChannel *output_channel;
+  guint output_watch;
+  GByteArray *output;
+
+  /* the request sent to the process but not yet answered, if any */
+  HelperRequest *current;
+  /* fires if @current is not answered in time */
+  guint timeout_id;
+  /* requests not yet sent, oldest first */
+  GQueue *pending;
+};
+
+#define HELPER_REPLY_HEADER_SIZE (2 * sizeof (guint32))
+
+/* a request not answered within this many seconds is considered stuck */
+#define HELPER_REQUEST_TIMEOUT_SECONDS 60
+
+static void helper_stop (UDisksLVM2Helper *helper,
+                         const gchar      *reason);
+static void helper_send_next (UDisksLVM2Helper *helper);
+
+static void
+helper_request_free (HelperRequest *request)
+{
+  g_free (request->request);
+  g_free (request);
+}
+
+static void
+helper_process_unref (HelperProcess *process)
+{
+  if (--process->ref_count == 0)
+    g_free (process);
+}
+
+static void
+helper_reap_child (GPid     pid,
+                   gint     status,
+                   gpointer user_data)
+{
+  HelperProcess *process = user_data;
+
+  process->exited = TRUE;
+  g_spawn_close_pid (pid);
+}
+
+static GPid
+helper_get_pid (UDisksLVM2Helper *helper)
+{
+  return helper->process != NULL ? helper->process->pid : 0;
+}
+
+/* Returns FALSE if the helper has been stopped */
+static gboolean
+helper_process_output (UDisksLVM2Helper *helper)
+{
+  while (helper->output->len >= HELPER_REPLY_HEADER_SIZE)
+    {
+      guint32 header[2];
+      HelperRequest *request;
+      GError *error = NULL;
+      GVariant *result = NULL;
+
+      memcpy (header, helper->output->data, HELPER_REPLY_HEADER_SIZE);
+      if (helper->output->len < HELPER_REPLY_HEADER_SIZE + header[1])
+        break;
+
+      request = helper->current;
+      if (request == NULL)
+        {
+          helper_stop (helper, "Unexpected reply from LVM2 helper");
+          return FALSE;
+        }
+      helper->current = NULL;
+      if (helper->timeout_id != 0)
+        {
+          g_source_remove (helper->timeout_id);
+          helper->timeout_id = 0;
+        }
+
+      if (header[0] != 0)
+        {
+          g_set_error (&error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "LVM2 helper failed to handle request '%s'",
+                       request->request);
+        }
+      else
+        {
+          GBytes *bytes;
+
+          bytes = g_bytes_new (helper->output->data + HELPER_REPLY_HEADER_SIZE, header[1]);
+          result = g_variant_ref_sink (g_variant_new_from_bytes (request->type, bytes, TRUE));
+          g_bytes_unref (bytes);
+        }
+      g_byte_array_remove_range (helper->output, 0, HELPER_REPLY_HEADER_SIZE + header[1]);
+
+      udisks_metrics_add_since (udisks_daemon_get_metrics (helper->daemon), "lvm2-helper", request->queued_at);
+
+      request->callback (helper_get_pid (helper), result, error, request->user_data);
+
+      g_clear_error (&error);
+      if (result != NULL)
+        g_variant_unref (result);
+      helper_request_free (request);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+helper_on_output (GIOChannel   *source,
+                  GIOCondition  condition,
+                  gpointer      user_data)
+{
+  UDisksLVM2Helper *helper = user_data;
+  guint8 buf[4096];
+  gsize bytes_read = 0;
+  GIOStatus status;
+
+  do
+    {
+      status = g_io_channel_read_chars (source, (gchar *) buf, sizeof buf, &bytes_read, NULL);
+      g_byte_array_append (helper->output, buf, bytes_read);
+    }
+  while (status == G_IO_STATUS_NORMAL && bytes_read == sizeof buf);
+
+  if (!helper_process_output (helper))
+    return FALSE;
+
+  if (status == G_IO_STATUS_EOF || status == G_IO_STATUS_ERROR)
+    {
+      helper->output_watch = 0;
+      helper_stop (helper, "LVM2 helper exited unexpectedly");
+      helper_send_next (helper);
+      return FALSE;
+    }
+
+  helper_send_next (helper);
+  return TRUE;
+}
+
+static gboolean
+helper_on_input (GIOChannel   *channel,
+                 GIOCondition  condition,
+                 gpointer      user_data)
+{
+  UDisksLVM2Helper *helper = user_data;
+  gsize bytes_written = 0;
+
+  if (condition & (G_IO_ERR | G_IO_HUP))
+    {
+      /* the output watch notices as well and cleans up */
+      helper->input_watch = 0;
+      return FALSE;
+    }
+
+  g_io_channel_write_chars (channel, helper->input->str, helper->input->len, &bytes_written, NULL);
+  g_string_erase (helper->input, 0, bytes_written);
+
+  if (helper->input->len > 0)
+    return TRUE; /* keep writing */
+
+  helper->input_watch = 0;
+  return FALSE;
+}
+
+static gboolean
+helper_on_timeout (gpointer user_data)
+{
+  UDisksLVM2Helper *helper = user_data;
+
+  helper->timeout_id = 0;
+  udisks_warning ("LVM2 helper with pid %d did not answer request '%s' within %d seconds, restarting it",
+                  (gint) helper_get_pid (helper), helper->current->request, HELPER_REQUEST_TIMEOUT_SECONDS);
+  helper_stop (helper, "LVM2 helper timed out");
+  helper_send_next (helper);
+
+  return FALSE; /* remove source */
+}
+
+static gboolean
+helper_start (UDisksLVM2Helper  *helper,
+              GError           **error)
+{
+  const gchar *argv[] = { NULL, "serve", NULL };
+  GPid pid;
+  gint output_fd;
+
+  if (udisks_daemon_get_uninstalled (helper->daemon))
+    argv[0] = BUILD_DIR "modules/lvm2/udisks-lvm";
+  else
+    argv[0] = LVM_HELPER_DIR "udisks-lvm";
+
+  if (!g_spawn_async_with_pipes (NULL,
+                                 (gchar **) argv,
+                                 NULL,
+                                 G_SPAWN_DO_NOT_REAP_CHILD,
+                                 NULL,
+                                 NULL,
+                                 &pid,
+                                 &helper->input_fd,
+                                 &output_fd,
+                                 NULL,
+                                 error))
+    return FALSE;
+
+  udisks_debug ("Started LVM2 helper with pid %d", (gint) pid);
+
+  /* one reference for the helper, one for the child watch */
+  helper->process = g_new0 (HelperProcess, 1);
+  helper->process->ref_count = 2;
+  helper->process->pid = pid;
+  g_child_watch_add_full (G_PRIORITY_DEFAULT, pid, helper_reap_child,
+                          helper->process, (GDestroyNotify) helper_process_unref);
+
+  helper->input_channel = g_io_channel_unix_new (helper->input_fd);
+  g_io_channel_set_encoding (helper->input_channel, NULL, NULL);
+  g_io_channel_set_buffered (helper->input_channel, FALSE);
+  g_io_channel_set_flags (helper->input_channel, G_IO_FLAG_NONBLOCK, NULL);
+
+  helper->output_channel = g_io_channel_unix_new (output_fd);
+  g_io_channel_set_close_on_unref (helper->output_channel, TRUE);
+  g_io_channel_set_encoding (helper->output_channel, NULL, NULL);
+  g_io_channel_set_flags (helper->output_channel, G_IO_FLAG_NONBLOCK, NULL);
+  helper->output_watch = g_io_add_watch (helper->output_channel,
+                                         G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                         helper_on_output,
+                                         helper);
+  return TRUE;
+}
+
+/* Stops the helper process, if running, and fails the request it is
+ * handling.  Requests not sent yet are kept, helper_send_next()
+ * starts a new process for them.
+ */
+static void
+helper_stop (UDisksLVM2Helper *helper,
+             const gchar      *reason)
+{
+  HelperRequest *request;
+
+  if (helper->process != NULL)
+    {
+      /* once reaped the pid may have been reused */
+      if (!helper->process->exited)
+        kill (helper->process->pid, SIGTERM);
+      helper_process_unref (helper->process);
+      helper->process = NULL;
+    }
+
+  if (helper->timeout_id != 0)
+    {
+      g_source_remove (helper->timeout_id);
+      helper->timeout_id = 0;
+    }
+  if (helper->input_watch != 0)
+    {
+      g_source_remove (helper->input_watch);
+      helper->input_watch = 0;
+    }
+  if (helper->output_watch != 0)
+    {
+      g_source_remove (helper->output_watch);
+      helper->output_watch = 0;
+    }
+  if (helper->input_channel != NULL)
+    {
+      g_io_channel_unref (helper->input_channel);
+      helper->input_channel = NULL;
+    }
+  if (helper->input_fd != -1)
+    {
+      close (helper->input_fd);
+      helper->input_fd = -1;
+    }
+  g_clear_pointer (&helper->output_channel, g_io_channel_unref);
+
+  g_string_truncate (helper->input, 0);
+  g_byte_array_set_size (helper->output, 0);
+
+  request = helper->current;
+  helper->current = NULL;
+  if (request != NULL)
+    {
+      GError *error = NULL;
+
+      g_set_error (&error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "%s while handling request '%s'",
+                   reason, request->request);
+      request->callback (0, NULL, error, request->user_data);
+      g_clear_error (&error);
+      helper_request_free (request);
+    }
+}
+
+/* Sends the oldest pending request, starting the process if needed,
+ * unless a request is being handled already
+ */
+static void
+helper_send_next (UDisksLVM2Helper *helper)
+{
+  HelperRequest *request;
+  GError *error = NULL;
+
+  if (helper->current != NULL || g_queue_is_empty (helper->pending))
+    return;
+
+  if (helper->process == NULL && !helper_start (helper, &error))
+    {
+      while ((request = g_queue_pop_head (helper->pending)) != NULL)
+        {
+          request->callback (0, NULL, error, request->user_data);
+          helper_request_free (request);
+        }
+      g_clear_error (&error);
+      return;
+    }
+
+  request = g_queue_pop_head (helper->pending);
+  helper->current = request;
+  helper->timeout_id = g_timeout_add_seconds (HELPER_REQUEST_TIMEOUT_SECONDS, helper_on_timeout, helper);
+
+  g_string_append (helper->input, request->request);
+  g_string_append_c (helper->input, '\n');
+  if (helper->input_watch == 0)
+    helper->input_watch = g_io_add_watch (helper->input_channel,
+                                          G_IO_OUT | G_IO_ERR | G_IO_HUP,
+                                          helper_on_input,
+                                          helper);
+}
+
+/**
+ * udisks_daemon_util_lvm2_helper_new:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Creates a handle for a persistent LVM2 helper process.  The process
+ * itself is only started with the first request.
+ *
+ * Returns: A #UDisksLVM2Helper. Free with udisks_daemon_util_lvm2_helper_free().
+ */
+UDisksLVM2Helper *
+udisks_daemon_util_lvm2_helper_new (UDisksDaemon *daemon)
+{
+  UDisksLVM2Helper *helper;
+
+  helper = g_new0 (UDisksLVM2Helper, 1);
+  helper->daemon = daemon;
+  helper->input_fd = -1;
+  helper->input = g_string_new (NULL);
+  helper->output = g_byte_array_new ();
+  helper->pending = g_queue_new ();
+
+  return helper;
+}
+
+/**
+ * udisks_daemon_util_lvm2_helper_free:
+ * @helper: A #UDisksLVM2Helper.
+ *
+ * Stops the helper process and fails all requests that haven't been
+ * answered yet.
+ */
+void
+udisks_daemon_util_lvm2_helper_free (UDisksLVM2Helper *helper)
+{
+  HelperRequest *request;
+
+  helper_stop (helper, "LVM2 helper stopped");
+  while ((request = g_queue_pop_head (helper->pending)) != NULL)
+    {
+      GError *error = NULL;
+
+      g_set_error (&error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "LVM2 helper stopped before handling request '%s'",
+                   request->request);
+      request->callback (0, NULL, error, request->user_data);
+      g_clear_error (&error);
+      helper_request_free (request);
+    }
+  g_string_free (helper->input, TRUE);
+  g_byte_array_free (helper->output, TRUE);
+  g_queue_free (helper->pending);
+  g_free (helper);
+}
+
+/**
+ * udisks_daemon_util_lvm2_helper_request:
+ * @helper: A #UDisksLVM2Helper.
+ * @request: The request, e.g. <literal>list</literal> or <literal>show VG</literal>.
+ * @type: The #GVariantType of the reply.
+ * @callback: Function to call with the reply.
+ * @user_data: User data to pass to @callback.
+ *
+ * Sends @request to the persistent LVM2 helper process, starting it
+ * if needed, and calls @callback in the main loop once the reply
+ * arrives, just like udisks_daemon_util_lvm2_spawn_for_variant()
+ * does.  Requests are answered one at a time, in order.
+ *
+ * If the same request with the same @callback and @user_data is
+ * already waiting to be sent, nothing is added - the queued one will
+ * see all changes made until it is handled.  If the process does not
+ * answer within a minute it is killed, the request fails and the
+ * process is restarted for the remaining requests.
+ */
+void
+udisks_daemon_util_lvm2_helper_request (UDisksLVM2Helper    *helper,
+                                        const gchar         *request,
+                                        const GVariantType  *type,
+                                        void (*callback)    (GPid      pid,
+                                                             GVariant *result,
+                                                             GError   *error,
+                                                             gpointer  user_data),
+                                        gpointer             user_data)
+{
+  HelperRequest *data;
+  GList *l;
+
+  for (l = helper->pending->head; l != NULL; l = l->next)
+    {
+      data = l->data;
+      if (g_strcmp0 (data->request, request) == 0 &&
+          data->callback == callback &&
+          data->user_data == user_data)
+        {
+          udisks_debug ("Coalesced LVM2 helper request '%s'", request);
+          return;
+        }
+    }
+
+  data = g_new0 (HelperRequest, 1);
+  data->request = g_strdup (request);
+  data->type = type;
+  data->callback = callback;
+  data->user_data = user_data;
+  data->queued_at = g_get_monotonic_time ();
+  g_queue_push_tail (helper->pending, data);
+
+  helper_send_next (helper);
+}
+
 UDisksLinuxVolumeGroupObject *
 udisks_daemon_util_lvm2_find_volume_group_object (UDisksDaemon *daemon,
                                                   const gchar  *name)
@@ -395,6 +880,62 @@ udisks_daemon_util_lvm2_find_volume_group_object (UDisksDaemon *daemon,
   return g_hash_table_lookup (udisks_lvm2_state_get_name_to_volume_group (state), name);
 }
 
+/**
+ * udisks_daemon_util_lvm2_find_logical_volume_block:
+ * @daemon: A #UDisksDaemon.
+ * @vg_name: The name of a volume group.
+ * @lv_name: The name of a logical volume in @vg_name.
+ *
+ * Finds the block object for an active logical volume by looking at
+ * the DM_VG_NAME and DM_LV_NAME udev properties recorded from uevents.
+ *
+ * Returns: (transfer full): A #UDisksLinuxBlockObject or %NULL if not found. Free with g_object_unref().
+ */
+UDisksLinuxBlockObject *
+udisks_daemon_util_lvm2_find_logical_volume_block (UDisksDaemon *daemon,
+                                                   const gchar  *vg_name,
+                                                   const gchar  *lv_name)
+{
+  UDisksLVM2State *state;
+  UDisksModuleManager *manager;
+  UDisksObject *object;
+  UDisksLinuxDevice *device;
+  dev_t block_device_number;
+  gboolean matches = FALSE;
+
+  manager = udisks_daemon_get_module_manager (daemon);
+  g_assert (manager != NULL);
+
+  state = (UDisksLVM2State *) udisks_module_manager_get_module_state_pointer (manager, LVM2_MODULE_NAME);
+  g_assert (state != NULL);
+
+  block_device_number = udisks_lvm2_state_get_lv_block_device (state, vg_name, lv_name);
+  if (block_device_number == 0)
+    return NULL;
+
+  object = udisks_daemon_find_block (daemon, block_device_number);
+  if (object != NULL && UDISKS_IS_LINUX_BLOCK_OBJECT (object))
+    {
+      /* the device may have gone away or been reused in the meantime */
+      device = udisks_linux_block_object_get_device (UDISKS_LINUX_BLOCK_OBJECT (object));
+      if (device != NULL)
+        {
+          matches = g_strcmp0 (g_udev_device_get_property (device->udev_device, "DM_VG_NAME"), vg_name) == 0
+                 && g_strcmp0 (g_udev_device_get_property (device->udev_device, "DM_LV_NAME"), lv_name) == 0;
+          g_object_unref (device);
+        }
+    }
+
+  if (!matches)
+    {
+      udisks_lvm2_state_set_lv_block_device (state, vg_name, lv_name, 0);
+      g_clear_object (&object);
+      return NULL;
+    }
+
+  return UDISKS_LINUX_BLOCK_OBJECT (object);
+}
+
 /* -------------------------------------------------------------------------------- */
 
 gboolean
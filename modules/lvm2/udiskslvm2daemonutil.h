@@ -41,11 +41,26 @@ GPid udisks_daemon_util_lvm2_spawn_for_variant (const gchar        **argv,
                                                                   gpointer  user_data),
                                                 gpointer             user_data);
 
+UDisksLVM2Helper *udisks_daemon_util_lvm2_helper_new     (UDisksDaemon        *daemon);
+void              udisks_daemon_util_lvm2_helper_free    (UDisksLVM2Helper    *helper);
+void              udisks_daemon_util_lvm2_helper_request (UDisksLVM2Helper    *helper,
+                                                          const gchar         *request,
+                                                          const GVariantType  *type,
+                                                          void (*callback) (GPid      pid,
+                                                                            GVariant *result,
+                                                                            GError   *error,
+                                                                            gpointer  user_data),
+                                                          gpointer             user_data);
+
 gboolean udisks_daemon_util_lvm2_name_is_reserved (const gchar *name);
 
 UDisksLinuxVolumeGroupObject * udisks_daemon_util_lvm2_find_volume_group_object (UDisksDaemon *daemon,
                                                                                  const gchar  *name);
 
+UDisksLinuxBlockObject * udisks_daemon_util_lvm2_find_logical_volume_block (UDisksDaemon *daemon,
+                                                                           const gchar  *vg_name,
+                                                                           const gchar  *lv_name);
+
 void udisks_daemon_util_lvm2_trigger_udev (const gchar *device_file);
 
 G_END_DECLS
@@ -32,6 +32,8 @@
 #include <src/udiskslinuxdriveobject.h>
 #include <src/udiskslinuxdevice.h>
 #include <src/udisksdaemon.h>
+#include <src/udisksprovider.h>
+#include <src/udiskslinuxprovider.h>
 #include <src/udisksmodulemanager.h>
 #include <src/udiskslogging.h>
 
@@ -108,13 +110,17 @@ udisks_module_get_drive_object_iface_setup_entries (void)
 
 static void
 lvm_update_from_variant (GPid      pid,
-                         GVariant *volume_groups,
+                         GVariant *report,
                          GError   *error,
                          gpointer  user_data)
 {
   UDisksLVM2State *state;
   UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
   GDBusObjectManagerServer *manager;
+  GVariant *volume_groups;
+  GVariant *vg_infos;
+  GVariant *vg_info;
+  GHashTable *updated_groups;
   GVariantIter var_iter;
   GHashTableIter vg_name_iter;
   gpointer key, value;
@@ -129,6 +135,14 @@ lvm_update_from_variant (GPid      pid,
   manager = udisks_daemon_get_object_manager (daemon);
   state = get_module_state (daemon);
 
+  volume_groups = g_variant_lookup_value (report, "names", G_VARIANT_TYPE ("as"));
+  vg_infos = g_variant_lookup_value (report, "vgs", G_VARIANT_TYPE ("aa{sv}"));
+  if (volume_groups == NULL || vg_infos == NULL)
+    {
+      udisks_warning ("LVM2 plugin: Malformed report from helper");
+      goto out;
+    }
+
   /* Remove obsolete groups */
   g_hash_table_iter_init (&vg_name_iter,
                           udisks_lvm2_state_get_name_to_volume_group (state));
@@ -158,7 +172,7 @@ lvm_update_from_variant (GPid      pid,
         }
     }
 
-  /* Add new groups and update existing groups */
+  /* Add new groups */
   g_variant_iter_init (&var_iter, volume_groups);
   while (g_variant_iter_next (&var_iter, "&s", &name))
     {
@@ -172,8 +186,43 @@ lvm_update_from_variant (GPid      pid,
           g_hash_table_insert (udisks_lvm2_state_get_name_to_volume_group (state),
                                g_strdup (name), group);
         }
-      udisks_linux_volume_group_object_update (group);
     }
+
+  /* Update all groups from the same report */
+  updated_groups = g_hash_table_new (g_str_hash, g_str_equal);
+  g_variant_iter_init (&var_iter, vg_infos);
+  while (g_variant_iter_next (&var_iter, "@a{sv}", &vg_info))
+    {
+      UDisksLinuxVolumeGroupObject *group = NULL;
+
+      if (g_variant_lookup (vg_info, "name", "&s", &name))
+        group = g_hash_table_lookup (udisks_lvm2_state_get_name_to_volume_group (state),
+                                     name);
+      if (group != NULL)
+        {
+          udisks_linux_volume_group_object_update (group, vg_info);
+          g_hash_table_add (updated_groups, (gpointer) udisks_linux_volume_group_object_get_name (group));
+        }
+      g_variant_unref (vg_info);
+    }
+
+  g_variant_iter_init (&var_iter, volume_groups);
+  while (g_variant_iter_next (&var_iter, "&s", &name))
+    {
+      if (!g_hash_table_contains (updated_groups, name))
+        udisks_warning ("Failed to update LVM volume group %s: The volume group could not be opened",
+                        name);
+    }
+  g_hash_table_destroy (updated_groups);
+
+  /* wake up anyone waiting for the groups or their volumes to appear */
+  udisks_provider_emit_changed (UDISKS_PROVIDER (udisks_daemon_get_linux_provider (daemon)));
+
+ out:
+  if (volume_groups != NULL)
+    g_variant_unref (volume_groups);
+  if (vg_infos != NULL)
+    g_variant_unref (vg_infos);
 }
 
 static void
@@ -183,17 +232,29 @@ lvm_update (UDisksDaemon *daemon,
   const gchar *args[5];
   int i = 0;
 
+  if (!ignore_locks)
+    {
+      udisks_daemon_util_lvm2_helper_request (udisks_lvm2_state_get_helper (get_module_state (daemon)),
+                                              "report",
+                                              G_VARIANT_TYPE ("a{sv}"),
+                                              lvm_update_from_variant,
+                                              daemon);
+      return;
+    }
+
+  /* The persistent helper always waits for locks, so use a one-shot
+   * helper process when locks need to be ignored.
+   */
   if (udisks_daemon_get_uninstalled (daemon))
     args[i++] = BUILD_DIR "modules/lvm2/udisks-lvm";
   else
     args[i++] = LVM_HELPER_DIR "udisks-lvm";
   args[i++] = "-b";
-  if (ignore_locks)
-    args[i++] = "-f";
-  args[i++] = "list";
+  args[i++] = "-f";
+  args[i++] = "report";
   args[i++] = NULL;
 
-  udisks_daemon_util_lvm2_spawn_for_variant (args, G_VARIANT_TYPE("as"),
+  udisks_daemon_util_lvm2_spawn_for_variant (args, G_VARIANT_TYPE("a{sv}"),
                                              lvm_update_from_variant, daemon);
 }
 
@@ -271,6 +332,16 @@ lvm2_object_new (UDisksDaemon      *daemon,
    * reference to UDisksDaemon instance though for manually performing dbus
    * stuff onto. */
 
+  if (is_logical_volume (device))
+    {
+      const gchar *dm_lv_name = g_udev_device_get_property (device->udev_device, "DM_LV_NAME");
+      if (dm_lv_name != NULL && *dm_lv_name != '\0')
+        udisks_lvm2_state_set_lv_block_device (get_module_state (daemon),
+                                               g_udev_device_get_property (device->udev_device, "DM_VG_NAME"),
+                                               dm_lv_name,
+                                               g_udev_device_get_device_number (device->udev_device));
+    }
+
   if (is_logical_volume (device)
       || has_physical_volume_label (device)
       || is_recorded_as_physical_volume (daemon, device))
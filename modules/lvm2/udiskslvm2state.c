@@ -22,6 +22,7 @@
 
 #include <src/udisksdaemontypes.h>
 #include "udiskslvm2state.h"
+#include "udiskslvm2daemonutil.h"
 
 struct _UDisksLVM2State
 {
@@ -30,8 +31,17 @@ struct _UDisksLVM2State
   /* maps from volume group name to UDisksLinuxVolumeGroupObject instances. */
   GHashTable *name_to_volume_group;
 
+  /* maps from "VG/LV" (DM_VG_NAME and DM_LV_NAME of a block device) to
+   * the device number of the block device, as seen in uevents. Entries
+   * are not removed when the device goes away so users must verify the
+   * block object they find.
+   */
+  GHashTable *lv_block_devices;
+
   gint lvm_delayed_update_id;
   gboolean coldplug_done;
+
+  UDisksLVM2Helper *helper;
 };
 
 /**
@@ -54,7 +64,12 @@ udisks_lvm2_state_new (UDisksDaemon *daemon)
                                                        g_str_equal,
                                                        g_free,
                                                        (GDestroyNotify) g_object_unref);
+  state->lv_block_devices = g_hash_table_new_full (g_str_hash,
+                                                   g_str_equal,
+                                                   g_free,
+                                                   g_free);
   state->coldplug_done = FALSE;
+  state->helper = udisks_daemon_util_lvm2_helper_new (daemon);
 
   return state;
 }
@@ -70,7 +85,9 @@ udisks_lvm2_state_free (UDisksLVM2State *state)
 {
   g_assert (state != NULL);
 
+  udisks_daemon_util_lvm2_helper_free (state->helper);
   g_hash_table_unref (state->name_to_volume_group);
+  g_hash_table_unref (state->lv_block_devices);
 
   g_free (state);
 }
@@ -83,6 +100,74 @@ udisks_lvm2_state_get_name_to_volume_group (UDisksLVM2State *state)
   return state->name_to_volume_group;
 }
 
+/**
+ * udisks_lvm2_state_set_lv_block_device:
+ * @state: A #UDisksLVM2State.
+ * @vg_name: The name of a volume group.
+ * @lv_name: The name of a logical volume in @vg_name.
+ * @block_device_number: The device number of the block device for the logical volume or 0 to forget it.
+ *
+ * Records which block device belongs to the logical volume @lv_name.
+ */
+void
+udisks_lvm2_state_set_lv_block_device (UDisksLVM2State *state,
+                                       const gchar     *vg_name,
+                                       const gchar     *lv_name,
+                                       dev_t            block_device_number)
+{
+  gchar *key;
+  guint64 *value;
+
+  g_assert (state != NULL);
+
+  key = g_strdup_printf ("%s/%s", vg_name, lv_name);
+  if (block_device_number == 0)
+    {
+      g_hash_table_remove (state->lv_block_devices, key);
+      g_free (key);
+      return;
+    }
+
+  value = g_new (guint64, 1);
+  *value = block_device_number;
+  g_hash_table_replace (state->lv_block_devices, key, value);
+}
+
+/**
+ * udisks_lvm2_state_get_lv_block_device:
+ * @state: A #UDisksLVM2State.
+ * @vg_name: The name of a volume group.
+ * @lv_name: The name of a logical volume in @vg_name.
+ *
+ * Gets the device number recorded with udisks_lvm2_state_set_lv_block_device().
+ *
+ * Returns: A device number or 0 if not known.
+ */
+dev_t
+udisks_lvm2_state_get_lv_block_device (UDisksLVM2State *state,
+                                       const gchar     *vg_name,
+                                       const gchar     *lv_name)
+{
+  gchar *key;
+  guint64 *value;
+
+  g_assert (state != NULL);
+
+  key = g_strdup_printf ("%s/%s", vg_name, lv_name);
+  value = g_hash_table_lookup (state->lv_block_devices, key);
+  g_free (key);
+
+  return value != NULL ? (dev_t) *value : 0;
+}
+
+UDisksLVM2Helper *
+udisks_lvm2_state_get_helper (UDisksLVM2State *state)
+{
+  g_assert (state != NULL);
+
+  return state->helper;
+}
+
 gint
 udisks_lvm2_state_get_lvm_delayed_update_id (UDisksLVM2State *state)
 {
@@ -21,6 +21,7 @@
 #ifndef __UDISKS_LVM2_STATE_H__
 #define __UDISKS_LVM2_STATE_H__
 
+#include <sys/types.h>
 #include <glib.h>
 #include <glib-object.h>
 #include <src/udisksdaemontypes.h>
@@ -28,17 +29,26 @@
 
 G_BEGIN_DECLS
 
-UDisksLVM2State *udisks_lvm2_state_new  (UDisksDaemon *daemon);
-void             udisks_lvm2_state_free (UDisksLVM2State *state);
-
-GHashTable      *udisks_lvm2_state_get_name_to_volume_group  (UDisksLVM2State *state);
-gint             udisks_lvm2_state_get_lvm_delayed_update_id (UDisksLVM2State *state);
-gboolean         udisks_lvm2_state_get_coldplug_done         (UDisksLVM2State *state);
-
-void             udisks_lvm2_state_set_lvm_delayed_update_id (UDisksLVM2State *state,
-                                                              gint             id);
-void             udisks_lvm2_state_set_coldplug_done         (UDisksLVM2State *state,
-                                                              gboolean         coldplug_done);
+UDisksLVM2State  *udisks_lvm2_state_new  (UDisksDaemon *daemon);
+void              udisks_lvm2_state_free (UDisksLVM2State *state);
+
+GHashTable       *udisks_lvm2_state_get_name_to_volume_group  (UDisksLVM2State *state);
+UDisksLVM2Helper *udisks_lvm2_state_get_helper                (UDisksLVM2State *state);
+gint              udisks_lvm2_state_get_lvm_delayed_update_id (UDisksLVM2State *state);
+gboolean          udisks_lvm2_state_get_coldplug_done         (UDisksLVM2State *state);
+
+void              udisks_lvm2_state_set_lvm_delayed_update_id (UDisksLVM2State *state,
+                                                               gint             id);
+void              udisks_lvm2_state_set_coldplug_done         (UDisksLVM2State *state,
+                                                               gboolean         coldplug_done);
+
+void              udisks_lvm2_state_set_lv_block_device       (UDisksLVM2State *state,
+                                                               const gchar     *vg_name,
+                                                               const gchar     *lv_name,
+                                                               dev_t            block_device_number);
+dev_t             udisks_lvm2_state_get_lv_block_device       (UDisksLVM2State *state,
+                                                               const gchar     *vg_name,
+                                                               const gchar     *lv_name);
 
 G_END_DECLS
 
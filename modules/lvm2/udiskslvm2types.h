@@ -27,6 +27,9 @@
 struct _UDisksLVM2State;
 typedef struct _UDisksLVM2State UDisksLVM2State;
 
+struct _UDisksLVM2Helper;
+typedef struct _UDisksLVM2Helper UDisksLVM2Helper;
+
 struct _UDisksLinuxVolumeGroupObject;
 typedef struct _UDisksLinuxVolumeGroupObject UDisksLinuxVolumeGroupObject;
 
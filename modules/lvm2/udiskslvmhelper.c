@@ -36,12 +36,26 @@
    In that case, we ignore locks.
 
    The program can list all volume groups or can return all needed
-   information for a single volume group.  Output is a GVariant, by
+   information for a single volume group or, in a single report, for
+   all of them.  Output is a GVariant, by
    default as text (mostly for debugging and because it is impolite to
    output binary data to a terminal) or serialized.
+
+   In "serve" mode the program keeps its lvm handle open and answers
+   requests read from stdin, one per line, in the order they arrive.
+   The requests are "list", "show VG" and "report", just like on the
+   command line.  Each reply consists of two native endian 32 bit unsigned
+   integers - a status (0 on success) and the size of the data that
+   follows - and then the GVariant in serialized form.  This saves
+   udisksd a fork/exec and a full lvm_init for every request.  Since
+   all requests are served one at a time, a volume group that is
+   locked for a long time delays the replies to the requests after
+   it, unlike with one process per request.
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <glib.h>
 #include <lvm2app.h>
@@ -54,6 +68,8 @@ usage (void)
 {
   fprintf (stderr, "Usage: udisks-lvm [-b] [-f] list\n");
   fprintf (stderr, "       udisks-lvm [-b] [-f] show VG\n");
+  fprintf (stderr, "       udisks-lvm [-b] [-f] report\n");
+  fprintf (stderr, "       udisks-lvm [-f] serve\n");
   exit (1);
 }
 
@@ -67,15 +83,13 @@ init_lvm (void)
 }
 
 static GVariant *
-list_volume_groups (void)
+list_volume_groups (lvm_t lvm)
 {
-  lvm_t lvm;
   struct dm_list *vg_names = NULL;
   struct lvm_str_list *vg_name = NULL;
   GVariantBuilder result;
 
   g_variant_builder_init (&result, G_VARIANT_TYPE ("as"));
-  lvm = init_lvm ();
 
   if (lvm)
     {
@@ -87,7 +101,6 @@ list_volume_groups (void)
               g_variant_builder_add (&result, "s", vg_name->str);
             }
         }
-      lvm_quit (lvm);
     }
   return g_variant_builder_end (&result);
 }
@@ -162,15 +175,16 @@ show_physical_volume (vg_t vg,
   return g_variant_builder_end (&result);
 }
 
+/* Returns NULL if the volume group can't be opened */
 static GVariant *
-show_volume_group (const char *name)
+show_volume_group (lvm_t       lvm,
+                   const char *name)
 {
-  lvm_t lvm;
-  vg_t vg;
+  vg_t vg = NULL;
   GVariantBuilder result;
 
-  lvm = init_lvm ();
-  vg = lvm_vg_open (lvm, name, "r", 0);
+  if (lvm)
+    vg = lvm_vg_open (lvm, name, "r", 0);
 
   g_variant_builder_init (&result, G_VARIANT_TYPE ("a{sv}"));
   if (vg)
@@ -209,11 +223,41 @@ show_volume_group (const char *name)
     }
   else
     {
-      lvm_quit (lvm);
-      exit (2);
+      g_variant_builder_clear (&result);
+      return NULL;
     }
 
-  lvm_quit (lvm);
+  return g_variant_builder_end (&result);
+}
+
+/* The names of all volume groups and the information for all of them
+ * that could be opened, as returned by show_volume_group()
+ */
+static GVariant *
+report_volume_groups (lvm_t lvm)
+{
+  GVariant *names;
+  GVariantIter iter;
+  const gchar *name;
+  GVariantBuilder vgs;
+  GVariantBuilder result;
+
+  names = g_variant_ref_sink (list_volume_groups (lvm));
+
+  g_variant_builder_init (&vgs, G_VARIANT_TYPE ("aa{sv}"));
+  g_variant_iter_init (&iter, names);
+  while (g_variant_iter_next (&iter, "&s", &name))
+    {
+      GVariant *vg = show_volume_group (lvm, name);
+      if (vg)
+        g_variant_builder_add (&vgs, "@a{sv}", vg);
+    }
+
+  g_variant_builder_init (&result, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&result, "{sv}", "names", names);
+  g_variant_builder_add (&result, "{sv}", "vgs", g_variant_builder_end (&vgs));
+  g_variant_unref (names);
+
   return g_variant_builder_end (&result);
 }
 
@@ -235,11 +279,77 @@ write_all (int fd,
     }
 }
 
+static void
+write_reply (GVariant *result)
+{
+  GVariant *normal = NULL;
+  guint32 header[2] = { 1, 0 };
+
+  if (result)
+    {
+      normal = g_variant_get_normal_form (result);
+      header[0] = 0;
+      header[1] = g_variant_get_size (normal);
+    }
+
+  write_all (1, (const char *) header, sizeof header);
+  if (normal)
+    {
+      write_all (1, g_variant_get_data (normal), header[1]);
+      g_variant_unref (normal);
+    }
+}
+
+static void
+serve (void)
+{
+  lvm_t lvm;
+  char *line = NULL;
+  size_t line_size = 0;
+
+  lvm = init_lvm ();
+
+  while (getline (&line, &line_size, stdin) > 0)
+    {
+      GVariant *result = NULL;
+
+      g_strchomp (line);
+      if (strcmp (line, "list") == 0)
+        {
+          /* pick up volume groups that appeared since the last request */
+          if (lvm)
+            lvm_scan (lvm);
+          result = list_volume_groups (lvm);
+        }
+      else if (g_str_has_prefix (line, "show ") && line[5] != '\0')
+        result = show_volume_group (lvm, line + 5);
+      else if (strcmp (line, "report") == 0)
+        {
+          if (lvm)
+            lvm_scan (lvm);
+          result = report_volume_groups (lvm);
+        }
+      else
+        fprintf (stderr, "Unknown request: %s\n", line);
+
+      if (result)
+        g_variant_ref_sink (result);
+      write_reply (result);
+      if (result)
+        g_variant_unref (result);
+    }
+
+  free (line);
+  if (lvm)
+    lvm_quit (lvm);
+}
+
 int
 main (int argc,
       char **argv)
 {
   GVariant *result;
+  lvm_t lvm;
 
   while (argv[1] && argv[1][0] == '-')
     {
@@ -252,17 +362,34 @@ main (int argc,
       argv++;
     }
 
+  if (argv[1] && strcmp (argv[1], "serve") == 0)
+    {
+      serve ();
+      exit (0);
+    }
+
+  lvm = init_lvm ();
   if (argv[1] && strcmp (argv[1], "list") == 0)
-    result = list_volume_groups ();
+    result = list_volume_groups (lvm);
   else if (argv[1] && strcmp (argv[1], "show") == 0)
     {
       if (argv[2])
-        result = show_volume_group (argv[2]);
+        result = show_volume_group (lvm, argv[2]);
       else
         usage ();
+      if (result == NULL)
+        {
+          if (lvm)
+            lvm_quit (lvm);
+          exit (2);
+        }
     }
+  else if (argv[1] && strcmp (argv[1], "report") == 0)
+    result = report_volume_groups (lvm);
   else
     usage ();
+  if (lvm)
+    lvm_quit (lvm);
 
   if (opt_binary)
     {
@@ -0,0 +1,590 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* Replays uevents through UDisksLinuxProvider against a mocked
+ * sysfs/udev tree and reports how fast they are handled.
+ *
+ * The tree is either a synthetic topology of --devices disks with
+ * --partitions partitions each or a umockdev-record(1) snapshot
+ * (--snapshot).  The action stream is either a file with lines of
+ * the form "<action> <sysfs path>" (--actions) or --rounds rounds of
+ * --action for every block device in the tree.
+ *
+ * Must be run with umockdev-wrapper(1) and as a normal user - as root
+ * the daemon would share (and clean up) the state in /run/udisks2 of
+ * the system daemon.  See the "benchmark" target in Makefile.am.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <umockdev.h>
+
+#include <udisksdaemontypes.h>
+#include <udisksdaemon.h>
+#include <udiskslinuxprovider.h>
+#include <udisksmetrics.h>
+
+/* the stages reported, see udiskslinuxprovider.c */
+static const gchar *stages[] =
+{
+  "uevent-probe-wait",
+  "uevent-probe",
+  "main-loop-lag",
+  "uevent-modules",
+  "uevent-mdraid",
+  "uevent-drive",
+  "uevent-block",
+  "state-cleanup",
+  NULL
+};
+
+/* how long the provider must have been idle before the replay is considered done */
+#define QUIESCENT_USEC (200 * G_TIME_SPAN_MILLISECOND)
+
+/* give up if the replay takes longer than this */
+#define TIMEOUT_USEC (30 * G_TIME_SPAN_MINUTE)
+
+static gint opt_devices = 100;
+static gint opt_partitions = 0;
+static gint opt_rounds = 1;
+static gint opt_batch = 100;
+static gchar *opt_action = NULL;
+static gchar *opt_snapshot = NULL;
+static gchar *opt_actions = NULL;
+
+static GOptionEntry opt_entries[] =
+{
+  {"devices", 'n', 0, G_OPTION_ARG_INT, &opt_devices, "Number of synthetic disks (default: 100)", NULL},
+  {"partitions", 'p', 0, G_OPTION_ARG_INT, &opt_partitions, "Number of partitions per synthetic disk (default: 0)", NULL},
+  {"rounds", 'r', 0, G_OPTION_ARG_INT, &opt_rounds, "Number of uevents per device if no action stream is given (default: 1)", NULL},
+  {"action", 'a', 0, G_OPTION_ARG_STRING, &opt_action, "Action of the generated uevents (default: change)", NULL},
+  {"batch", 'b', 0, G_OPTION_ARG_INT, &opt_batch, "Number of uevents emitted per main loop iteration (default: 100)", NULL},
+  {"snapshot", 's', 0, G_OPTION_ARG_FILENAME, &opt_snapshot, "Use a umockdev-record snapshot instead of a synthetic topology", NULL},
+  {"actions", 0, 0, G_OPTION_ARG_FILENAME, &opt_actions, "Replay the \"<action> <sysfs path>\" lines of a file", NULL},
+  {NULL}
+};
+
+typedef struct
+{
+  gchar *action;
+  gchar *sysfs_path;
+} Event;
+
+typedef struct
+{
+  UMockdevTestbed *testbed;
+  UDisksLinuxProvider *provider;
+  GMainLoop *loop;
+
+  GPtrArray *events;
+  guint next_event;
+
+  gint64 start_time;
+  gint64 last_sent_time;
+  gint64 last_changed_time;
+  gboolean timed_out;
+} Replay;
+
+static void
+event_free (Event *event)
+{
+  g_free (event->action);
+  g_free (event->sysfs_path);
+  g_free (event);
+}
+
+static Event *
+event_new (const gchar *action,
+           const gchar *sysfs_path)
+{
+  Event *event = g_new0 (Event, 1);
+  event->action = g_strdup (action);
+  event->sysfs_path = g_strdup (sysfs_path);
+  return event;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+add_synthetic_topology (UMockdevTestbed *testbed)
+{
+  guint minor = 0;
+  gint n, m;
+
+  /* 100 MiB disks with 10 MiB partitions, using blkext device numbers */
+  for (n = 0; n < opt_devices; n++)
+    {
+      gchar *name = g_strdup_printf ("bench%d", n);
+      gchar *dev_file = g_strdup_printf ("/dev/%s", name);
+      gchar *dev = g_strdup_printf ("259:%u", minor);
+      gchar *minor_str = g_strdup_printf ("%u", minor);
+      gchar *serial = g_strdup_printf ("BENCH%08d", n);
+      gchar *disk_path;
+
+      disk_path = umockdev_testbed_add_device (testbed, "block", name, NULL,
+                                               /* attributes */
+                                               "dev", dev,
+                                               "size", "204800",
+                                               "removable", "0",
+                                               "ro", "0",
+                                               "queue/rotational", "0",
+                                               "queue/logical_block_size", "512",
+                                               NULL,
+                                               /* properties */
+                                               "DEVNAME", dev_file,
+                                               "DEVTYPE", "disk",
+                                               "MAJOR", "259",
+                                               "MINOR", minor_str,
+                                               "ID_SERIAL", serial,
+                                               "ID_SERIAL_SHORT", serial,
+                                               "ID_MODEL", "Benchmark_Disk",
+                                               "ID_VENDOR", "UDisks",
+                                               NULL);
+      if (opt_partitions > 0)
+        umockdev_testbed_set_property (testbed, disk_path, "ID_PART_TABLE_TYPE", "gpt");
+      minor++;
+
+      for (m = 1; m <= opt_partitions; m++)
+        {
+          gchar *part_name = g_strdup_printf ("%sp%d", name, m);
+          gchar *part_dev_file = g_strdup_printf ("/dev/%s", part_name);
+          gchar *part_dev = g_strdup_printf ("259:%u", minor);
+          gchar *part_minor_str = g_strdup_printf ("%u", minor);
+          gchar *part_number = g_strdup_printf ("%d", m);
+          gchar *part_start = g_strdup_printf ("%d", m * 20480);
+          gchar *part_path;
+
+          part_path = umockdev_testbed_add_device (testbed, "block", part_name, disk_path,
+                                                   /* attributes */
+                                                   "dev", part_dev,
+                                                   "partition", part_number,
+                                                   "start", part_start,
+                                                   "size", "20480",
+                                                   "ro", "0",
+                                                   NULL,
+                                                   /* properties */
+                                                   "DEVNAME", part_dev_file,
+                                                   "DEVTYPE", "partition",
+                                                   "MAJOR", "259",
+                                                   "MINOR", part_minor_str,
+                                                   "ID_PART_ENTRY_SCHEME", "gpt",
+                                                   "ID_PART_ENTRY_NUMBER", part_number,
+                                                   "ID_PART_ENTRY_OFFSET", part_start,
+                                                   "ID_PART_ENTRY_SIZE", "20480",
+                                                   "ID_FS_TYPE", "ext4",
+                                                   "ID_FS_USAGE", "filesystem",
+                                                   NULL);
+          minor++;
+
+          g_free (part_path);
+          g_free (part_start);
+          g_free (part_number);
+          g_free (part_minor_str);
+          g_free (part_dev);
+          g_free (part_dev_file);
+          g_free (part_name);
+        }
+
+      g_free (disk_path);
+      g_free (serial);
+      g_free (minor_str);
+      g_free (dev);
+      g_free (dev_file);
+      g_free (name);
+    }
+}
+
+static gboolean
+load_actions (GPtrArray    *events,
+              const gchar  *filename,
+              GError      **error)
+{
+  gboolean ret = FALSE;
+  gchar *contents = NULL;
+  gchar **lines = NULL;
+  guint n;
+
+  if (!g_file_get_contents (filename, &contents, NULL, error))
+    goto out;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (n = 0; lines[n] != NULL; n++)
+    {
+      gchar *line = g_strstrip (lines[n]);
+      gchar **tokens;
+
+      if (line[0] == '\0' || line[0] == '#')
+        continue;
+
+      tokens = g_strsplit_set (line, " \t", 2);
+      if (g_strv_length (tokens) != 2)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "%s:%u: expected \"<action> <sysfs path>\"",
+                       filename, n + 1);
+          g_strfreev (tokens);
+          goto out;
+        }
+      g_ptr_array_add (events, event_new (tokens[0], g_strstrip (tokens[1])));
+      g_strfreev (tokens);
+    }
+
+  ret = TRUE;
+
+ out:
+  g_strfreev (lines);
+  g_free (contents);
+  return ret;
+}
+
+static void
+generate_actions (GPtrArray   *events,
+                  GUdevClient *client)
+{
+  GList *devices;
+  GList *l;
+  gint round;
+
+  devices = g_udev_client_query_by_subsystem (client, "block");
+  for (round = 0; round < opt_rounds; round++)
+    {
+      for (l = devices; l != NULL; l = l->next)
+        g_ptr_array_add (events, event_new (opt_action, g_udev_device_get_sysfs_path (G_UDEV_DEVICE (l->data))));
+    }
+  g_list_free_full (devices, g_object_unref);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+on_provider_changed (UDisksProvider *provider,
+                     gpointer        user_data)
+{
+  Replay *replay = user_data;
+  replay->last_changed_time = g_get_monotonic_time ();
+}
+
+/* Runs at low priority so the daemon gets to handle what has been
+ * emitted so far before more uevents are emitted - otherwise the
+ * socket of the udev monitor may overflow
+ */
+static gboolean
+on_feed (gpointer user_data)
+{
+  Replay *replay = user_data;
+  gint n;
+
+  for (n = 0; n < opt_batch && replay->next_event < replay->events->len; n++)
+    {
+      Event *event = g_ptr_array_index (replay->events, replay->next_event++);
+      umockdev_testbed_uevent (replay->testbed, event->sysfs_path, event->action);
+    }
+  replay->last_sent_time = g_get_monotonic_time ();
+
+  return replay->next_event < replay->events->len;
+}
+
+static gboolean
+on_check_done (gpointer user_data)
+{
+  Replay *replay = user_data;
+  gint64 now = g_get_monotonic_time ();
+
+  if (now - replay->start_time > TIMEOUT_USEC)
+    {
+      replay->timed_out = TRUE;
+      g_main_loop_quit (replay->loop);
+      return FALSE;
+    }
+
+  if (replay->next_event < replay->events->len)
+    return TRUE;
+
+  if (udisks_linux_provider_get_probe_queue_depth (replay->provider) > 0)
+    return TRUE;
+
+  if (now - MAX (replay->last_sent_time, replay->last_changed_time) < QUIESCENT_USEC)
+    return TRUE;
+
+  g_main_loop_quit (replay->loop);
+  return FALSE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  guint64 count;
+  guint64 total_usec;
+  guint64 buckets[64];
+} Stage;
+
+static void
+get_stage (GVariant    *durations,
+           const gchar *name,
+           Stage       *stage)
+{
+  GVariant *dict;
+  GVariant *buckets;
+  const guint64 *data;
+  gsize num_buckets;
+
+  memset (stage, 0, sizeof (Stage));
+
+  dict = g_variant_lookup_value (durations, name, G_VARIANT_TYPE_VARDICT);
+  if (dict == NULL)
+    return;
+
+  g_variant_lookup (dict, "count", "t", &stage->count);
+  g_variant_lookup (dict, "total-usec", "t", &stage->total_usec);
+  buckets = g_variant_lookup_value (dict, "buckets", G_VARIANT_TYPE ("at"));
+  if (buckets != NULL)
+    {
+      data = g_variant_get_fixed_array (buckets, &num_buckets, sizeof (guint64));
+      memcpy (stage->buckets, data, MIN (num_buckets, G_N_ELEMENTS (stage->buckets)) * sizeof (guint64));
+      g_variant_unref (buckets);
+    }
+  g_variant_unref (dict);
+}
+
+/* The histograms only have power-of-two buckets so this returns the
+ * upper bound of the bucket the percentile falls into
+ */
+static guint64
+get_percentile (const Stage *stage,
+                gdouble      percentile)
+{
+  guint64 threshold;
+  guint64 seen = 0;
+  guint n;
+
+  if (stage->count == 0)
+    return 0;
+
+  threshold = MAX ((guint64) (stage->count * percentile / 100.0 + 0.5), 1);
+  for (n = 0; n < G_N_ELEMENTS (stage->buckets); n++)
+    {
+      seen += stage->buckets[n];
+      if (seen >= threshold)
+        break;
+    }
+  return n == 0 ? 0 : G_GUINT64_CONSTANT (1) << n;
+}
+
+static void
+print_stages (const gchar *title,
+              GVariant    *before,
+              GVariant    *after)
+{
+  guint n, m;
+
+  g_print ("%s (per-stage latency in usec, percentiles rounded up to powers of two):\n", title);
+  g_print ("  %-20s %10s %10s %10s %10s %10s\n", "stage", "count", "mean", "p50", "p90", "p99");
+  for (n = 0; stages[n] != NULL; n++)
+    {
+      Stage stage_before, stage;
+
+      get_stage (after, stages[n], &stage);
+      if (before != NULL)
+        {
+          get_stage (before, stages[n], &stage_before);
+          stage.count -= stage_before.count;
+          stage.total_usec -= stage_before.total_usec;
+          for (m = 0; m < G_N_ELEMENTS (stage.buckets); m++)
+            stage.buckets[m] -= stage_before.buckets[m];
+        }
+      if (stage.count == 0)
+        continue;
+
+      g_print ("  %-20s %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT
+               " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT "\n",
+               stages[n],
+               stage.count,
+               stage.total_usec / stage.count,
+               get_percentile (&stage, 50.0),
+               get_percentile (&stage, 90.0),
+               get_percentile (&stage, 99.0));
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+int
+main (int    argc,
+      char **argv)
+{
+  int ret = 1;
+  GOptionContext *opt_context = NULL;
+  GError *error = NULL;
+  GTestDBus *bus = NULL;
+  GDBusConnection *connection = NULL;
+  UDisksDaemon *daemon = NULL;
+  GVariant *coldplug_durations = NULL;
+  GVariant *replay_durations = NULL;
+  Replay replay;
+  gint64 coldplug_usec;
+  gint64 replay_usec;
+  guint num_devices;
+  GList *devices;
+  struct rusage usage;
+
+  memset (&replay, 0, sizeof (Replay));
+  replay.events = g_ptr_array_new_with_free_func ((GDestroyNotify) event_free);
+
+  opt_context = g_option_context_new ("- uevent replay benchmark");
+  g_option_context_add_main_entries (opt_context, opt_entries, NULL);
+  if (!g_option_context_parse (opt_context, &argc, &argv, &error))
+    {
+      g_printerr ("Error parsing options: %s\n", error->message);
+      g_clear_error (&error);
+      goto out;
+    }
+  if (opt_action == NULL)
+    opt_action = g_strdup ("change");
+
+  if (!umockdev_in_mock_environment ())
+    {
+      g_printerr ("Must be run with umockdev-wrapper\n");
+      goto out;
+    }
+  if (getuid () == 0)
+    {
+      g_printerr ("Must not be run as root\n");
+      goto out;
+    }
+
+  /* set up the mocked sysfs/udev tree before the daemon coldplugs it */
+  replay.testbed = umockdev_testbed_new ();
+  if (opt_snapshot != NULL)
+    {
+      if (!umockdev_testbed_add_from_file (replay.testbed, opt_snapshot, &error))
+        {
+          g_printerr ("Error loading %s: %s\n", opt_snapshot, error->message);
+          g_clear_error (&error);
+          goto out;
+        }
+    }
+  else
+    {
+      add_synthetic_topology (replay.testbed);
+    }
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  if (connection == NULL)
+    {
+      g_printerr ("Error connecting to the private message bus: %s\n", error->message);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  /* coldplug happens while constructing the daemon */
+  replay.start_time = g_get_monotonic_time ();
+  daemon = udisks_daemon_new (connection,
+                              TRUE,   /* disable_modules */
+                              FALSE,  /* force_load_modules */
+                              TRUE);  /* uninstalled */
+  coldplug_usec = g_get_monotonic_time () - replay.start_time;
+  coldplug_durations = g_variant_ref_sink (udisks_metrics_get_durations (udisks_daemon_get_metrics (daemon)));
+
+  replay.provider = udisks_daemon_get_linux_provider (daemon);
+  replay.loop = g_main_loop_new (NULL, FALSE);
+  g_signal_connect (replay.provider, "changed", G_CALLBACK (on_provider_changed), &replay);
+
+  devices = g_udev_client_query_by_subsystem (udisks_linux_provider_get_udev_client (replay.provider), "block");
+  num_devices = g_list_length (devices);
+  g_list_free_full (devices, g_object_unref);
+
+  if (opt_actions != NULL)
+    {
+      if (!load_actions (replay.events, opt_actions, &error))
+        {
+          g_printerr ("Error loading %s: %s\n", opt_actions, error->message);
+          g_clear_error (&error);
+          goto out;
+        }
+    }
+  else
+    {
+      generate_actions (replay.events, udisks_linux_provider_get_udev_client (replay.provider));
+    }
+
+  replay.start_time = g_get_monotonic_time ();
+  replay.last_sent_time = replay.start_time;
+  replay.last_changed_time = replay.start_time;
+  g_idle_add_full (G_PRIORITY_LOW, on_feed, &replay, NULL);
+  g_timeout_add (20, on_check_done, &replay);
+  g_main_loop_run (replay.loop);
+
+  if (replay.timed_out)
+    {
+      g_printerr ("Timed out waiting for the uevents to be handled\n");
+      goto out;
+    }
+
+  replay_usec = MAX (replay.last_changed_time - replay.start_time, 1);
+  replay_durations = g_variant_ref_sink (udisks_metrics_get_durations (udisks_daemon_get_metrics (daemon)));
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  g_print ("block devices:     %u\n", num_devices);
+  g_print ("coldplug:          %.3f s (%.0f devices/s)\n",
+           coldplug_usec / 1e6,
+           num_devices * 1e6 / MAX (coldplug_usec, 1));
+  g_print ("uevents replayed:  %u in %.3f s (%.0f uevents/s)\n",
+           replay.events->len,
+           replay_usec / 1e6,
+           replay.events->len * 1e6 / replay_usec);
+  g_print ("peak RSS:          %ld KiB\n", usage.ru_maxrss);
+  g_print ("\n");
+  print_stages ("coldplug", NULL, coldplug_durations);
+  g_print ("\n");
+  print_stages ("replay", coldplug_durations, replay_durations);
+
+  ret = 0;
+
+ out:
+  if (replay_durations != NULL)
+    g_variant_unref (replay_durations);
+  if (coldplug_durations != NULL)
+    g_variant_unref (coldplug_durations);
+  if (replay.loop != NULL)
+    g_main_loop_unref (replay.loop);
+  g_clear_object (&daemon);
+  g_clear_object (&connection);
+  if (bus != NULL)
+    {
+      g_test_dbus_down (bus);
+      g_object_unref (bus);
+    }
+  g_clear_object (&replay.testbed);
+  g_ptr_array_unref (replay.events);
+  g_option_context_free (opt_context);
+  g_free (opt_action);
+  g_free (opt_snapshot);
+  g_free (opt_actions);
+  return ret;
+}
@@ -30,6 +30,8 @@
 #include <udisksdaemon.h>
 #include <udisksspawnedjob.h>
 #include <udisksthreadedjob.h>
+#include <udisksdaemonutil.h>
+#include <udisksmethodqueue.h>
 
 #include "testutil.h"
 
@@ -592,6 +594,229 @@ test_threaded_job_override_signal_handler (void)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static void
+test_parse_device_spec (void)
+{
+  const gchar *value;
+
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("/dev/sda1", &value), ==, UDISKS_DEVICE_SPEC_PATH);
+  g_assert_cmpstr (value, ==, "/dev/sda1");
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("UUID=1234-5678", &value), ==, UDISKS_DEVICE_SPEC_UUID);
+  g_assert_cmpstr (value, ==, "1234-5678");
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("LABEL=My Disk", &value), ==, UDISKS_DEVICE_SPEC_LABEL);
+  g_assert_cmpstr (value, ==, "My Disk");
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("PARTUUID=abcd-01", &value), ==, UDISKS_DEVICE_SPEC_PARTUUID);
+  g_assert_cmpstr (value, ==, "abcd-01");
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("PARTLABEL=root", &value), ==, UDISKS_DEVICE_SPEC_PARTLABEL);
+  g_assert_cmpstr (value, ==, "root");
+
+  /* an empty value can't refer to anything */
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("UUID=", NULL), ==, UDISKS_DEVICE_SPEC_NONE);
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("LABEL=", NULL), ==, UDISKS_DEVICE_SPEC_NONE);
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("", NULL), ==, UDISKS_DEVICE_SPEC_NONE);
+
+  /* prefixes are case-sensitive and anything else is a path */
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("uuid=1234", &value), ==, UDISKS_DEVICE_SPEC_PATH);
+  g_assert_cmpstr (value, ==, "uuid=1234");
+  g_assert_cmpint (udisks_daemon_util_parse_device_spec ("proc", &value), ==, UDISKS_DEVICE_SPEC_PATH);
+}
+
+static void
+test_device_spec_index (void)
+{
+  UDisksDeviceSpecIndex *index;
+  GObject *by_device, *by_symlink, *by_uuid, *by_uuid2, *by_partlabel, *empty;
+  const gchar *symlinks[] = {"/dev/disk/by-id/foo", "/dev/disk/by-uuid/1234", NULL};
+  GList *entries;
+
+  by_device = g_object_new (G_TYPE_OBJECT, NULL);
+  by_symlink = g_object_new (G_TYPE_OBJECT, NULL);
+  by_uuid = g_object_new (G_TYPE_OBJECT, NULL);
+  by_uuid2 = g_object_new (G_TYPE_OBJECT, NULL);
+  by_partlabel = g_object_new (G_TYPE_OBJECT, NULL);
+  empty = g_object_new (G_TYPE_OBJECT, NULL);
+
+  index = udisks_daemon_util_device_spec_index_new ();
+  udisks_daemon_util_device_spec_index_add (index, "/dev/sda1", by_device);
+  udisks_daemon_util_device_spec_index_add (index, "/dev/disk/by-id/foo", by_symlink);
+  udisks_daemon_util_device_spec_index_add (index, "UUID=1234", by_uuid);
+  udisks_daemon_util_device_spec_index_add (index, "UUID=1234", by_uuid2);
+  udisks_daemon_util_device_spec_index_add (index, "PARTLABEL=root", by_partlabel);
+  udisks_daemon_util_device_spec_index_add (index, "LABEL=", empty);
+
+  /* every identifier matches, each entry is returned once */
+  entries = udisks_daemon_util_device_spec_index_lookup (index, "/dev/sda1", symlinks, NULL, "1234", "root", NULL);
+  g_assert_cmpuint (g_list_length (entries), ==, 5);
+  g_assert (g_list_find (entries, by_device) != NULL);
+  g_assert (g_list_find (entries, by_symlink) != NULL);
+  g_assert (g_list_find (entries, by_uuid) != NULL);
+  g_assert (g_list_find (entries, by_uuid2) != NULL);
+  g_assert (g_list_find (entries, by_partlabel) != NULL);
+  g_list_free_full (entries, g_object_unref);
+
+  /* values are only looked up in the table for their kind of identifier */
+  entries = udisks_daemon_util_device_spec_index_lookup (index, "/dev/sdb1", NULL, "1234", NULL, NULL, "root");
+  g_assert (entries == NULL);
+
+  /* an entry with an empty value is never returned */
+  entries = udisks_daemon_util_device_spec_index_lookup (index, NULL, NULL, "", "", NULL, NULL);
+  g_assert (entries == NULL);
+
+  udisks_daemon_util_device_spec_index_clear (index);
+  entries = udisks_daemon_util_device_spec_index_lookup (index, "/dev/sda1", symlinks, NULL, "1234", "root", NULL);
+  g_assert (entries == NULL);
+  udisks_daemon_util_device_spec_index_free (index);
+
+  g_object_unref (empty);
+  g_object_unref (by_partlabel);
+  g_object_unref (by_uuid2);
+  g_object_unref (by_uuid);
+  g_object_unref (by_symlink);
+  g_object_unref (by_device);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  UDisksMethodQueue *queue;
+  GObject *call;
+  const gchar *sender;
+  const gchar *serialize_key;
+  const gchar *name;
+  GMutex *lock;
+  GPtrArray *admitted;
+} MethodQueueCall;
+
+static gpointer
+method_queue_enter_thread_func (gpointer user_data)
+{
+  MethodQueueCall *data = user_data;
+
+  udisks_method_queue_enter_for_caller (data->queue, data->call, data->sender, data->serialize_key);
+
+  if (data->admitted != NULL)
+    {
+      g_mutex_lock (data->lock);
+      g_ptr_array_add (data->admitted, (gpointer) data->name);
+      g_mutex_unlock (data->lock);
+      /* completes the call */
+      g_clear_object (&data->call);
+    }
+  return NULL;
+}
+
+static void
+method_queue_wait_for_queued (UDisksMethodQueue *queue,
+                              guint              num_queued)
+{
+  guint n;
+
+  for (;;)
+    {
+      udisks_method_queue_get_stats (queue, &n, NULL, NULL, NULL, NULL);
+      if (n == num_queued)
+        break;
+      g_usleep (1000);
+    }
+}
+
+static void
+test_method_queue_serialize (void)
+{
+  UDisksMethodQueue *queue;
+  MethodQueueCall data;
+  GObject *call1, *call3;
+  GThread *thread;
+  guint num_queued, num_in_flight;
+
+  queue = udisks_method_queue_new (4);
+  call1 = g_object_new (G_TYPE_OBJECT, NULL);
+  call3 = g_object_new (G_TYPE_OBJECT, NULL);
+
+  udisks_method_queue_enter_for_caller (queue, call1, ":1.1", "k");
+
+  /* a call with the same key waits even though there is room */
+  memset (&data, 0, sizeof (MethodQueueCall));
+  data.queue = queue;
+  data.call = g_object_new (G_TYPE_OBJECT, NULL);
+  data.sender = ":1.2";
+  data.serialize_key = "k";
+  thread = g_thread_new ("method-queue-test", method_queue_enter_thread_func, &data);
+  method_queue_wait_for_queued (queue, 1);
+
+  /* ... while one with a different key doesn't */
+  udisks_method_queue_enter_for_caller (queue, call3, ":1.2", "other");
+  udisks_method_queue_get_stats (queue, &num_queued, &num_in_flight, NULL, NULL, NULL);
+  g_assert_cmpuint (num_queued, ==, 1);
+  g_assert_cmpuint (num_in_flight, ==, 2);
+
+  /* finalizing the first call releases the key */
+  g_object_unref (call1);
+  g_thread_join (thread);
+  udisks_method_queue_get_stats (queue, &num_queued, &num_in_flight, NULL, NULL, NULL);
+  g_assert_cmpuint (num_queued, ==, 0);
+  g_assert_cmpuint (num_in_flight, ==, 2);
+
+  g_object_unref (data.call);
+  g_object_unref (call3);
+  udisks_method_queue_get_stats (queue, &num_queued, &num_in_flight, NULL, NULL, NULL);
+  g_assert_cmpuint (num_in_flight, ==, 0);
+
+  g_object_unref (queue);
+}
+
+static void
+test_method_queue_fairness (void)
+{
+  UDisksMethodQueue *queue;
+  MethodQueueCall data[4];
+  GThread *threads[4];
+  const gchar *names[4] = {"a1", "a2", "a3", "b1"};
+  GObject *blocker;
+  GPtrArray *admitted;
+  GMutex lock;
+  guint n;
+
+  g_mutex_init (&lock);
+  admitted = g_ptr_array_new ();
+  queue = udisks_method_queue_new (1);
+  blocker = g_object_new (G_TYPE_OBJECT, NULL);
+
+  udisks_method_queue_enter_for_caller (queue, blocker, ":1.1", NULL);
+
+  /* one caller queues three calls before another caller queues one */
+  for (n = 0; n < G_N_ELEMENTS (data); n++)
+    {
+      memset (&data[n], 0, sizeof (MethodQueueCall));
+      data[n].queue = queue;
+      data[n].call = g_object_new (G_TYPE_OBJECT, NULL);
+      data[n].sender = names[n][0] == 'a' ? ":1.1" : ":1.2";
+      data[n].name = names[n];
+      data[n].lock = &lock;
+      data[n].admitted = admitted;
+      threads[n] = g_thread_new ("method-queue-test", method_queue_enter_thread_func, &data[n]);
+      method_queue_wait_for_queued (queue, n + 1);
+    }
+
+  /* FIFO for each caller, round-robin between callers */
+  g_object_unref (blocker);
+  for (n = 0; n < G_N_ELEMENTS (threads); n++)
+    g_thread_join (threads[n]);
+
+  g_assert_cmpuint (admitted->len, ==, 4);
+  g_assert_cmpstr (admitted->pdata[0], ==, "a1");
+  g_assert_cmpstr (admitted->pdata[1], ==, "b1");
+  g_assert_cmpstr (admitted->pdata[2], ==, "a2");
+  g_assert_cmpstr (admitted->pdata[3], ==, "a3");
+
+  g_object_unref (queue);
+  g_ptr_array_unref (admitted);
+  g_mutex_clear (&lock);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 int
 main (int    argc,
       char **argv)
@@ -629,6 +854,10 @@ main (int    argc,
   g_test_add_func ("/udisks/daemon/threaded_job/cancelled_at_start", test_threaded_job_cancelled_at_start);
   g_test_add_func ("/udisks/daemon/threaded_job/cancelled_midway", test_threaded_job_cancelled_midway);
   g_test_add_func ("/udisks/daemon/threaded_job/override_signal_handler", test_threaded_job_override_signal_handler);
+  g_test_add_func ("/udisks/daemon/util/parse_device_spec", test_parse_device_spec);
+  g_test_add_func ("/udisks/daemon/util/device_spec_index", test_device_spec_index);
+  g_test_add_func ("/udisks/daemon/method_queue/serialize", test_method_queue_serialize);
+  g_test_add_func ("/udisks/daemon/method_queue/fairness", test_method_queue_fairness);
 
   ret = g_test_run();
 
@@ -34,6 +34,11 @@ struct _UDisksConfigManager {
 
   UDisksModuleLoadPreference load_preference;
   GList *modules;
+
+  guint probe_workers;
+  guint method_workers;
+  guint housekeeping_workers;
+  guint housekeeping_timeout;
 };
 
 struct _UDisksConfigManagerClass {
@@ -53,6 +58,24 @@ enum
 static const gchar *modules_group_name = PACKAGE_NAME_UDISKS2;
 static const gchar *modules_key = "modules";
 static const gchar *modules_load_preference_key = "modules_load_preference";
+static const gchar *probe_workers_key = "probe_workers";
+static const gchar *method_workers_key = "method_workers";
+static const gchar *housekeeping_workers_key = "housekeeping_workers";
+static const gchar *housekeeping_timeout_key = "housekeeping_timeout";
+
+#define PROBE_WORKERS_DEFAULT 4
+#define PROBE_WORKERS_MAX     64
+
+#define METHOD_WORKERS_DEFAULT 16
+#define METHOD_WORKERS_MAX     1024
+
+#define HOUSEKEEPING_WORKERS_DEFAULT 8
+#define HOUSEKEEPING_WORKERS_MAX     64
+
+/* in seconds */
+#define HOUSEKEEPING_TIMEOUT_DEFAULT 120
+#define HOUSEKEEPING_TIMEOUT_MIN     10
+#define HOUSEKEEPING_TIMEOUT_MAX     3600
 
 static void
 udisks_config_manager_get_property (GObject    *object,
@@ -129,6 +152,39 @@ strtrim (const gchar *s)
   return result;
 }
 
+/* Reads an integer option, falling back to @default_value if it is missing or out of range */
+static guint
+get_integer_key (GKeyFile    *config_file,
+                 const gchar *key,
+                 gint         min_value,
+                 gint         max_value,
+                 gint         default_value)
+{
+  GError *error = NULL;
+  gint value;
+
+  value = g_key_file_get_integer (config_file,
+                                  modules_group_name,
+                                  key,
+                                  &error);
+  if (error != NULL)
+    {
+      g_clear_error (&error);
+      udisks_debug ("No '%s' found in configuration file", key);
+      return default_value;
+    }
+
+  if (value < min_value || value > max_value)
+    {
+      udisks_warning ("Invalid value used for '%s': %d"
+                      "; expected a number between %d and %d, defaulting to %d",
+                      key, value, min_value, max_value, default_value);
+      return default_value;
+    }
+
+  return value;
+}
+
 static void
 udisks_config_manager_constructed (GObject *object)
 {
@@ -226,6 +282,29 @@ udisks_config_manager_constructed (GObject *object)
           manager->load_preference = UDISKS_MODULE_LOAD_ONDEMAND;
         }
 
+      /* Read the number of uevent probing threads. */
+      manager->probe_workers = get_integer_key (config_file,
+                                                probe_workers_key,
+                                                1, PROBE_WORKERS_MAX,
+                                                PROBE_WORKERS_DEFAULT);
+
+      /* Read the number of D-Bus method calls handled at once. */
+      manager->method_workers = get_integer_key (config_file,
+                                                 method_workers_key,
+                                                 1, METHOD_WORKERS_MAX,
+                                                 METHOD_WORKERS_DEFAULT);
+
+      /* Read the number of drives housekeeping is done for at once. */
+      manager->housekeeping_workers = get_integer_key (config_file,
+                                                       housekeeping_workers_key,
+                                                       1, HOUSEKEEPING_WORKERS_MAX,
+                                                       HOUSEKEEPING_WORKERS_DEFAULT);
+
+      /* Read the time after which housekeeping for a drive is abandoned. */
+      manager->housekeeping_timeout = get_integer_key (config_file,
+                                                       housekeeping_timeout_key,
+                                                       HOUSEKEEPING_TIMEOUT_MIN, HOUSEKEEPING_TIMEOUT_MAX,
+                                                       HOUSEKEEPING_TIMEOUT_DEFAULT);
     }
   else
     {
@@ -233,6 +312,10 @@ udisks_config_manager_constructed (GObject *object)
       udisks_warning ("Can't load configuration file %s", conf_filename);
       manager->modules = NULL; /* NULL == '*' */
       manager->load_preference = UDISKS_MODULE_LOAD_ONDEMAND;
+      manager->probe_workers = PROBE_WORKERS_DEFAULT;
+      manager->method_workers = METHOD_WORKERS_DEFAULT;
+      manager->housekeeping_workers = HOUSEKEEPING_WORKERS_DEFAULT;
+      manager->housekeeping_timeout = HOUSEKEEPING_TIMEOUT_DEFAULT;
     }
 
 
@@ -315,6 +398,10 @@ udisks_config_manager_class_init (UDisksConfigManagerClass *klass)
 static void
 udisks_config_manager_init (UDisksConfigManager *manager)
 {
+  manager->probe_workers = PROBE_WORKERS_DEFAULT;
+  manager->method_workers = METHOD_WORKERS_DEFAULT;
+  manager->housekeeping_workers = HOUSEKEEPING_WORKERS_DEFAULT;
+  manager->housekeeping_timeout = HOUSEKEEPING_TIMEOUT_DEFAULT;
 }
 
 UDisksConfigManager *
@@ -363,3 +450,31 @@ udisks_config_manager_get_load_preference (UDisksConfigManager *manager)
                         UDISKS_MODULE_LOAD_ONDEMAND);
   return manager->load_preference;
 }
+
+guint
+udisks_config_manager_get_probe_workers (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), PROBE_WORKERS_DEFAULT);
+  return manager->probe_workers;
+}
+
+guint
+udisks_config_manager_get_method_workers (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), METHOD_WORKERS_DEFAULT);
+  return manager->method_workers;
+}
+
+guint
+udisks_config_manager_get_housekeeping_workers (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), HOUSEKEEPING_WORKERS_DEFAULT);
+  return manager->housekeeping_workers;
+}
+
+guint
+udisks_config_manager_get_housekeeping_timeout (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), HOUSEKEEPING_TIMEOUT_DEFAULT);
+  return manager->housekeeping_timeout;
+}
@@ -55,6 +55,10 @@ const GList          *udisks_config_manager_get_modules     (UDisksConfigManager
 gboolean              udisks_config_manager_get_modules_all (UDisksConfigManager *manager);
 UDisksModuleLoadPreference
                       udisks_config_manager_get_load_preference (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_probe_workers (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_method_workers (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_housekeeping_workers (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_housekeeping_timeout (UDisksConfigManager *manager);
 
 G_END_DECLS
 
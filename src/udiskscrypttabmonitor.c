@@ -36,6 +36,7 @@
 #include "udiskscrypttabentry.h"
 #include "udisksprivate.h"
 #include "udiskslogging.h"
+#include "udisksdaemonutil.h"
 
 /**
  * SECTION:udiskscrypttabmonitor
@@ -59,6 +60,11 @@ struct _UDisksCrypttabMonitor
   gboolean have_data;
   GList *crypttab_entries;
 
+  /* index of the entries in @crypttab_entries by what their device
+   * refers to - the device file, LABEL= or UUID=
+   */
+  UDisksDeviceSpecIndex *entries_index;
+
   GFileMonitor *file_monitor;
 };
 
@@ -98,6 +104,8 @@ udisks_crypttab_monitor_finalize (GObject *object)
 
   g_object_unref (monitor->file_monitor);
 
+  udisks_daemon_util_device_spec_index_free (monitor->entries_index);
+
   g_list_foreach (monitor->crypttab_entries, (GFunc) g_object_unref, NULL);
   g_list_free (monitor->crypttab_entries);
 
@@ -109,6 +117,7 @@ static void
 udisks_crypttab_monitor_init (UDisksCrypttabMonitor *monitor)
 {
   monitor->crypttab_entries = NULL;
+  monitor->entries_index = udisks_daemon_util_device_spec_index_new ();
 }
 
 static void
@@ -320,6 +329,8 @@ udisks_crypttab_monitor_invalidate (UDisksCrypttabMonitor *monitor)
 {
   monitor->have_data = FALSE;
 
+  udisks_daemon_util_device_spec_index_clear (monitor->entries_index);
+
   g_list_foreach (monitor->crypttab_entries, (GFunc) g_object_unref, NULL);
   g_list_free (monitor->crypttab_entries);
   monitor->crypttab_entries = NULL;
@@ -328,6 +339,31 @@ udisks_crypttab_monitor_invalidate (UDisksCrypttabMonitor *monitor)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static void
+index_entry (UDisksCrypttabMonitor *monitor,
+             UDisksCrypttabEntry   *entry)
+{
+  const gchar *device;
+  const gchar *value;
+
+  device = udisks_crypttab_entry_get_device (entry);
+  switch (udisks_daemon_util_parse_device_spec (device, &value))
+    {
+    case UDISKS_DEVICE_SPEC_UUID:
+    case UDISKS_DEVICE_SPEC_LABEL:
+      break;
+    case UDISKS_DEVICE_SPEC_PATH:
+      if (g_str_has_prefix (value, "/dev"))
+        break;
+      /* fall through */
+    default:
+      /* not a device entry or not one we look up */
+      return;
+    }
+
+  udisks_daemon_util_device_spec_index_add (monitor->entries_index, device, G_OBJECT (entry));
+}
+
 static gboolean
 have_entry (UDisksCrypttabMonitor *monitor,
             UDisksCrypttabEntry   *entry)
@@ -407,6 +443,7 @@ udisks_crypttab_monitor_ensure (UDisksCrypttabMonitor *monitor)
       if (!have_entry (monitor, entry))
         {
           monitor->crypttab_entries = g_list_prepend (monitor->crypttab_entries, entry);
+          index_entry (monitor, entry);
         }
       else
         {
@@ -446,3 +483,43 @@ udisks_crypttab_monitor_get_entries (UDisksCrypttabMonitor  *monitor)
   return ret;
 }
 
+/**
+ * udisks_crypttab_monitor_get_entries_for_device:
+ * @monitor: A #UDisksCrypttabMonitor.
+ * @device: (allow-none): The device file of the block device or %NULL.
+ * @symlinks: (allow-none): The symlinks for the block device or %NULL.
+ * @label: (allow-none): The filesystem label or %NULL.
+ * @uuid: (allow-none): The filesystem UUID or %NULL.
+ *
+ * Gets all /etc/crypttab entries referring to a block device with
+ * the given identifiers - either by device file or symlink or by
+ * <literal>LABEL=</literal> or <literal>UUID=</literal>.
+ *
+ * This uses an index maintained by @monitor so it does not have to
+ * look at every entry.
+ *
+ * Returns: (transfer full) (element-type UDisksCrypttabEntry): A list of #UDisksCrypttabEntry objects that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_crypttab_monitor_get_entries_for_device (UDisksCrypttabMonitor  *monitor,
+                                                const gchar            *device,
+                                                const gchar *const     *symlinks,
+                                                const gchar            *label,
+                                                const gchar            *uuid)
+{
+  GList *ret;
+
+  g_return_val_if_fail (UDISKS_IS_CRYPTTAB_MONITOR (monitor), NULL);
+
+  udisks_crypttab_monitor_ensure (monitor);
+
+  ret = udisks_daemon_util_device_spec_index_lookup (monitor->entries_index,
+                                                     device,
+                                                     symlinks,
+                                                     label,
+                                                     uuid,
+                                                     NULL,  /* partlabel */
+                                                     NULL); /* partuuid */
+
+  return ret;
+}
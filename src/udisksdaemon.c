@@ -22,6 +22,8 @@
 #include "config.h"
 #include <glib/gi18n-lib.h>
 
+#include <string.h>
+
 #include "udiskslogging.h"
 #include "udisksdaemon.h"
 #include "udisksdaemonutil.h"
@@ -39,9 +41,14 @@
 #include "udiskscrypttabmonitor.h"
 #include "udiskscrypttabentry.h"
 #include "udiskslinuxblockobject.h"
+#include "udiskslinuxdriveobject.h"
+#include "udiskslinuxmdraidobject.h"
 #include "udiskslinuxdevice.h"
 #include "udisksmodulemanager.h"
 #include "udisksconfigmanager.h"
+#include "udisksmethodqueue.h"
+#include "udisksmetrics.h"
+#include "udiskstrace.h"
 
 /**
  * SECTION:udisksdaemon
@@ -82,6 +89,38 @@ struct _UDisksDaemon
 
   UDisksConfigManager *config_manager;
 
+  /* bounds the number of D-Bus method calls handled at once, see on_authorize_method() */
+  UDisksMethodQueue *method_queue;
+
+  UDisksMetrics *metrics;
+
+  /* Lookup tables for exported block, drive and MD-RAID objects, see
+   * udisks_daemon_index_object(). The tables do not hold references,
+   * object_index_entries maps each indexed object (reffed) to the
+   * #ObjectIndexEntry instances it was indexed under. The
+   * block_by_{uuid,label,partuuid,partlabel} tables map to a
+   * GPtrArray of objects since such identifiers are not unique.
+   */
+  GMutex object_index_lock;
+  GHashTable *object_index_entries;
+  GHashTable *block_by_device_number;
+  GHashTable *block_by_device_file;
+  GHashTable *block_by_symlink;
+  GHashTable *block_by_sysfs_path;
+  GHashTable *drive_by_sysfs_path;
+  GHashTable *mdraid_by_uuid;
+  GHashTable *block_by_uuid;
+  GHashTable *block_by_label;
+  GHashTable *block_by_partuuid;
+  GHashTable *block_by_partlabel;
+
+  /* Used to wake up udisks_daemon_wait_for_object_sync() callers,
+   * wait_serial is bumped every time the provider reports changes
+   */
+  GMutex wait_lock;
+  GCond wait_cond;
+  guint64 wait_serial;
+
   gboolean disable_modules;
   gboolean force_load_modules;
   gboolean uninstalled;
@@ -119,6 +158,8 @@ udisks_daemon_finalize (GObject *object)
 
   g_clear_object (&daemon->authority);
   g_object_unref (daemon->object_manager);
+  g_object_unref (daemon->method_queue);
+  g_object_unref (daemon->metrics);
   g_object_unref (daemon->linux_provider);
   g_object_unref (daemon->connection);
 
@@ -132,6 +173,21 @@ udisks_daemon_finalize (GObject *object)
 
   g_clear_object (&daemon->config_manager);
 
+  g_hash_table_unref (daemon->object_index_entries);
+  g_hash_table_unref (daemon->block_by_device_number);
+  g_hash_table_unref (daemon->block_by_device_file);
+  g_hash_table_unref (daemon->block_by_symlink);
+  g_hash_table_unref (daemon->block_by_sysfs_path);
+  g_hash_table_unref (daemon->drive_by_sysfs_path);
+  g_hash_table_unref (daemon->mdraid_by_uuid);
+  g_hash_table_unref (daemon->block_by_uuid);
+  g_hash_table_unref (daemon->block_by_label);
+  g_hash_table_unref (daemon->block_by_partuuid);
+  g_hash_table_unref (daemon->block_by_partlabel);
+  g_mutex_clear (&daemon->object_index_lock);
+  g_mutex_clear (&daemon->wait_lock);
+  g_cond_clear (&daemon->wait_cond);
+
   if (G_OBJECT_CLASS (udisks_daemon_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_daemon_parent_class)->finalize (object);
 }
@@ -228,6 +284,23 @@ udisks_daemon_set_property (GObject      *object,
 static void
 udisks_daemon_init (UDisksDaemon *daemon)
 {
+  g_mutex_init (&daemon->wait_lock);
+  g_cond_init (&daemon->wait_cond);
+  g_mutex_init (&daemon->object_index_lock);
+  daemon->object_index_entries = g_hash_table_new_full (g_direct_hash,
+                                                        g_direct_equal,
+                                                        g_object_unref,
+                                                        (GDestroyNotify) g_ptr_array_unref);
+  daemon->block_by_device_number = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+  daemon->block_by_device_file = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  daemon->block_by_symlink = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  daemon->block_by_sysfs_path = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  daemon->drive_by_sysfs_path = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  daemon->mdraid_by_uuid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  daemon->block_by_uuid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->block_by_label = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->block_by_partuuid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->block_by_partlabel = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
 }
 
 static void
@@ -236,7 +309,95 @@ mount_monitor_on_mount_removed (UDisksMountMonitor *monitor,
                                 gpointer            user_data)
 {
   UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
-  udisks_state_check (daemon->state);
+  udisks_state_check_device (daemon->state, udisks_mount_get_dev (mount));
+}
+
+static void
+wake_up_waiters (UDisksDaemon *daemon)
+{
+  g_mutex_lock (&daemon->wait_lock);
+  daemon->wait_serial++;
+  g_cond_broadcast (&daemon->wait_cond);
+  g_mutex_unlock (&daemon->wait_lock);
+}
+
+static void
+provider_on_changed (UDisksProvider *provider,
+                     gpointer        user_data)
+{
+  UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
+  wake_up_waiters (daemon);
+}
+
+/* Runs before a method call is handled, in the thread it is handled
+ * in - a GDBus worker thread for interfaces with
+ * G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD,
+ * the main thread otherwise
+ */
+static gboolean
+on_authorize_method (GDBusObjectSkeleton    *object,
+                     GDBusInterfaceSkeleton *interface,
+                     GDBusMethodInvocation  *invocation,
+                     gpointer                user_data)
+{
+  UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
+  const gchar *object_path;
+
+  /* Never block the main thread: the interfaces handled there (e.g.
+   * the zram, bcache and btrfs managers, iSCSI sessions and the LSM
+   * drive interface) don't wait for anything and aren't queued.
+   */
+  if (g_main_context_is_owner (NULL))
+    return TRUE;
+
+  /* the metrics are most interesting when the queue is full */
+  if (g_strcmp0 (g_dbus_method_invocation_get_interface_name (invocation),
+                 "org.freedesktop.UDisks2.Manager.Metrics") == 0)
+    return TRUE;
+
+  /* Calls on the same object are handled one after another - except
+   * for the Manager object, whose methods don't operate on a single
+   * device.
+   */
+  object_path = g_dbus_method_invocation_get_object_path (invocation);
+  if (g_strcmp0 (object_path, "/org/freedesktop/UDisks2/Manager") == 0)
+    object_path = NULL;
+
+  udisks_method_queue_enter (daemon->method_queue, invocation, object_path);
+
+  /* actual authorization is done by the method handlers */
+  return TRUE;
+}
+
+static void
+object_manager_on_object_added (GDBusObjectManager *manager,
+                                GDBusObject        *object,
+                                gpointer            user_data)
+{
+  UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
+
+  /* Job methods (i.e. Cancel()) must never wait behind the calls
+   * that are running the jobs.
+   */
+  if (g_str_has_prefix (g_dbus_object_get_object_path (object), "/org/freedesktop/UDisks2/jobs/"))
+    return;
+
+  /* make sure to only wait once per call if the object is exported again */
+  g_signal_handlers_disconnect_by_func (object, G_CALLBACK (on_authorize_method), daemon);
+  g_signal_connect (object,
+                    "authorize-method",
+                    G_CALLBACK (on_authorize_method),
+                    daemon);
+}
+
+static void
+object_manager_on_object_removed (GDBusObjectManager *manager,
+                                  GDBusObject        *object,
+                                  gpointer            user_data)
+{
+  UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
+
+  g_signal_handlers_disconnect_by_func (object, G_CALLBACK (on_authorize_method), daemon);
 }
 
 static void
@@ -284,6 +445,18 @@ udisks_daemon_constructed (GObject *object)
       daemon->module_manager = udisks_module_manager_new_uninstalled (daemon);
     }
 
+  daemon->metrics = udisks_metrics_new ();
+
+  daemon->method_queue = udisks_method_queue_new (udisks_config_manager_get_method_workers (daemon->config_manager));
+  g_signal_connect (daemon->object_manager,
+                    "object-added",
+                    G_CALLBACK (object_manager_on_object_added),
+                    daemon);
+  g_signal_connect (daemon->object_manager,
+                    "object-removed",
+                    G_CALLBACK (object_manager_on_object_removed),
+                    daemon);
+
   daemon->mount_monitor = udisks_mount_monitor_new ();
 
   daemon->state = udisks_state_new (daemon);
@@ -298,6 +471,10 @@ udisks_daemon_constructed (GObject *object)
 
   /* now add providers */
   daemon->linux_provider = udisks_linux_provider_new (daemon);
+  g_signal_connect (daemon->linux_provider,
+                    "changed",
+                    G_CALLBACK (provider_on_changed),
+                    daemon);
 
   if (daemon->force_load_modules
       || (udisks_config_manager_get_load_preference (daemon->config_manager)
@@ -569,6 +746,36 @@ udisks_daemon_get_state (UDisksDaemon *daemon)
   return daemon->state;
 }
 
+/**
+ * udisks_daemon_get_method_queue:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Gets the queue limiting the number of D-Bus method calls @daemon handles at once.
+ *
+ * Returns: A #UDisksMethodQueue instance. Do not free, the object is owned by @daemon.
+ */
+UDisksMethodQueue *
+udisks_daemon_get_method_queue (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->method_queue;
+}
+
+/**
+ * udisks_daemon_get_metrics:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Gets the metrics collected by @daemon.
+ *
+ * Returns: A #UDisksMetrics instance. Do not free, the object is owned by @daemon.
+ */
+UDisksMetrics *
+udisks_daemon_get_metrics (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->metrics;
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 static void
@@ -579,10 +786,24 @@ on_job_completed (UDisksJob    *job,
 {
   UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
   UDisksObjectSkeleton *object;
+  gchar *name;
 
   object = UDISKS_OBJECT_SKELETON (g_dbus_interface_get_object (G_DBUS_INTERFACE (job)));
   g_assert (object != NULL);
 
+  UDISKS_TRACE4 (job_complete,
+                 g_dbus_object_get_object_path (G_DBUS_OBJECT (object)),
+                 udisks_job_get_operation (job),
+                 (gint) success,
+                 message);
+
+  /* the start time is wall-clock time, see udisks_base_job_init() */
+  name = g_strdup_printf ("job:%s", udisks_job_get_operation (job));
+  udisks_metrics_add_duration (daemon->metrics,
+                               name,
+                               g_get_real_time () - (gint64) udisks_job_get_start_time (job));
+  g_free (name);
+
   /* Unexport job */
   g_dbus_object_manager_server_unexport (daemon->object_manager,
                                          g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
@@ -653,6 +874,10 @@ udisks_daemon_launch_simple_job (UDisksDaemon    *daemon,
   udisks_job_set_started_by_uid (UDISKS_JOB (job), job_started_by_uid);
 
   g_dbus_object_manager_server_export (daemon->object_manager, G_DBUS_OBJECT_SKELETON (job_object));
+  UDISKS_TRACE3 (job_create,
+                 g_dbus_object_get_object_path (G_DBUS_OBJECT (job_object)),
+                 job_operation,
+                 (guint) job_started_by_uid);
   g_signal_connect_after (job,
                           "completed",
                           G_CALLBACK (on_job_completed),
@@ -725,6 +950,10 @@ udisks_daemon_launch_threaded_job  (UDisksDaemon          *daemon,
   udisks_job_set_started_by_uid (UDISKS_JOB (job), job_started_by_uid);
 
   g_dbus_object_manager_server_export (daemon->object_manager, G_DBUS_OBJECT_SKELETON (job_object));
+  UDISKS_TRACE3 (job_create,
+                 g_dbus_object_get_object_path (G_DBUS_OBJECT (job_object)),
+                 job_operation,
+                 (guint) job_started_by_uid);
   g_signal_connect_after (job,
                           "completed",
                           G_CALLBACK (on_job_completed),
@@ -872,6 +1101,10 @@ udisks_daemon_launch_spawned_job_gstring (
   udisks_job_set_started_by_uid (UDISKS_JOB (job), job_started_by_uid);
 
   g_dbus_object_manager_server_export (daemon->object_manager, G_DBUS_OBJECT_SKELETON (job_object));
+  UDISKS_TRACE3 (job_create,
+                 g_dbus_object_get_object_path (G_DBUS_OBJECT (job_object)),
+                 job_operation,
+                 (guint) job_started_by_uid);
   g_signal_connect_after (job,
                           "completed",
                           G_CALLBACK (on_job_completed),
@@ -1078,6 +1311,14 @@ udisks_daemon_launch_spawned_job_gstring_sync (UDisksDaemon    *daemon,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static void
+wait_on_cancelled (GCancellable *cancellable,
+                   gpointer      user_data)
+{
+  UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
+  wake_up_waiters (daemon);
+}
+
 /**
  * udisks_daemon_wait_for_object_sync:
  * @daemon: A #UDisksDaemon.
@@ -1085,164 +1326,377 @@ udisks_daemon_launch_spawned_job_gstring_sync (UDisksDaemon    *daemon,
  * @user_data: User data to pass to @wait_func.
  * @user_data_free_func: (allow-none): Function to free @user_data or %NULL.
  * @timeout_seconds: Maximum time to wait for the object (in seconds) or 0 to never wait.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
  * @error: (allow-none): Return location for error or %NULL.
  *
  * Blocks the calling thread until an object picked by @wait_func is
- * available or until @timeout_seconds has passed (in which case the
- * function fails with %UDISKS_ERROR_TIMED_OUT).
+ * available, until @timeout_seconds has passed (in which case the
+ * function fails with %UDISKS_ERROR_FAILED) or until @cancellable is
+ * cancelled (in which case the function fails with
+ * %G_IO_ERROR_CANCELLED).
  *
- * Note that @wait_func will be called from time to time - for example
- * if there is a device event.
+ * Note that @wait_func will be called every time the provider reports
+ * changes - for example after it has handled device events.
+ *
+ * This must not be called from the main thread as the provider
+ * handles device events there.
  *
  * Returns: (transfer full): The object picked by @wait_func or %NULL if @error is set.
  */
-
-typedef struct {
-  GMainContext *context;
-  GMainLoop *loop;
-  gboolean timed_out;
-} WaitData;
-
-static gboolean
-wait_on_timed_out (gpointer user_data)
-{
-  WaitData *data = user_data;
-  data->timed_out = TRUE;
-  g_main_loop_quit (data->loop);
-  return FALSE; /* remove the source */
-}
-
-static gboolean
-wait_on_recheck (gpointer user_data)
-{
-  WaitData *data = user_data;
-  g_main_loop_quit (data->loop);
-  return FALSE; /* remove the source */
-}
-
 UDisksObject *
 udisks_daemon_wait_for_object_sync (UDisksDaemon          *daemon,
                                     UDisksDaemonWaitFunc   wait_func,
                                     gpointer               user_data,
                                     GDestroyNotify         user_data_free_func,
                                     guint                  timeout_seconds,
+                                    GCancellable          *cancellable,
                                     GError               **error)
 {
   UDisksObject *ret;
-  WaitData data;
-
-  /* TODO: support GCancellable */
+  gint64 end_time;
+  gulong cancelled_id = 0;
 
   g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
   g_return_val_if_fail (wait_func != NULL, NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
 
   ret = NULL;
 
-  memset (&data, '\0', sizeof (data));
-  data.context = NULL;
-  data.loop = NULL;
-
   g_object_ref (daemon);
 
- again:
-  ret = wait_func (daemon, user_data);
+  end_time = g_get_monotonic_time () + timeout_seconds * G_TIME_SPAN_SECOND;
+  if (cancellable != NULL)
+    cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (wait_on_cancelled), daemon, NULL);
 
-  if (ret == NULL && timeout_seconds > 0)
+  while (TRUE)
     {
-      GSource *source;
+      guint64 serial;
 
-      /* sit and wait for up to @timeout_seconds if the object isn't there already */
-      if (data.context == NULL)
-        {
-          /* TODO: this will deadlock if we are calling from the main thread... */
-          data.context = g_main_context_new ();
-          data.loop = g_main_loop_new (data.context, FALSE);
-
-          source = g_timeout_source_new_seconds (timeout_seconds);
-          g_source_set_priority (source, G_PRIORITY_DEFAULT);
-          g_source_set_callback (source, wait_on_timed_out, &data, NULL);
-          g_source_attach (source, data.context);
-          g_source_unref (source);
-        }
-
-      /* TODO: do something a bit more elegant than checking every 250ms ... it's
-       *       probably going to involve having each UDisksProvider emit a "changed"
-       *       signal when it's time to recheck... for now this works.
+      /* sample the serial before checking so we don't miss changes
+       * happening while @wait_func runs
        */
-      source = g_timeout_source_new (250);
-      g_source_set_priority (source, G_PRIORITY_DEFAULT);
-      g_source_set_callback (source, wait_on_recheck, &data, NULL);
-      g_source_attach (source, data.context);
-      g_source_unref (source);
+      g_mutex_lock (&daemon->wait_lock);
+      serial = daemon->wait_serial;
+      g_mutex_unlock (&daemon->wait_lock);
+
+      ret = wait_func (daemon, user_data);
+      if (ret != NULL || timeout_seconds == 0)
+        break;
 
-      g_main_loop_run (data.loop);
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        break;
 
-      if (data.timed_out)
+      if (g_get_monotonic_time () >= end_time)
         {
           g_set_error (error,
                        UDISKS_ERROR, UDISKS_ERROR_FAILED,
                        "Timed out waiting for object");
+          break;
         }
-      else
+
+      /* sit and wait until the provider reports changes, we're cancelled or we time out */
+      g_mutex_lock (&daemon->wait_lock);
+      while (daemon->wait_serial == serial && !g_cancellable_is_cancelled (cancellable))
         {
-          goto again;
+          if (!g_cond_wait_until (&daemon->wait_cond, &daemon->wait_lock, end_time))
+            break;
         }
+      g_mutex_unlock (&daemon->wait_lock);
     }
 
+  if (cancelled_id != 0)
+    g_cancellable_disconnect (cancellable, cancelled_id);
+
   if (user_data_free_func != NULL)
     user_data_free_func (user_data);
 
   g_object_unref (daemon);
 
-  if (data.loop != NULL)
-    g_main_loop_unref (data.loop);
-  if (data.context != NULL)
-    g_main_context_unref (data.context);
-
   return ret;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* An entry in one of the object lookup tables - @key is a copy of the
+ * key in @table and @multi is set if @table maps to a GPtrArray of objects
+ */
+typedef struct
+{
+  GHashTable *table;
+  gpointer key;
+  gboolean multi;
+} ObjectIndexEntry;
+
+static void
+object_index_entry_free (ObjectIndexEntry *entry)
+{
+  g_free (entry->key);
+  g_slice_free (ObjectIndexEntry, entry);
+}
+
+/* called with object_index_lock held, takes ownership of @key */
+static void
+object_index_add (GPtrArray    *entries,
+                  GHashTable   *table,
+                  gpointer      key,
+                  gsize         key_size,
+                  UDisksObject *object)
+{
+  ObjectIndexEntry *entry;
+
+  entry = g_slice_new0 (ObjectIndexEntry);
+  entry->table = table;
+  entry->key = g_malloc (key_size);
+  memcpy (entry->key, key, key_size);
+  g_ptr_array_add (entries, entry);
+
+  /* the most recently indexed object wins if several objects share a key */
+  g_hash_table_replace (table, key, object);
+}
+
+/* called with object_index_lock held, takes ownership of @key */
+static void
+object_index_add_multi (GPtrArray    *entries,
+                        GHashTable   *table,
+                        gchar        *key,
+                        UDisksObject *object)
+{
+  ObjectIndexEntry *entry;
+  GPtrArray *objects;
+
+  entry = g_slice_new0 (ObjectIndexEntry);
+  entry->table = table;
+  entry->key = g_strdup (key);
+  entry->multi = TRUE;
+  g_ptr_array_add (entries, entry);
+
+  objects = g_hash_table_lookup (table, key);
+  if (objects == NULL)
+    {
+      objects = g_ptr_array_new ();
+      g_hash_table_insert (table, key, objects);
+    }
+  else
+    {
+      g_free (key);
+    }
+  g_ptr_array_add (objects, object);
+}
+
+/* called with object_index_lock held */
+static void
+object_index_remove (UDisksDaemon *daemon,
+                     UDisksObject *object)
+{
+  GPtrArray *entries;
+  guint n;
+
+  entries = g_hash_table_lookup (daemon->object_index_entries, object);
+  if (entries == NULL)
+    return;
+
+  for (n = 0; n < entries->len; n++)
+    {
+      ObjectIndexEntry *entry = g_ptr_array_index (entries, n);
+
+      if (entry->multi)
+        {
+          GPtrArray *objects = g_hash_table_lookup (entry->table, entry->key);
+          if (objects != NULL && g_ptr_array_remove_fast (objects, object) && objects->len == 0)
+            g_hash_table_remove (entry->table, entry->key);
+        }
+      /* don't remove the key if it has since been claimed by another object */
+      else if (g_hash_table_lookup (entry->table, entry->key) == object)
+        {
+          g_hash_table_remove (entry->table, entry->key);
+        }
+    }
+
+  g_hash_table_remove (daemon->object_index_entries, object);
+}
+
+static void
+object_index_add_string (GPtrArray    *entries,
+                         GHashTable   *table,
+                         const gchar  *key,
+                         UDisksObject *object)
+{
+  if (key == NULL || key[0] == '\0')
+    return;
+
+  object_index_add (entries, table, g_strdup (key), strlen (key) + 1, object);
+}
+
+static void
+object_index_add_multi_string (GPtrArray    *entries,
+                               GHashTable   *table,
+                               const gchar  *key,
+                               UDisksObject *object)
+{
+  if (key == NULL || key[0] == '\0')
+    return;
+
+  object_index_add_multi (entries, table, g_strdup (key), object);
+}
+
 /**
- * udisks_daemon_find_block:
+ * udisks_daemon_index_object:
  * @daemon: A #UDisksDaemon.
- * @block_device_number: A #dev_t with the device number to find.
+ * @object: An exported #UDisksObject.
  *
- * Finds a block device with the number given by @block_device_number.
+ * Adds @object to the lookup tables used by udisks_daemon_find_block()
+ * and friends, replacing any keys @object was previously indexed
+ * under. This must be called when a #UDisksLinuxBlockObject,
+ * #UDisksLinuxDriveObject or #UDisksLinuxMDRaidObject has been
+ * exported and every time it has been updated. Other objects are
+ * ignored.
  *
- * Returns: (transfer full): A #UDisksObject or %NULL if not found. Free with g_object_unref().
+ * This function is thread-safe.
  */
-UDisksObject *
-udisks_daemon_find_block (UDisksDaemon *daemon,
-                          dev_t         block_device_number)
+void
+udisks_daemon_index_object (UDisksDaemon *daemon,
+                            UDisksObject *object)
 {
-  UDisksObject *ret = NULL;
-  GList *objects, *l;
+  GPtrArray *entries;
+
+  g_return_if_fail (UDISKS_IS_DAEMON (daemon));
+  g_return_if_fail (UDISKS_IS_OBJECT (object));
 
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (daemon->object_manager));
-  for (l = objects; l != NULL; l = l->next)
+  entries = g_ptr_array_new_with_free_func ((GDestroyNotify) object_index_entry_free);
+
+  g_mutex_lock (&daemon->object_index_lock);
+
+  object_index_remove (daemon, object);
+
+  if (UDISKS_IS_LINUX_BLOCK_OBJECT (object))
     {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
+      UDisksLinuxDevice *device;
       UDisksBlock *block;
 
       block = udisks_object_peek_block (object);
-      if (block == NULL)
-        continue;
+      if (block != NULL)
+        {
+          const gchar *const *symlinks;
+          guint64 *device_number;
+          guint n;
+
+          device_number = g_new (guint64, 1);
+          *device_number = udisks_block_get_device_number (block);
+          object_index_add (entries, daemon->block_by_device_number, device_number, sizeof (guint64), object);
+
+          object_index_add_string (entries, daemon->block_by_device_file, udisks_block_get_device (block), object);
 
-      if (udisks_block_get_device_number (block) == block_device_number)
+          symlinks = udisks_block_get_symlinks (block);
+          for (n = 0; symlinks != NULL && symlinks[n] != NULL; n++)
+            object_index_add_string (entries, daemon->block_by_symlink, symlinks[n], object);
+
+          object_index_add_multi_string (entries, daemon->block_by_uuid, udisks_block_get_id_uuid (block), object);
+          object_index_add_multi_string (entries, daemon->block_by_label, udisks_block_get_id_label (block), object);
+        }
+
+      device = udisks_linux_block_object_get_device (UDISKS_LINUX_BLOCK_OBJECT (object));
+      if (device != NULL)
         {
-          ret = g_object_ref (object);
-          goto out;
+          object_index_add_string (entries, daemon->block_by_sysfs_path,
+                                   g_udev_device_get_sysfs_path (device->udev_device), object);
+          object_index_add_multi_string (entries, daemon->block_by_partuuid,
+                                         g_udev_device_get_property (device->udev_device, "ID_PART_ENTRY_UUID"), object);
+          object_index_add_multi_string (entries, daemon->block_by_partlabel,
+                                         g_udev_device_get_property (device->udev_device, "ID_PART_ENTRY_NAME"), object);
+          g_object_unref (device);
         }
     }
- out:
-  g_list_free_full (objects, g_object_unref);
+  else if (UDISKS_IS_LINUX_DRIVE_OBJECT (object))
+    {
+      GList *devices, *l;
+
+      devices = udisks_linux_drive_object_get_devices (UDISKS_LINUX_DRIVE_OBJECT (object));
+      for (l = devices; l != NULL; l = l->next)
+        {
+          UDisksLinuxDevice *device = UDISKS_LINUX_DEVICE (l->data);
+          object_index_add_string (entries, daemon->drive_by_sysfs_path,
+                                   g_udev_device_get_sysfs_path (device->udev_device), object);
+        }
+      g_list_free_full (devices, g_object_unref);
+    }
+  else if (UDISKS_IS_LINUX_MDRAID_OBJECT (object))
+    {
+      object_index_add_string (entries, daemon->mdraid_by_uuid,
+                               udisks_linux_mdraid_object_get_uuid (UDISKS_LINUX_MDRAID_OBJECT (object)), object);
+    }
+
+  if (entries->len > 0)
+    g_hash_table_insert (daemon->object_index_entries, g_object_ref (object), g_ptr_array_ref (entries));
+
+  g_mutex_unlock (&daemon->object_index_lock);
+
+  g_ptr_array_unref (entries);
+}
+
+/**
+ * udisks_daemon_unindex_object:
+ * @daemon: A #UDisksDaemon.
+ * @object: A #UDisksObject.
+ *
+ * Removes @object from the lookup tables used by
+ * udisks_daemon_find_block() and friends. This must be called before
+ * an object passed to udisks_daemon_index_object() is unexported.
+ *
+ * This function is thread-safe.
+ */
+void
+udisks_daemon_unindex_object (UDisksDaemon *daemon,
+                              UDisksObject *object)
+{
+  g_return_if_fail (UDISKS_IS_DAEMON (daemon));
+  g_return_if_fail (UDISKS_IS_OBJECT (object));
+
+  g_mutex_lock (&daemon->object_index_lock);
+  object_index_remove (daemon, object);
+  g_mutex_unlock (&daemon->object_index_lock);
+}
+
+static UDisksObject *
+object_index_lookup (UDisksDaemon  *daemon,
+                     GHashTable    *table,
+                     gconstpointer  key)
+{
+  UDisksObject *ret;
+
+  if (key == NULL)
+    return NULL;
+
+  g_mutex_lock (&daemon->object_index_lock);
+  ret = g_hash_table_lookup (table, key);
+  if (ret != NULL)
+    g_object_ref (ret);
+  g_mutex_unlock (&daemon->object_index_lock);
+
   return ret;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/**
+ * udisks_daemon_find_block:
+ * @daemon: A #UDisksDaemon.
+ * @block_device_number: A #dev_t with the device number to find.
+ *
+ * Finds a block device with the number given by @block_device_number.
+ *
+ * Returns: (transfer full): A #UDisksObject or %NULL if not found. Free with g_object_unref().
+ */
+UDisksObject *
+udisks_daemon_find_block (UDisksDaemon *daemon,
+                          dev_t         block_device_number)
+{
+  guint64 key = block_device_number;
+
+  return object_index_lookup (daemon, daemon->block_by_device_number, &key);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 /**
  * udisks_daemon_find_block_by_device_file:
  * @daemon: A #UDisksDaemon.
@@ -1256,28 +1710,25 @@ UDisksObject *
 udisks_daemon_find_block_by_device_file (UDisksDaemon *daemon,
                                          const gchar  *device_file)
 {
-  UDisksObject *ret = NULL;
-  GList *objects, *l;
-
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (daemon->object_manager));
-  for (l = objects; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksBlock *block;
+  return object_index_lookup (daemon, daemon->block_by_device_file, device_file);
+}
 
-      block = udisks_object_peek_block (object);
-      if (block == NULL)
-        continue;
+/* ---------------------------------------------------------------------------------------------------- */
 
-      if (g_strcmp0 (udisks_block_get_device (block), device_file) == 0)
-        {
-          ret = g_object_ref (object);
-          goto out;
-        }
-    }
- out:
-  g_list_free_full (objects, g_object_unref);
-  return ret;
+/**
+ * udisks_daemon_find_block_by_symlink:
+ * @daemon: A #UDisksDaemon.
+ * @symlink: A symlink to a device file, e.g. <filename>/dev/disk/by-uuid/...</filename>.
+ *
+ * Finds a block device with a symlink given by @symlink.
+ *
+ * Returns: (transfer full): A #UDisksObject or %NULL if not found. Free with g_object_unref().
+ */
+UDisksObject *
+udisks_daemon_find_block_by_symlink (UDisksDaemon *daemon,
+                                     const gchar  *symlink)
+{
+  return object_index_lookup (daemon, daemon->block_by_symlink, symlink);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1295,32 +1746,104 @@ UDisksObject *
 udisks_daemon_find_block_by_sysfs_path (UDisksDaemon *daemon,
                                         const gchar  *sysfs_path)
 {
-  UDisksObject *ret = NULL;
-  GList *objects, *l;
+  return object_index_lookup (daemon, daemon->block_by_sysfs_path, sysfs_path);
+}
 
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (daemon->object_manager));
-  for (l = objects; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksLinuxDevice *device;
+/* ---------------------------------------------------------------------------------------------------- */
 
-      if (!UDISKS_IS_LINUX_BLOCK_OBJECT (object))
-        continue;
+/**
+ * udisks_daemon_find_drive_by_sysfs_path:
+ * @daemon: A #UDisksDaemon.
+ * @sysfs_path: The sysfs path of a whole-disk block device.
+ *
+ * Finds the drive that the whole-disk block device with a sysfs path
+ * given by @sysfs_path belongs to.
+ *
+ * Returns: (transfer full): A #UDisksObject or %NULL if not found. Free with g_object_unref().
+ */
+UDisksObject *
+udisks_daemon_find_drive_by_sysfs_path (UDisksDaemon *daemon,
+                                        const gchar  *sysfs_path)
+{
+  return object_index_lookup (daemon, daemon->drive_by_sysfs_path, sysfs_path);
+}
 
-      device = udisks_linux_block_object_get_device (UDISKS_LINUX_BLOCK_OBJECT (object));
-      if (device == NULL)
-        continue;
+/* ---------------------------------------------------------------------------------------------------- */
 
-      if (g_strcmp0 (g_udev_device_get_sysfs_path (device->udev_device), sysfs_path) == 0)
-        {
-          g_object_unref (device);
-          ret = g_object_ref (object);
-          goto out;
-        }
-      g_object_unref (device);
+/**
+ * udisks_daemon_find_mdraid:
+ * @daemon: A #UDisksDaemon.
+ * @uuid: A MD-RAID array UUID.
+ *
+ * Finds a MD-RAID array with the UUID given by @uuid.
+ *
+ * Returns: (transfer full): A #UDisksObject or %NULL if not found. Free with g_object_unref().
+ */
+UDisksObject *
+udisks_daemon_find_mdraid (UDisksDaemon *daemon,
+                           const gchar  *uuid)
+{
+  return object_index_lookup (daemon, daemon->mdraid_by_uuid, uuid);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/**
+ * udisks_daemon_find_blocks_by_identifier:
+ * @daemon: A #UDisksDaemon.
+ * @type: The kind of identifier, e.g. %UDISKS_DEVICE_SPEC_UUID.
+ * @value: The identifier.
+ *
+ * Finds all block devices with the filesystem UUID or label or the
+ * partition UUID or name given by @type and @value. Several block
+ * devices may share an identifier, e.g. the members of a RAID array.
+ *
+ * Only %UDISKS_DEVICE_SPEC_UUID, %UDISKS_DEVICE_SPEC_LABEL,
+ * %UDISKS_DEVICE_SPEC_PARTUUID and %UDISKS_DEVICE_SPEC_PARTLABEL are
+ * supported, use udisks_daemon_find_block_by_device_file() for paths.
+ *
+ * Returns: (transfer full) (element-type UDisksObject): A list of #UDisksObject instances. Free each element with g_object_unref(), then free the list with g_list_free().
+ */
+GList *
+udisks_daemon_find_blocks_by_identifier (UDisksDaemon         *daemon,
+                                         UDisksDeviceSpecType  type,
+                                         const gchar          *value)
+{
+  GHashTable *table;
+  GPtrArray *objects;
+  GList *ret = NULL;
+  guint n;
+
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+
+  switch (type)
+    {
+    case UDISKS_DEVICE_SPEC_UUID:
+      table = daemon->block_by_uuid;
+      break;
+    case UDISKS_DEVICE_SPEC_LABEL:
+      table = daemon->block_by_label;
+      break;
+    case UDISKS_DEVICE_SPEC_PARTUUID:
+      table = daemon->block_by_partuuid;
+      break;
+    case UDISKS_DEVICE_SPEC_PARTLABEL:
+      table = daemon->block_by_partlabel;
+      break;
+    default:
+      g_return_val_if_reached (NULL);
     }
+
+  if (value == NULL)
+    goto out;
+
+  g_mutex_lock (&daemon->object_index_lock);
+  objects = g_hash_table_lookup (table, value);
+  for (n = 0; objects != NULL && n < objects->len; n++)
+    ret = g_list_prepend (ret, g_object_ref (objects->pdata[n]));
+  g_mutex_unlock (&daemon->object_index_lock);
+
  out:
-  g_list_free_full (objects, g_object_unref);
   return ret;
 }
 
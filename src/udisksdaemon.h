@@ -42,6 +42,8 @@ UDisksCrypttabMonitor    *udisks_daemon_get_crypttab_monitor  (UDisksDaemon    *
 UDisksLinuxProvider      *udisks_daemon_get_linux_provider    (UDisksDaemon    *daemon);
 PolkitAuthority          *udisks_daemon_get_authority         (UDisksDaemon    *daemon);
 UDisksState              *udisks_daemon_get_state             (UDisksDaemon    *daemon);
+UDisksMethodQueue        *udisks_daemon_get_method_queue      (UDisksDaemon    *daemon);
+UDisksMetrics            *udisks_daemon_get_metrics           (UDisksDaemon    *daemon);
 UDisksModuleManager      *udisks_daemon_get_module_manager    (UDisksDaemon    *daemon);
 UDisksConfigManager      *udisks_daemon_get_config_manager    (UDisksDaemon    *daemon);
 gboolean                  udisks_daemon_get_disable_modules   (UDisksDaemon    *daemon);
@@ -65,6 +67,7 @@ UDisksObject             *udisks_daemon_wait_for_object_sync  (UDisksDaemon
                                                                gpointer              user_data,
                                                                GDestroyNotify        user_data_free_func,
                                                                guint                 timeout_seconds,
+                                                               GCancellable         *cancellable,
                                                                GError              **error);
 
 GList                    *udisks_daemon_get_objects           (UDisksDaemon         *daemon);
@@ -75,9 +78,28 @@ UDisksObject             *udisks_daemon_find_block            (UDisksDaemon
 UDisksObject             *udisks_daemon_find_block_by_device_file (UDisksDaemon *daemon,
                                                                    const gchar  *device_file);
 
+UDisksObject             *udisks_daemon_find_block_by_symlink (UDisksDaemon         *daemon,
+                                                               const gchar          *symlink);
+
 UDisksObject             *udisks_daemon_find_block_by_sysfs_path (UDisksDaemon *daemon,
                                                                   const gchar  *sysfs_path);
 
+UDisksObject             *udisks_daemon_find_drive_by_sysfs_path (UDisksDaemon *daemon,
+                                                                  const gchar  *sysfs_path);
+
+UDisksObject             *udisks_daemon_find_mdraid           (UDisksDaemon         *daemon,
+                                                               const gchar          *uuid);
+
+GList                    *udisks_daemon_find_blocks_by_identifier (UDisksDaemon         *daemon,
+                                                                   UDisksDeviceSpecType  type,
+                                                                   const gchar          *value);
+
+void                      udisks_daemon_index_object          (UDisksDaemon         *daemon,
+                                                               UDisksObject         *object);
+
+void                      udisks_daemon_unindex_object        (UDisksDaemon         *daemon,
+                                                               UDisksObject         *object);
+
 UDisksObject             *udisks_daemon_find_object           (UDisksDaemon         *daemon,
                                                                const gchar          *object_path);
 
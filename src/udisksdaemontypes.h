@@ -87,6 +87,9 @@ typedef struct _UDisksLinuxLoop UDisksLinuxLoop;
 struct _UDisksLinuxManager;
 typedef struct _UDisksLinuxManager UDisksLinuxManager;
 
+struct _UDisksLinuxManagerMetrics;
+typedef struct _UDisksLinuxManagerMetrics UDisksLinuxManagerMetrics;
+
 struct _UDisksLinuxSwapspace;
 typedef struct _UDisksLinuxSwapspace UDisksLinuxSwapspace;
 
@@ -139,6 +142,12 @@ typedef gboolean (*UDisksThreadedJobFunc) (UDisksThreadedJob   *job,
 struct _UDisksState;
 typedef struct _UDisksState UDisksState;
 
+struct _UDisksMethodQueue;
+typedef struct _UDisksMethodQueue UDisksMethodQueue;
+
+struct _UDisksMetrics;
+typedef struct _UDisksMetrics UDisksMetrics;
+
 /**
  * UDisksMountType:
  * @UDISKS_MOUNT_TYPE_FILESYSTEM: Object correspond to a mounted filesystem.
@@ -175,6 +184,31 @@ typedef enum
   UDISKS_LOG_LEVEL_ERROR = G_LOG_LEVEL_ERROR
 } UDisksLogLevel;
 
+/**
+ * UDisksDeviceSpecType:
+ * @UDISKS_DEVICE_SPEC_NONE: Not usable for finding a device, e.g. <literal>UUID=</literal> with an empty value.
+ * @UDISKS_DEVICE_SPEC_PATH: A path such as <filename>/dev/sda1</filename> (or anything else not using one of the prefixes below).
+ * @UDISKS_DEVICE_SPEC_UUID: <literal>UUID=</literal>, the filesystem UUID.
+ * @UDISKS_DEVICE_SPEC_LABEL: <literal>LABEL=</literal>, the filesystem label.
+ * @UDISKS_DEVICE_SPEC_PARTUUID: <literal>PARTUUID=</literal>, the partition UUID.
+ * @UDISKS_DEVICE_SPEC_PARTLABEL: <literal>PARTLABEL=</literal>, the partition name.
+ *
+ * How an <filename>/etc/fstab</filename> or <filename>/etc/crypttab</filename> entry
+ * refers to its device, see udisks_daemon_util_parse_device_spec().
+ */
+typedef enum
+{
+  UDISKS_DEVICE_SPEC_NONE,
+  UDISKS_DEVICE_SPEC_PATH,
+  UDISKS_DEVICE_SPEC_UUID,
+  UDISKS_DEVICE_SPEC_LABEL,
+  UDISKS_DEVICE_SPEC_PARTUUID,
+  UDISKS_DEVICE_SPEC_PARTLABEL
+} UDisksDeviceSpecType;
+
+struct _UDisksDeviceSpecIndex;
+typedef struct _UDisksDeviceSpecIndex UDisksDeviceSpecIndex;
+
 struct _UDisksAtaCommandOutput;
 typedef struct _UDisksAtaCommandOutput UDisksAtaCommandOutput;
 
@@ -40,6 +40,7 @@
 #include "udiskslogging.h"
 #include "udiskslinuxblockobject.h"
 #include "udiskslinuxdriveobject.h"
+#include "udiskstrace.h"
 
 #if defined(HAVE_LIBSYSTEMD_LOGIN)
 #include <systemd/sd-daemon.h>
@@ -661,6 +662,11 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
   const gchar *details_device = NULL;
   gchar *details_drive = NULL;
 
+  UDISKS_TRACE3 (auth_check_start,
+                 action_id,
+                 g_dbus_method_invocation_get_sender (invocation),
+                 object != NULL ? g_dbus_object_get_object_path (G_DBUS_OBJECT (object)) : NULL);
+
   authority = udisks_daemon_get_authority (daemon);
   if (authority == NULL)
     {
@@ -847,6 +853,11 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
   ret = TRUE;
 
  out:
+  UDISKS_TRACE4 (auth_check_end,
+                 action_id,
+                 g_dbus_method_invocation_get_sender (invocation),
+                 object != NULL ? g_dbus_object_get_object_path (G_DBUS_OBJECT (object)) : NULL,
+                 (gint) ret);
   g_free (details_drive);
   g_clear_object (&block_object);
   g_clear_object (&drive_object);
@@ -1041,6 +1052,317 @@ udisks_daemon_util_get_caller_pid_sync (UDisksDaemon            *daemon,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+typedef struct
+{
+  GWeakRef cancellable;
+} CallerWatchData;
+
+static void
+caller_watch_data_free (CallerWatchData *data)
+{
+  g_weak_ref_clear (&data->cancellable);
+  g_slice_free (CallerWatchData, data);
+}
+
+/* called in the main thread */
+static void
+on_caller_vanished (GDBusConnection *connection,
+                    const gchar     *name,
+                    gpointer         user_data)
+{
+  CallerWatchData *data = user_data;
+  GCancellable *cancellable;
+
+  cancellable = g_weak_ref_get (&data->cancellable);
+  if (cancellable != NULL)
+    {
+      udisks_debug ("Caller %s disconnected, cancelling its method call", name);
+      g_cancellable_cancel (cancellable);
+      g_object_unref (cancellable);
+    }
+}
+
+static void
+unwatch_caller (gpointer watcher_id)
+{
+  g_bus_unwatch_name (GPOINTER_TO_UINT (watcher_id));
+}
+
+/**
+ * udisks_daemon_util_new_caller_cancellable:
+ * @invocation: A #GDBusMethodInvocation.
+ *
+ * Creates a #GCancellable that is cancelled when the caller of
+ * @invocation disconnects from the bus, e.g. because it was
+ * killed. Pass it to blocking operations (such as
+ * udisks_daemon_wait_for_object_sync()) that are only done on behalf
+ * of the caller.
+ *
+ * Returns: (transfer full): A #GCancellable. Free with g_object_unref().
+ */
+GCancellable *
+udisks_daemon_util_new_caller_cancellable (GDBusMethodInvocation *invocation)
+{
+  GCancellable *cancellable;
+  CallerWatchData *data;
+  const gchar *caller;
+  guint watcher_id;
+
+  g_return_val_if_fail (G_IS_DBUS_METHOD_INVOCATION (invocation), NULL);
+
+  cancellable = g_cancellable_new ();
+
+  /* peer-to-peer connections have no sender */
+  caller = g_dbus_method_invocation_get_sender (invocation);
+  if (caller == NULL)
+    goto out;
+
+  data = g_slice_new0 (CallerWatchData);
+  g_weak_ref_init (&data->cancellable, cancellable);
+
+  /* method handlers run in threads without a main loop - make sure
+   * the watch is dispatched by the main loop
+   */
+  g_main_context_push_thread_default (NULL);
+  watcher_id = g_bus_watch_name_on_connection (g_dbus_method_invocation_get_connection (invocation),
+                                               caller,
+                                               G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                               NULL, /* name_appeared_handler */
+                                               on_caller_vanished,
+                                               data,
+                                               (GDestroyNotify) caller_watch_data_free);
+  g_main_context_pop_thread_default (NULL);
+
+  /* the watch goes away with the cancellable */
+  g_object_set_data_full (G_OBJECT (cancellable),
+                          "x-udisks-caller-watcher-id",
+                          GUINT_TO_POINTER (watcher_id),
+                          unwatch_caller);
+
+ out:
+  return cancellable;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static const struct
+{
+  const gchar *prefix;
+  UDisksDeviceSpecType type;
+} device_spec_prefixes[] =
+{
+  {"UUID=", UDISKS_DEVICE_SPEC_UUID},
+  {"LABEL=", UDISKS_DEVICE_SPEC_LABEL},
+  {"PARTUUID=", UDISKS_DEVICE_SPEC_PARTUUID},
+  {"PARTLABEL=", UDISKS_DEVICE_SPEC_PARTLABEL},
+};
+
+/**
+ * udisks_daemon_util_parse_device_spec:
+ * @spec: How an <filename>/etc/fstab</filename> or <filename>/etc/crypttab</filename> entry refers to its device, e.g. <literal>UUID=1234-5678</literal>.
+ * @out_value: (out) (allow-none): Return location for the part of @spec after the prefix or %NULL.
+ *
+ * Finds out how @spec refers to a device. For
+ * %UDISKS_DEVICE_SPEC_PATH, @out_value is set to @spec itself.
+ *
+ * Returns: A #UDisksDeviceSpecType, %UDISKS_DEVICE_SPEC_NONE if the value after the prefix is empty.
+ */
+UDisksDeviceSpecType
+udisks_daemon_util_parse_device_spec (const gchar  *spec,
+                                      const gchar **out_value)
+{
+  UDisksDeviceSpecType type;
+  const gchar *value;
+  guint n;
+
+  g_return_val_if_fail (spec != NULL, UDISKS_DEVICE_SPEC_NONE);
+
+  type = UDISKS_DEVICE_SPEC_PATH;
+  value = spec;
+  for (n = 0; n < G_N_ELEMENTS (device_spec_prefixes); n++)
+    {
+      if (g_str_has_prefix (spec, device_spec_prefixes[n].prefix))
+        {
+          type = device_spec_prefixes[n].type;
+          value = spec + strlen (device_spec_prefixes[n].prefix);
+          break;
+        }
+    }
+
+  /* an empty LABEL= or UUID= can't refer to anything */
+  if (value[0] == '\0')
+    type = UDISKS_DEVICE_SPEC_NONE;
+
+  if (out_value != NULL)
+    *out_value = value;
+
+  return type;
+}
+
+/**
+ * UDisksDeviceSpecIndex:
+ *
+ * Indices of <filename>/etc/fstab</filename> or
+ * <filename>/etc/crypttab</filename> entries by how they refer to
+ * their device, see udisks_daemon_util_device_spec_index_new().
+ */
+struct _UDisksDeviceSpecIndex
+{
+  /* one table per UDisksDeviceSpecType, mapping the value to a GPtrArray of entries */
+  GHashTable *tables[UDISKS_DEVICE_SPEC_PARTLABEL + 1];
+};
+
+/**
+ * udisks_daemon_util_device_spec_index_new:
+ *
+ * Creates an empty index for finding <filename>/etc/fstab</filename>
+ * or <filename>/etc/crypttab</filename> entries referring to a device
+ * without looking at every entry.
+ *
+ * The index is not thread-safe and doesn't take references to the
+ * entries added to it.
+ *
+ * Returns: A #UDisksDeviceSpecIndex. Free with udisks_daemon_util_device_spec_index_free().
+ */
+UDisksDeviceSpecIndex *
+udisks_daemon_util_device_spec_index_new (void)
+{
+  UDisksDeviceSpecIndex *index;
+  guint n;
+
+  index = g_slice_new0 (UDisksDeviceSpecIndex);
+  for (n = UDISKS_DEVICE_SPEC_PATH; n < G_N_ELEMENTS (index->tables); n++)
+    index->tables[n] = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+
+  return index;
+}
+
+/**
+ * udisks_daemon_util_device_spec_index_free:
+ * @index: A #UDisksDeviceSpecIndex.
+ *
+ * Frees @index.
+ */
+void
+udisks_daemon_util_device_spec_index_free (UDisksDeviceSpecIndex *index)
+{
+  guint n;
+
+  for (n = UDISKS_DEVICE_SPEC_PATH; n < G_N_ELEMENTS (index->tables); n++)
+    g_hash_table_unref (index->tables[n]);
+  g_slice_free (UDisksDeviceSpecIndex, index);
+}
+
+/**
+ * udisks_daemon_util_device_spec_index_clear:
+ * @index: A #UDisksDeviceSpecIndex.
+ *
+ * Removes all entries from @index.
+ */
+void
+udisks_daemon_util_device_spec_index_clear (UDisksDeviceSpecIndex *index)
+{
+  guint n;
+
+  for (n = UDISKS_DEVICE_SPEC_PATH; n < G_N_ELEMENTS (index->tables); n++)
+    g_hash_table_remove_all (index->tables[n]);
+}
+
+/**
+ * udisks_daemon_util_device_spec_index_add:
+ * @index: A #UDisksDeviceSpecIndex.
+ * @spec: How @entry refers to its device, see udisks_daemon_util_parse_device_spec().
+ * @entry: The entry.
+ *
+ * Adds @entry to @index. Nothing is added if @spec can't refer to
+ * any device.
+ */
+void
+udisks_daemon_util_device_spec_index_add (UDisksDeviceSpecIndex *index,
+                                          const gchar           *spec,
+                                          GObject               *entry)
+{
+  UDisksDeviceSpecType type;
+  const gchar *value;
+  GPtrArray *entries;
+
+  type = udisks_daemon_util_parse_device_spec (spec, &value);
+  if (type == UDISKS_DEVICE_SPEC_NONE)
+    return;
+
+  entries = g_hash_table_lookup (index->tables[type], value);
+  if (entries == NULL)
+    {
+      entries = g_ptr_array_new ();
+      g_hash_table_insert (index->tables[type], g_strdup (value), entries);
+    }
+  g_ptr_array_add (entries, entry);
+}
+
+/* adds a reference to each entry in @table for @value to @list, if not already there */
+static GList *
+device_spec_index_lookup_one (GList       *list,
+                              GHashTable  *table,
+                              const gchar *value)
+{
+  GPtrArray *entries;
+  guint n;
+
+  if (value == NULL || value[0] == '\0')
+    goto out;
+
+  entries = g_hash_table_lookup (table, value);
+  for (n = 0; entries != NULL && n < entries->len; n++)
+    {
+      if (g_list_find (list, entries->pdata[n]) == NULL)
+        list = g_list_prepend (list, g_object_ref (entries->pdata[n]));
+    }
+
+ out:
+  return list;
+}
+
+/**
+ * udisks_daemon_util_device_spec_index_lookup:
+ * @index: A #UDisksDeviceSpecIndex.
+ * @device: (allow-none): The device file or %NULL.
+ * @symlinks: (allow-none): The symlinks to the device file or %NULL.
+ * @label: (allow-none): The filesystem label or %NULL.
+ * @uuid: (allow-none): The filesystem UUID or %NULL.
+ * @partlabel: (allow-none): The partition name or %NULL.
+ * @partuuid: (allow-none): The partition UUID or %NULL.
+ *
+ * Finds the entries in @index referring to a device with the given
+ * identifiers. Each entry is returned only once, even if it matches
+ * several identifiers.
+ *
+ * Returns: (transfer full): A list of entries that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_daemon_util_device_spec_index_lookup (UDisksDeviceSpecIndex *index,
+                                             const gchar           *device,
+                                             const gchar *const    *symlinks,
+                                             const gchar           *label,
+                                             const gchar           *uuid,
+                                             const gchar           *partlabel,
+                                             const gchar           *partuuid)
+{
+  GList *ret = NULL;
+  guint n;
+
+  ret = device_spec_index_lookup_one (ret, index->tables[UDISKS_DEVICE_SPEC_PATH], device);
+  for (n = 0; symlinks != NULL && symlinks[n] != NULL; n++)
+    ret = device_spec_index_lookup_one (ret, index->tables[UDISKS_DEVICE_SPEC_PATH], symlinks[n]);
+  ret = device_spec_index_lookup_one (ret, index->tables[UDISKS_DEVICE_SPEC_LABEL], label);
+  ret = device_spec_index_lookup_one (ret, index->tables[UDISKS_DEVICE_SPEC_UUID], uuid);
+  ret = device_spec_index_lookup_one (ret, index->tables[UDISKS_DEVICE_SPEC_PARTLABEL], partlabel);
+  ret = device_spec_index_lookup_one (ret, index->tables[UDISKS_DEVICE_SPEC_PARTUUID], partuuid);
+
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 /**
  * udisks_daemon_util_dup_object:
  * @interface_: (type GDBusInterface): A #GDBusInterface<!-- -->-derived instance.
@@ -86,6 +86,25 @@ gboolean udisks_daemon_util_get_caller_pid_sync (UDisksDaemon            *daemon
                                                  pid_t                   *out_pid,
                                                  GError                 **error);
 
+GCancellable *udisks_daemon_util_new_caller_cancellable (GDBusMethodInvocation *invocation);
+
+UDisksDeviceSpecType udisks_daemon_util_parse_device_spec (const gchar  *spec,
+                                                           const gchar **out_value);
+
+UDisksDeviceSpecIndex *udisks_daemon_util_device_spec_index_new    (void);
+void                   udisks_daemon_util_device_spec_index_free   (UDisksDeviceSpecIndex *index);
+void                   udisks_daemon_util_device_spec_index_clear  (UDisksDeviceSpecIndex *index);
+void                   udisks_daemon_util_device_spec_index_add    (UDisksDeviceSpecIndex *index,
+                                                                    const gchar           *spec,
+                                                                    GObject               *entry);
+GList                 *udisks_daemon_util_device_spec_index_lookup (UDisksDeviceSpecIndex *index,
+                                                                    const gchar           *device,
+                                                                    const gchar *const    *symlinks,
+                                                                    const gchar           *label,
+                                                                    const gchar           *uuid,
+                                                                    const gchar           *partlabel,
+                                                                    const gchar           *partuuid);
+
 gpointer  udisks_daemon_util_dup_object (gpointer   interface_,
                                          GError   **error);
 
@@ -37,6 +37,7 @@
 #include "udisksfstabentry.h"
 #include "udisksprivate.h"
 #include "udiskslogging.h"
+#include "udisksdaemonutil.h"
 
 /**
  * SECTION:udisksfstabmonitor
@@ -60,6 +61,12 @@ struct _UDisksFstabMonitor
   gboolean have_data;
   GList *fstab_entries;
 
+  /* index of the entries in @fstab_entries by what their fsname
+   * refers to - the device file, LABEL=, UUID=, PARTLABEL= or
+   * PARTUUID=
+   */
+  UDisksDeviceSpecIndex *entries_index;
+
   GFileMonitor *file_monitor;
 };
 
@@ -99,6 +106,8 @@ udisks_fstab_monitor_finalize (GObject *object)
 
   g_object_unref (monitor->file_monitor);
 
+  udisks_daemon_util_device_spec_index_free (monitor->entries_index);
+
   g_list_foreach (monitor->fstab_entries, (GFunc) g_object_unref, NULL);
   g_list_free (monitor->fstab_entries);
 
@@ -110,6 +119,7 @@ static void
 udisks_fstab_monitor_init (UDisksFstabMonitor *monitor)
 {
   monitor->fstab_entries = NULL;
+  monitor->entries_index = udisks_daemon_util_device_spec_index_new ();
 }
 
 static void
@@ -321,6 +331,8 @@ udisks_fstab_monitor_invalidate (UDisksFstabMonitor *monitor)
 {
   monitor->have_data = FALSE;
 
+  udisks_daemon_util_device_spec_index_clear (monitor->entries_index);
+
   g_list_foreach (monitor->fstab_entries, (GFunc) g_object_unref, NULL);
   g_list_free (monitor->fstab_entries);
   monitor->fstab_entries = NULL;
@@ -329,6 +341,22 @@ udisks_fstab_monitor_invalidate (UDisksFstabMonitor *monitor)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static void
+index_entry (UDisksFstabMonitor *monitor,
+             UDisksFstabEntry   *entry)
+{
+  const gchar *fsname;
+  const gchar *value;
+
+  fsname = udisks_fstab_entry_get_fsname (entry);
+  /* not a device entry, e.g. proc or a network filesystem */
+  if (udisks_daemon_util_parse_device_spec (fsname, &value) == UDISKS_DEVICE_SPEC_PATH &&
+      !g_str_has_prefix (value, "/dev"))
+    return;
+
+  udisks_daemon_util_device_spec_index_add (monitor->entries_index, fsname, G_OBJECT (entry));
+}
+
 static gboolean
 have_entry (UDisksFstabMonitor *monitor,
             UDisksFstabEntry   *entry)
@@ -380,6 +408,7 @@ udisks_fstab_monitor_ensure (UDisksFstabMonitor *monitor)
       if (!have_entry (monitor, entry))
         {
           monitor->fstab_entries = g_list_prepend (monitor->fstab_entries, entry);
+          index_entry (monitor, entry);
         }
       else
         {
@@ -416,3 +445,48 @@ udisks_fstab_monitor_get_entries (UDisksFstabMonitor  *monitor)
   return ret;
 }
 
+/**
+ * udisks_fstab_monitor_get_entries_for_device:
+ * @monitor: A #UDisksFstabMonitor.
+ * @device: (allow-none): The device file of the block device or %NULL.
+ * @symlinks: (allow-none): The symlinks for the block device or %NULL.
+ * @label: (allow-none): The filesystem label or %NULL.
+ * @uuid: (allow-none): The filesystem UUID or %NULL.
+ * @partlabel: (allow-none): The partition name or %NULL.
+ * @partuuid: (allow-none): The partition UUID or %NULL.
+ *
+ * Gets all /etc/fstab entries referring to a block device with the
+ * given identifiers - either by device file or symlink or by
+ * <literal>LABEL=</literal>, <literal>UUID=</literal>,
+ * <literal>PARTLABEL=</literal> or <literal>PARTUUID=</literal>.
+ *
+ * This uses an index maintained by @monitor so it does not have to
+ * look at every entry.
+ *
+ * Returns: (transfer full) (element-type UDisksFstabEntry): A list of #UDisksFstabEntry objects that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_fstab_monitor_get_entries_for_device (UDisksFstabMonitor  *monitor,
+                                             const gchar         *device,
+                                             const gchar *const  *symlinks,
+                                             const gchar         *label,
+                                             const gchar         *uuid,
+                                             const gchar         *partlabel,
+                                             const gchar         *partuuid)
+{
+  GList *ret;
+
+  g_return_val_if_fail (UDISKS_IS_FSTAB_MONITOR (monitor), NULL);
+
+  udisks_fstab_monitor_ensure (monitor);
+
+  ret = udisks_daemon_util_device_spec_index_lookup (monitor->entries_index,
+                                                     device,
+                                                     symlinks,
+                                                     label,
+                                                     uuid,
+                                                     partlabel,
+                                                     partuuid);
+
+  return ret;
+}
@@ -32,6 +32,13 @@ G_BEGIN_DECLS
 GType                udisks_fstab_monitor_get_type    (void) G_GNUC_CONST;
 UDisksFstabMonitor  *udisks_fstab_monitor_new         (void);
 GList               *udisks_fstab_monitor_get_entries (UDisksFstabMonitor  *monitor);
+GList               *udisks_fstab_monitor_get_entries_for_device (UDisksFstabMonitor  *monitor,
+                                                                  const gchar         *device,
+                                                                  const gchar *const  *symlinks,
+                                                                  const gchar         *label,
+                                                                  const gchar         *uuid,
+                                                                  const gchar         *partlabel,
+                                                                  const gchar         *partuuid);
 
 G_END_DECLS
 
@@ -148,52 +148,31 @@ get_sysfs_attr (GUdevDevice *device,
 /* ---------------------------------------------------------------------------------------------------- */
 
 static gchar *
-find_block_device_by_sysfs_path (GDBusObjectManagerServer *object_manager,
-                                 const gchar              *sysfs_path)
+find_block_device_by_sysfs_path (UDisksDaemon *daemon,
+                                 const gchar  *sysfs_path)
 {
+  UDisksObject *object;
   gchar *ret;
-  GList *objects;
-  GList *l;
-
-  ret = NULL;
-
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (object_manager));
-  for (l = objects; l != NULL; l = l->next)
-    {
-      GDBusObjectSkeleton *object = G_DBUS_OBJECT_SKELETON (l->data);
-      UDisksLinuxDevice *device;
 
-      if (!UDISKS_IS_LINUX_BLOCK_OBJECT (object))
-        continue;
-
-      device = udisks_linux_block_object_get_device (UDISKS_LINUX_BLOCK_OBJECT (object));
-      if (g_strcmp0 (sysfs_path, g_udev_device_get_sysfs_path (device->udev_device)) == 0)
-        {
-          ret = g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
-          g_object_unref (device);
-          goto out;
-        }
-      g_object_unref (device);
-    }
+  object = udisks_daemon_find_block_by_sysfs_path (daemon, sysfs_path);
+  if (object == NULL)
+    return NULL;
 
- out:
-  g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-  g_list_free (objects);
+  ret = g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+  g_object_unref (object);
   return ret;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
 static gchar *
-find_drive (GDBusObjectManagerServer  *object_manager,
-            GUdevDevice               *block_device,
-            UDisksDrive              **out_drive)
+find_drive (UDisksDaemon  *daemon,
+            GUdevDevice   *block_device,
+            UDisksDrive  **out_drive)
 {
   GUdevDevice *whole_disk_block_device;
-  const gchar *whole_disk_block_device_sysfs_path;
+  UDisksObject *object;
   gchar *ret;
-  GList *objects;
-  GList *l;
 
   ret = NULL;
 
@@ -201,78 +180,20 @@ find_drive (GDBusObjectManagerServer  *object_manager,
     whole_disk_block_device = g_object_ref (block_device);
   else
     whole_disk_block_device = g_udev_device_get_parent_with_subsystem (block_device, "block", "disk");
-  whole_disk_block_device_sysfs_path = g_udev_device_get_sysfs_path (whole_disk_block_device);
+  if (whole_disk_block_device == NULL)
+    goto out;
 
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (object_manager));
-  for (l = objects; l != NULL; l = l->next)
+  object = udisks_daemon_find_drive_by_sysfs_path (daemon, g_udev_device_get_sysfs_path (whole_disk_block_device));
+  if (object != NULL)
     {
-      GDBusObjectSkeleton *object = G_DBUS_OBJECT_SKELETON (l->data);
-      GList *drive_devices;
-      GList *j;
-
-      if (!UDISKS_IS_LINUX_DRIVE_OBJECT (object))
-        continue;
-
-      drive_devices = udisks_linux_drive_object_get_devices (UDISKS_LINUX_DRIVE_OBJECT (object));
-      for (j = drive_devices; j != NULL; j = j->next)
-        {
-          UDisksLinuxDevice *drive_device = UDISKS_LINUX_DEVICE (j->data);
-          const gchar *drive_sysfs_path;
-
-          drive_sysfs_path = g_udev_device_get_sysfs_path (drive_device->udev_device);
-          if (g_strcmp0 (whole_disk_block_device_sysfs_path, drive_sysfs_path) == 0)
-            {
-              if (out_drive != NULL)
-                *out_drive = udisks_object_get_drive (UDISKS_OBJECT (object));
-              ret = g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
-              g_list_foreach (drive_devices, (GFunc) g_object_unref, NULL);
-              g_list_free (drive_devices);
-              goto out;
-            }
-        }
-      g_list_foreach (drive_devices, (GFunc) g_object_unref, NULL);
-      g_list_free (drive_devices);
+      if (out_drive != NULL)
+        *out_drive = udisks_object_get_drive (object);
+      ret = g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+      g_object_unref (object);
     }
-
- out:
-  g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-  g_list_free (objects);
   g_object_unref (whole_disk_block_device);
-  return ret;
-}
-
-/* ---------------------------------------------------------------------------------------------------- */
-
-static UDisksLinuxMDRaidObject *
-find_mdraid (GDBusObjectManagerServer  *object_manager,
-             const gchar               *md_uuid)
-{
-  UDisksLinuxMDRaidObject *ret = NULL;
-  GList *objects = NULL, *l;
-
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (object_manager));
-  for (l = objects; l != NULL; l = l->next)
-    {
-      GDBusObjectSkeleton *object = G_DBUS_OBJECT_SKELETON (l->data);
-      if (UDISKS_IS_LINUX_MDRAID_OBJECT (object))
-        {
-          UDisksMDRaid *mdraid = udisks_object_get_mdraid (UDISKS_OBJECT (object));
-          if (mdraid != NULL)
-            {
-              if (g_strcmp0 (udisks_mdraid_get_uuid (mdraid), md_uuid) == 0)
-                {
-                  ret = g_object_ref (object);
-                  g_object_unref (mdraid);
-                  goto out;
-                }
-              g_object_unref (mdraid);
-            }
-        }
-    }
 
  out:
-  g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-  g_list_free (objects);
   return ret;
 }
 
@@ -282,18 +203,18 @@ static void
 update_mdraid (UDisksLinuxBlock         *block,
                UDisksLinuxDevice        *device,
                UDisksDrive              *drive,
-               GDBusObjectManagerServer *object_manager)
+               UDisksDaemon             *daemon)
 {
   UDisksBlock *iface = UDISKS_BLOCK (block);
   const gchar *uuid;
   const gchar *objpath_mdraid = "/";
   const gchar *objpath_mdraid_member = "/";
-  UDisksLinuxMDRaidObject *object = NULL;
+  UDisksObject *object = NULL;
 
   uuid = g_udev_device_get_property (device->udev_device, "UDISKS_MD_UUID");
   if (uuid != NULL && strlen (uuid) > 0)
     {
-      object = find_mdraid (object_manager, uuid);
+      object = udisks_daemon_find_mdraid (daemon, uuid);
       if (object != NULL)
         {
           objpath_mdraid = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
@@ -304,7 +225,7 @@ update_mdraid (UDisksLinuxBlock         *block,
   uuid = g_udev_device_get_property (device->udev_device, "UDISKS_MD_MEMBER_UUID");
   if (uuid != NULL && strlen (uuid) > 0)
     {
-      object = find_mdraid (object_manager, uuid);
+      object = udisks_daemon_find_mdraid (daemon, uuid);
       if (object != NULL)
         {
           objpath_mdraid_member = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
@@ -439,106 +360,34 @@ static GList *
 find_fstab_entries_for_device (UDisksLinuxBlock *block,
                                UDisksDaemon     *daemon)
 {
-  GList *entries;
-  GList *l;
+  UDisksBlock *iface = UDISKS_BLOCK (block);
+  UDisksLinuxBlockObject *object;
+  UDisksLinuxDevice *device = NULL;
+  const gchar *partuuid = NULL;
+  const gchar *partlabel = NULL;
   GList *ret;
 
-  ret = NULL;
-
-  /* if this is too slow, we could add lookup methods to UDisksFstabMonitor... */
-  entries = udisks_fstab_monitor_get_entries (udisks_daemon_get_fstab_monitor (daemon));
-  for (l = entries; l != NULL; l = l->next)
+  object = udisks_daemon_util_dup_object (block, NULL);
+  if (object != NULL)
     {
-      UDisksFstabEntry *entry = UDISKS_FSTAB_ENTRY (l->data);
-      const gchar *const *symlinks;
-      const gchar *fsname;
-      const gchar *device = NULL;
-      const gchar *label = NULL;
-      const gchar *uuid = NULL;
-      const gchar *partuuid = NULL;
-      const gchar *partlabel = NULL;
-      guint n;
-
-      fsname = udisks_fstab_entry_get_fsname (entry);
-      device = NULL;
-      if (g_str_has_prefix (fsname, "UUID="))
-        {
-          uuid = fsname + 5;
-        }
-      else if (g_str_has_prefix (fsname, "LABEL="))
-        {
-          label = fsname + 6;
-        }
-      else if (g_str_has_prefix (fsname, "PARTUUID="))
-        {
-          partuuid = fsname + 9;
-        }
-      else if (g_str_has_prefix (fsname, "PARTLABEL="))
-        {
-          partlabel = fsname + 10;
-        }
-      else if (g_str_has_prefix (fsname, "/dev"))
-        {
-          device = fsname;
-        }
-      else
-        {
-          /* ignore non-device entries */
-          goto continue_loop;
-        }
-
-      if (device != NULL)
-        {
-          if (g_strcmp0 (device, udisks_block_get_device (UDISKS_BLOCK (block))) == 0)
-            {
-              ret = g_list_prepend (ret, g_object_ref (entry));
-            }
-          else
-            {
-              symlinks = udisks_block_get_symlinks (UDISKS_BLOCK (block));
-              if (symlinks != NULL)
-                {
-                  for (n = 0; symlinks[n] != NULL; n++)
-                    {
-                      if (g_strcmp0 (device, symlinks[n]) == 0)
-                        {
-                          ret = g_list_prepend (ret, g_object_ref (entry));
-                        }
-                    }
-                }
-            }
-        }
-      else if (label != NULL && g_strcmp0 (label, udisks_block_get_id_label (UDISKS_BLOCK (block))) == 0)
-        {
-          ret = g_list_prepend (ret, g_object_ref (entry));
-        }
-      else if (uuid != NULL && g_strcmp0 (uuid, udisks_block_get_id_uuid (UDISKS_BLOCK (block))) == 0)
-        {
-          ret = g_list_prepend (ret, g_object_ref (entry));
-        }
-      else if (partlabel != NULL || partuuid != NULL)
-        {
-          UDisksLinuxBlockObject *object;
-          GUdevDevice *u_dev = NULL;
-
-          object = udisks_daemon_util_dup_object (block, NULL);
-          if (object == NULL)
-            goto continue_loop;
-          u_dev = udisks_linux_block_object_get_device (object)->udev_device;
-          g_clear_object (&object);
-          if (u_dev == NULL)
-            goto continue_loop;
-          if ((partuuid != NULL && g_strcmp0 (partuuid, g_udev_device_get_property (u_dev, "ID_PART_ENTRY_UUID")) == 0) ||
-              (partlabel != NULL && g_strcmp0 (partlabel, g_udev_device_get_property (u_dev, "ID_PART_ENTRY_NAME")) == 0))
-            ret = g_list_prepend (ret, g_object_ref (entry));
-        }
-
-    continue_loop:
-      ;
+      device = udisks_linux_block_object_get_device (object);
+      g_object_unref (object);
+    }
+  if (device != NULL && device->udev_device != NULL)
+    {
+      partuuid = g_udev_device_get_property (device->udev_device, "ID_PART_ENTRY_UUID");
+      partlabel = g_udev_device_get_property (device->udev_device, "ID_PART_ENTRY_NAME");
     }
 
-  g_list_foreach (entries, (GFunc) g_object_unref, NULL);
-  g_list_free (entries);
+  ret = udisks_fstab_monitor_get_entries_for_device (udisks_daemon_get_fstab_monitor (daemon),
+                                                     udisks_block_get_device (iface),
+                                                     udisks_block_get_symlinks (iface),
+                                                     udisks_block_get_id_label (iface),
+                                                     udisks_block_get_id_uuid (iface),
+                                                     partlabel,
+                                                     partuuid);
+
+  g_clear_object (&device);
   return ret;
 }
 
@@ -546,80 +395,13 @@ static GList *
 find_crypttab_entries_for_device (UDisksLinuxBlock *block,
                                   UDisksDaemon     *daemon)
 {
-  GList *entries;
-  GList *l;
-  GList *ret;
-
-  ret = NULL;
-
-  /* if this is too slow, we could add lookup methods to UDisksCrypttabMonitor... */
-  entries = udisks_crypttab_monitor_get_entries (udisks_daemon_get_crypttab_monitor (daemon));
-  for (l = entries; l != NULL; l = l->next)
-    {
-      UDisksCrypttabEntry *entry = UDISKS_CRYPTTAB_ENTRY (l->data);
-      const gchar *const *symlinks;
-      const gchar *device_in_entry;
-      const gchar *device = NULL;
-      const gchar *label = NULL;
-      const gchar *uuid = NULL;
-      guint n;
-
-      device_in_entry = udisks_crypttab_entry_get_device (entry);
-      if (g_str_has_prefix (device_in_entry, "UUID="))
-        {
-          uuid = device_in_entry + 5;
-        }
-      else if (g_str_has_prefix (device_in_entry, "LABEL="))
-        {
-          label = device_in_entry + 6;
-        }
-      else if (g_str_has_prefix (device_in_entry, "/dev"))
-        {
-          device = device_in_entry;
-        }
-      else
-        {
-          /* ignore non-device entries */
-          goto continue_loop;
-        }
-
-      if (device != NULL)
-        {
-          if (g_strcmp0 (device, udisks_block_get_device (UDISKS_BLOCK (block))) == 0)
-            {
-              ret = g_list_prepend (ret, g_object_ref (entry));
-            }
-          else
-            {
-              symlinks = udisks_block_get_symlinks (UDISKS_BLOCK (block));
-              if (symlinks != NULL)
-                {
-                  for (n = 0; symlinks[n] != NULL; n++)
-                    {
-                      if (g_strcmp0 (device, symlinks[n]) == 0)
-                        {
-                          ret = g_list_prepend (ret, g_object_ref (entry));
-                        }
-                    }
-                }
-            }
-        }
-      else if (label != NULL && g_strcmp0 (label, udisks_block_get_id_label (UDISKS_BLOCK (block))) == 0)
-        {
-          ret = g_list_prepend (ret, g_object_ref (entry));
-        }
-      else if (uuid != NULL && g_strcmp0 (uuid, udisks_block_get_id_uuid (UDISKS_BLOCK (block))) == 0)
-        {
-          ret = g_list_prepend (ret, g_object_ref (entry));
-        }
-
-    continue_loop:
-      ;
-    }
+  UDisksBlock *iface = UDISKS_BLOCK (block);
 
-  g_list_foreach (entries, (GFunc) g_object_unref, NULL);
-  g_list_free (entries);
-  return ret;
+  return udisks_crypttab_monitor_get_entries_for_device (udisks_daemon_get_crypttab_monitor (daemon),
+                                                         udisks_block_get_device (iface),
+                                                         udisks_block_get_symlinks (iface),
+                                                         udisks_block_get_id_label (iface),
+                                                         udisks_block_get_id_uuid (iface));
 }
 
 static void
@@ -906,7 +688,6 @@ udisks_linux_block_update (UDisksLinuxBlock       *block,
 {
   UDisksBlock *iface = UDISKS_BLOCK (block);
   UDisksDaemon *daemon;
-  GDBusObjectManagerServer *object_manager;
   UDisksLinuxDevice *device;
   GUdevDeviceNumber dev;
   gchar *drive_object_path;
@@ -930,7 +711,6 @@ udisks_linux_block_update (UDisksLinuxBlock       *block,
     goto out;
 
   daemon = udisks_linux_block_object_get_daemon (object);
-  object_manager = udisks_daemon_get_object_manager (daemon);
 
   dev = g_udev_device_get_device_number (device->udev_device);
   device_file = g_udev_device_get_device_file (device->udev_device);
@@ -969,7 +749,7 @@ udisks_linux_block_update (UDisksLinuxBlock       *block,
           if (g_strv_length (slaves) == 1)
             {
               gchar *slave_object_path;
-              slave_object_path = find_block_device_by_sysfs_path (object_manager, slaves[0]);
+              slave_object_path = find_block_device_by_sysfs_path (daemon, slaves[0]);
               if (slave_object_path != NULL)
                 {
                   udisks_block_set_crypto_backing_device (iface, slave_object_path);
@@ -1044,12 +824,8 @@ udisks_linux_block_update (UDisksLinuxBlock       *block,
     preferred_device_file = g_udev_device_get_device_file (device->udev_device);
   udisks_block_set_preferred_device (iface, preferred_device_file);
 
-  /* Determine the drive this block device belongs to
-   *
-   * TODO: if this is slow we could have a cache or ensure that we
-   * only do this once or something else
-   */
-  drive_object_path = find_drive (object_manager, device->udev_device, &drive);
+  /* Determine the drive this block device belongs to */
+  drive_object_path = find_drive (daemon, device->udev_device, &drive);
   if (drive_object_path != NULL)
     {
       udisks_block_set_drive (iface, drive_object_path);
@@ -1133,7 +909,7 @@ udisks_linux_block_update (UDisksLinuxBlock       *block,
 
   update_hints (block, device, drive);
   update_configuration (block, daemon);
-  update_mdraid (block, device, drive, object_manager);
+  update_mdraid (block, device, drive, daemon);
 
  out:
   if (device != NULL)
@@ -2737,6 +2513,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   gboolean was_partitioned = FALSE;
   UDisksInhibitCookie *inhibit_cookie = NULL;
   gboolean no_block = FALSE;
+  GCancellable *cancellable = NULL;
   gboolean update_partition_type = FALSE;
   gboolean dry_run_first = FALSE;
   const gchar *partition_type = NULL;
@@ -2760,6 +2537,9 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   command = NULL;
   error_message = NULL;
 
+  /* stop waiting for the device if the caller goes away */
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
+
   g_variant_lookup (options, "take-ownership", "b", &take_ownership);
   udisks_variant_lookup_binary (options, "encrypt.passphrase", &encrypt_passphrase);
   g_variant_lookup (options, "erase", "s", &erase_type);
@@ -2928,6 +2708,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
                                           wait_data,
                                           NULL,
                                           15,
+                                          cancellable,
                                           &error) == NULL)
     {
       g_prefix_error (&error, "Error synchronizing after initial wipe: ");
@@ -2973,6 +2754,8 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
     {
       complete (complete_user_data);
       invocation = NULL;
+      /* the caller may go away now, that must not stop us */
+      g_clear_object (&cancellable);
     }
 
   /* Erase the device, if requested
@@ -3020,6 +2803,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
                                               wait_data,
                                               NULL,
                                               30,
+                                              cancellable,
                                               &error) == NULL)
         {
           g_prefix_error (&error, "Error waiting for LUKS UUID: ");
@@ -3056,6 +2840,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
                                                              wait_data,
                                                              NULL,
                                                              30,
+                                                             cancellable,
                                                              &error);
       if (cleartext_object == NULL)
         {
@@ -3163,6 +2948,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
                                           wait_data,
                                           NULL,
                                           30,
+                                          cancellable,
                                           &error) == NULL)
     {
       g_prefix_error (&error,
@@ -3308,6 +3094,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   g_clear_object (&cleartext_block);
   g_clear_object (&udev_cleartext_device);
   g_free (wait_data);
+  g_clear_object (&cancellable);
   g_clear_object (&partition_table);
   g_clear_object (&partition);
   g_clear_object (&object);
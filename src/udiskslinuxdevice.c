@@ -41,6 +41,7 @@
 #include "udiskslogging.h"
 #include "udisksata.h"
 #include "udisksdaemonutil.h"
+#include "udiskstrace.h"
 
 /**
  * SECTION:udiskslinuxdevice
@@ -117,6 +118,10 @@ udisks_linux_device_new_sync (GUdevDevice *udev_device)
   device = g_object_new (UDISKS_TYPE_LINUX_DEVICE, NULL);
   device->udev_device = g_object_ref (udev_device);
 
+  UDISKS_TRACE2 (probe_start,
+                 g_udev_device_get_action (udev_device),
+                 g_udev_device_get_sysfs_path (udev_device));
+
   /* No point in probing on remove events */
   if (!(g_strcmp0 (g_udev_device_get_action (udev_device), "remove") == 0))
     {
@@ -132,6 +137,10 @@ udisks_linux_device_new_sync (GUdevDevice *udev_device)
       g_clear_error (&error);
     }
 
+  UDISKS_TRACE2 (probe_end,
+                 g_udev_device_get_action (udev_device),
+                 g_udev_device_get_sysfs_path (udev_device));
+
   return device;
 }
 
@@ -68,6 +68,9 @@ struct _UDisksLinuxDriveObject
   UDisksDrive *iface_drive;
   UDisksDriveAta *iface_drive_ata;
   GHashTable *module_ifaces;
+
+  /* set if the last housekeeping found the drive in a sleep state */
+  gboolean housekeeping_found_standby;
 };
 
 struct _UDisksLinuxDriveObjectClass
@@ -980,8 +983,8 @@ udisks_linux_drive_object_should_include_device (GUdevClient        *client,
  * @cancellable: A %GCancellable or %NULL.
  * @error: Return location for error or %NULL.
  *
- * Called periodically (every ten minutes or so) to perform
- * housekeeping tasks such as refreshing ATA SMART data.
+ * Called periodically (see udisks_linux_drive_object_get_housekeeping_interval())
+ * to perform housekeeping tasks such as refreshing ATA SMART data.
  *
  * The function runs in a dedicated thread and is allowed to perform
  * blocking I/O.
@@ -1017,6 +1020,7 @@ udisks_linux_drive_object_housekeeping (UDisksLinuxDriveObject  *object,
                    g_dbus_object_get_object_path (G_DBUS_OBJECT (object)),
                    nowakeup);
 
+      object->housekeeping_found_standby = FALSE;
       local_error = NULL;
       if (!udisks_linux_drive_ata_refresh_smart_sync (UDISKS_LINUX_DRIVE_ATA (object->iface_drive_ata),
                                                       nowakeup,
@@ -1029,6 +1033,7 @@ udisks_linux_drive_object_housekeeping (UDisksLinuxDriveObject  *object,
             {
               udisks_info ("Drive %s is in a sleep state",
                            g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+              object->housekeeping_found_standby = TRUE;
               g_clear_error (&local_error);
             }
           else if (nowakeup && (local_error->domain == UDISKS_ERROR &&
@@ -1053,6 +1058,81 @@ udisks_linux_drive_object_housekeeping (UDisksLinuxDriveObject  *object,
   return ret;
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Default housekeeping intervals, in seconds - can be overridden in the drive configuration file */
+#define HOUSEKEEPING_INTERVAL_DEFAULT           (10*60)
+#define HOUSEKEEPING_INTERVAL_FAILING_DEFAULT   (2*60)
+#define HOUSEKEEPING_INTERVAL_STANDBY_DEFAULT   (30*60)
+
+static guint
+lookup_housekeeping_interval (GVariant    *configuration,
+                              const gchar *key,
+                              guint        default_value)
+{
+  gint32 value;
+
+  if (configuration != NULL && g_variant_lookup (configuration, key, "i", &value) && value > 0)
+    return value;
+  return default_value;
+}
+
+/**
+ * udisks_linux_drive_object_get_housekeeping_interval:
+ * @object: A #UDisksLinuxDriveObject.
+ *
+ * Gets the number of seconds to wait before the next
+ * udisks_linux_drive_object_housekeeping() call for @object.
+ *
+ * Drives whose SMART data shows failing attributes or bad sectors are
+ * checked more often, drives found in a sleep state less often. The
+ * intervals can be set with the <literal>housekeeping-interval</literal>,
+ * <literal>housekeeping-interval-failing</literal> and
+ * <literal>housekeeping-interval-standby</literal> keys of the
+ * #UDisksDrive:configuration property.
+ *
+ * Returns: The interval in seconds.
+ */
+guint
+udisks_linux_drive_object_get_housekeeping_interval (UDisksLinuxDriveObject *object)
+{
+  GVariant *configuration;
+  guint ret;
+
+  g_return_val_if_fail (UDISKS_IS_LINUX_DRIVE_OBJECT (object), HOUSEKEEPING_INTERVAL_DEFAULT);
+
+  /* called from a housekeeping thread so take a reference */
+  configuration = udisks_drive_dup_configuration (object->iface_drive);
+
+  if (object->iface_drive_ata != NULL &&
+      udisks_drive_ata_get_smart_updated (object->iface_drive_ata) > 0 &&
+      (udisks_drive_ata_get_smart_failing (object->iface_drive_ata) ||
+       udisks_drive_ata_get_smart_num_attributes_failing (object->iface_drive_ata) > 0 ||
+       udisks_drive_ata_get_smart_num_bad_sectors (object->iface_drive_ata) > 0))
+    {
+      ret = lookup_housekeeping_interval (configuration,
+                                          "housekeeping-interval-failing",
+                                          HOUSEKEEPING_INTERVAL_FAILING_DEFAULT);
+    }
+  else if (object->housekeeping_found_standby)
+    {
+      ret = lookup_housekeeping_interval (configuration,
+                                          "housekeeping-interval-standby",
+                                          HOUSEKEEPING_INTERVAL_STANDBY_DEFAULT);
+    }
+  else
+    {
+      ret = lookup_housekeeping_interval (configuration,
+                                          "housekeeping-interval",
+                                          HOUSEKEEPING_INTERVAL_DEFAULT);
+    }
+
+  if (configuration != NULL)
+    g_variant_unref (configuration);
+
+  return ret;
+}
+
 static gboolean
 is_block_unlocked (GList *objects, const gchar *crypto_object_path)
 {
@@ -50,6 +50,8 @@ gboolean                udisks_linux_drive_object_housekeeping  (UDisksLinuxDriv
                                                                  GCancellable             *cancellable,
                                                                  GError                  **error);
 
+guint                   udisks_linux_drive_object_get_housekeeping_interval (UDisksLinuxDriveObject *object);
+
 gboolean                udisks_linux_drive_object_is_not_in_use (UDisksLinuxDriveObject   *object,
                                                                  GCancellable             *cancellable,
                                                                  GError                  **error);
@@ -255,6 +255,7 @@ handle_unlock (UDisksEncrypted        *encrypted,
                GVariant               *options)
 {
   UDisksObject *object = NULL;
+  GCancellable *cancellable;
   UDisksBlock *block;
   UDisksDaemon *daemon;
   UDisksState *state;
@@ -311,6 +312,7 @@ handle_unlock (UDisksEncrypted        *encrypted,
                                                          g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object))),
                                                          g_free,
                                                          0, /* timeout_seconds */
+                                                         NULL, /* cancellable */
                                                          NULL); /* error */
   if (cleartext_object != NULL)
     {
@@ -435,12 +437,15 @@ handle_unlock (UDisksEncrypted        *encrypted,
 
   /* Determine the resulting cleartext object */
   error = NULL;
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   cleartext_object = udisks_daemon_wait_for_object_sync (daemon,
                                                          wait_for_cleartext_object,
                                                          g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object))),
                                                          g_free,
                                                          10, /* timeout_seconds */
+                                                         cancellable,
                                                          &error);
+  g_object_unref (cancellable);
   if (cleartext_object == NULL)
     {
       g_prefix_error (&error,
@@ -550,6 +555,7 @@ udisks_linux_encrypted_lock (UDisksLinuxEncrypted   *encrypted,
                                                          g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object))),
                                                          g_free,
                                                          0, /* timeout_seconds */
+                                                         NULL, /* cancellable */
                                                          NULL); /* error */
   if (cleartext_object == NULL)
     {
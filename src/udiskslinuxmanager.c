@@ -301,6 +301,7 @@ handle_loop_setup (UDisksManager          *object,
                    GVariant               *options)
 {
   UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  GCancellable *cancellable;
   GError *error;
   gint fd_num;
   gint fd = -1;
@@ -454,12 +455,15 @@ handle_loop_setup (UDisksManager          *object,
   error = NULL;
   wait_data.loop_device = loop_device;
   wait_data.path = path;
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   loop_object = udisks_daemon_wait_for_object_sync (manager->daemon,
                                                     wait_for_loop_object,
                                                     &wait_data,
                                                     NULL,
                                                     10, /* timeout_seconds */
+                                                    cancellable,
                                                     &error);
+  g_object_unref (cancellable);
   if (loop_object == NULL)
     {
       g_prefix_error (&error,
@@ -563,6 +567,7 @@ handle_mdraid_create (UDisksManager         *_object,
                       GVariant              *arg_options)
 {
   UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (_object);
+  GCancellable *cancellable;
   UDisksObject *array_object = NULL;
   uid_t caller_uid;
   GError *error = NULL;
@@ -823,12 +828,15 @@ handle_mdraid_create (UDisksManager         *_object,
     raid_device_file = g_strdup (array_name);
 
   /* ... then, sit and wait for raid array object to show up */
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   array_object = udisks_daemon_wait_for_object_sync (manager->daemon,
                                                      wait_for_array_object,
                                                      raid_device_file,
                                                      NULL,
                                                      10, /* timeout_seconds */
+                                                     cancellable,
                                                      &error);
+  g_object_unref (cancellable);
   if (array_object == NULL)
     {
       g_prefix_error (&error,
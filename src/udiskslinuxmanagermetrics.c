@@ -0,0 +1,244 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+#include <glib/gi18n-lib.h>
+
+#include "udiskslogging.h"
+#include "udiskslinuxmanagermetrics.h"
+#include "udisksdaemon.h"
+#include "udiskslinuxprovider.h"
+#include "udisksmethodqueue.h"
+#include "udisksmetrics.h"
+#include "udisksmountmonitor.h"
+
+/**
+ * SECTION:udiskslinuxmanagermetrics
+ * @title: UDisksLinuxManagerMetrics
+ * @short_description: Linux implementation of #UDisksManagerMetrics
+ *
+ * This type provides an implementation of the #UDisksManagerMetrics
+ * interface on Linux.
+ */
+
+typedef struct _UDisksLinuxManagerMetricsClass   UDisksLinuxManagerMetricsClass;
+
+/**
+ * UDisksLinuxManagerMetrics:
+ *
+ * The #UDisksLinuxManagerMetrics structure contains only private data and should
+ * only be accessed using the provided API.
+ */
+struct _UDisksLinuxManagerMetrics
+{
+  UDisksManagerMetricsSkeleton parent_instance;
+
+  UDisksDaemon *daemon;
+};
+
+struct _UDisksLinuxManagerMetricsClass
+{
+  UDisksManagerMetricsSkeletonClass parent_class;
+};
+
+enum
+{
+  PROP_0,
+  PROP_DAEMON
+};
+
+static void manager_metrics_iface_init (UDisksManagerMetricsIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (UDisksLinuxManagerMetrics, udisks_linux_manager_metrics, UDISKS_TYPE_MANAGER_METRICS_SKELETON,
+                         G_IMPLEMENT_INTERFACE (UDISKS_TYPE_MANAGER_METRICS, manager_metrics_iface_init));
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+udisks_linux_manager_metrics_get_property (GObject    *object,
+                                           guint       prop_id,
+                                           GValue     *value,
+                                           GParamSpec *pspec)
+{
+  UDisksLinuxManagerMetrics *manager = UDISKS_LINUX_MANAGER_METRICS (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_value_set_object (value, udisks_linux_manager_metrics_get_daemon (manager));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_linux_manager_metrics_set_property (GObject      *object,
+                                           guint         prop_id,
+                                           const GValue *value,
+                                           GParamSpec   *pspec)
+{
+  UDisksLinuxManagerMetrics *manager = UDISKS_LINUX_MANAGER_METRICS (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_assert (manager->daemon == NULL);
+      /* we don't take a reference to the daemon */
+      manager->daemon = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_linux_manager_metrics_init (UDisksLinuxManagerMetrics *manager)
+{
+  g_dbus_interface_skeleton_set_flags (G_DBUS_INTERFACE_SKELETON (manager),
+                                       G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD);
+}
+
+static void
+udisks_linux_manager_metrics_class_init (UDisksLinuxManagerMetricsClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->set_property = udisks_linux_manager_metrics_set_property;
+  gobject_class->get_property = udisks_linux_manager_metrics_get_property;
+
+  /**
+   * UDisksLinuxManagerMetrics:daemon:
+   *
+   * The #UDisksDaemon for the object.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_DAEMON,
+                                   g_param_spec_object ("daemon",
+                                                        "Daemon",
+                                                        "The daemon for the object",
+                                                        UDISKS_TYPE_DAEMON,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * udisks_linux_manager_metrics_new:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Creates a new #UDisksLinuxManagerMetrics instance.
+ *
+ * Returns: A new #UDisksLinuxManagerMetrics. Free with g_object_unref().
+ */
+UDisksManagerMetrics *
+udisks_linux_manager_metrics_new (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return UDISKS_MANAGER_METRICS (g_object_new (UDISKS_TYPE_LINUX_MANAGER_METRICS,
+                                               "daemon", daemon,
+                                               NULL));
+}
+
+/**
+ * udisks_linux_manager_metrics_get_daemon:
+ * @manager: A #UDisksLinuxManagerMetrics.
+ *
+ * Gets the daemon used by @manager.
+ *
+ * Returns: A #UDisksDaemon. Do not free, the object is owned by @manager.
+ */
+UDisksDaemon *
+udisks_linux_manager_metrics_get_daemon (UDisksLinuxManagerMetrics *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_LINUX_MANAGER_METRICS (manager), NULL);
+  return manager->daemon;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* runs in a dedicated thread - never waits in the method queue, see
+ * on_authorize_method() in udisksdaemon.c
+ */
+static gboolean
+handle_get_metrics (UDisksManagerMetrics  *object,
+                    GDBusMethodInvocation *invocation,
+                    GVariant              *options)
+{
+  UDisksLinuxManagerMetrics *manager = UDISKS_LINUX_MANAGER_METRICS (object);
+  GVariantBuilder builder;
+  guint num_queued, num_in_flight, max_queued;
+  guint64 num_dispatched;
+  gint64 total_wait_usec;
+  gint64 mount_update_usec;
+  guint64 num_housekeeping_timed_out;
+  gchar **stuck_drives;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+  g_variant_builder_add (&builder, "{sv}", "durations",
+                         udisks_metrics_get_durations (udisks_daemon_get_metrics (manager->daemon)));
+  g_variant_builder_add (&builder, "{sv}", "counters",
+                         udisks_metrics_get_counters (udisks_daemon_get_metrics (manager->daemon)));
+
+  g_variant_builder_add (&builder, "{sv}", "uevent-queue-depth",
+                         g_variant_new_uint32 (udisks_linux_provider_get_probe_queue_depth (udisks_daemon_get_linux_provider (manager->daemon))));
+
+  stuck_drives = udisks_linux_provider_get_housekeeping_stats (udisks_daemon_get_linux_provider (manager->daemon),
+                                                              &num_housekeeping_timed_out);
+  g_variant_builder_add (&builder, "{sv}", "drive-housekeeping-timeouts", g_variant_new_uint64 (num_housekeeping_timed_out));
+  g_variant_builder_add (&builder, "{sv}", "drive-housekeeping-stuck", g_variant_new_objv ((const gchar * const *) stuck_drives, -1));
+  g_strfreev (stuck_drives);
+
+  udisks_method_queue_get_stats (udisks_daemon_get_method_queue (manager->daemon),
+                                 &num_queued,
+                                 &num_in_flight,
+                                 &max_queued,
+                                 &num_dispatched,
+                                 &total_wait_usec);
+  g_variant_builder_add (&builder, "{sv}", "method-calls-queued", g_variant_new_uint32 (num_queued));
+  g_variant_builder_add (&builder, "{sv}", "method-calls-in-flight", g_variant_new_uint32 (num_in_flight));
+  g_variant_builder_add (&builder, "{sv}", "method-calls-max-queued", g_variant_new_uint32 (max_queued));
+  g_variant_builder_add (&builder, "{sv}", "method-calls-dispatched", g_variant_new_uint64 (num_dispatched));
+  g_variant_builder_add (&builder, "{sv}", "method-calls-wait-usec", g_variant_new_uint64 (total_wait_usec));
+
+  udisks_mount_monitor_get_stats (udisks_daemon_get_mount_monitor (manager->daemon),
+                                  &mount_update_usec,
+                                  NULL, NULL, NULL);
+  g_variant_builder_add (&builder, "{sv}", "mount-monitor-update-usec", g_variant_new_int64 (mount_update_usec));
+
+  udisks_manager_metrics_complete_get_metrics (object, invocation, g_variant_builder_end (&builder));
+
+  return TRUE; /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+manager_metrics_iface_init (UDisksManagerMetricsIface *iface)
+{
+  iface->handle_get_metrics = handle_get_metrics;
+}
@@ -71,6 +71,12 @@ struct _UDisksLinuxMDRaidClass
   UDisksMDRaidSkeletonClass parent_class;
 };
 
+/* The sync progress is normally updated when the kernel notifies
+ * about changes to md/sync_completed (see udiskslinuxmdraidobject.c)
+ * - only poll if no such notification arrived for this long
+ */
+#define SYNC_POLL_INTERVAL_SECONDS 5
+
 static void ensure_polling (UDisksLinuxMDRaid  *mdraid,
                             gboolean            polling_on);
 
@@ -191,7 +197,6 @@ on_polling_timout (gpointer user_data)
 {
   UDisksLinuxMDRaid *mdraid = UDISKS_LINUX_MDRAID (user_data);
   UDisksLinuxMDRaidObject *object = NULL;
-  UDisksLinuxDevice *raid_device;
 
   /* udisks_debug ("polling timeout"); */
 
@@ -199,13 +204,11 @@ on_polling_timout (gpointer user_data)
   if (object == NULL)
     goto out;
 
-  /* synthesize uevent */
-  raid_device = udisks_linux_mdraid_object_get_device (object);
-  if (raid_device != NULL)
-    {
-      udisks_linux_mdraid_object_uevent (object, "change", raid_device, FALSE);
-      g_object_unref (raid_device);
-    }
+  if (g_get_monotonic_time () - udisks_linux_mdraid_object_get_last_sync_notification (object)
+      < SYNC_POLL_INTERVAL_SECONDS * G_USEC_PER_SEC)
+    goto out;
+
+  udisks_linux_mdraid_update_sync_progress (mdraid, object);
 
  out:
   g_clear_object (&object);
@@ -220,7 +223,7 @@ ensure_polling (UDisksLinuxMDRaid  *mdraid,
     {
       if (mdraid->polling_timeout == 0)
         {
-          mdraid->polling_timeout = g_timeout_add_seconds (1,
+          mdraid->polling_timeout = g_timeout_add_seconds (SYNC_POLL_INTERVAL_SECONDS,
                                                            on_polling_timout,
                                                            mdraid);
         }
@@ -269,6 +272,105 @@ sync_action_to_job_id (const char *sync_action)
     return "mdraid-sync-job";
 }
 
+/* Updates the sync related properties and the sync job from the
+ * given values of the md/sync_action and md/sync_completed sysfs
+ * attributes, reading md/sync_speed if a sync is in progress
+ */
+static void
+update_sync_progress (UDisksLinuxMDRaid       *mdraid,
+                      UDisksLinuxMDRaidObject *object,
+                      UDisksLinuxDevice       *raid_device,
+                      const gchar             *sync_action,
+                      const gchar             *sync_completed)
+{
+  UDisksMDRaid *iface = UDISKS_MDRAID (mdraid);
+  UDisksDaemon *daemon;
+  gdouble sync_completed_val = 0.0;
+  guint64 sync_rate = 0;
+  guint64 sync_remaining_time = 0;
+  UDisksBaseJob *job = NULL;
+
+  daemon = udisks_linux_mdraid_object_get_daemon (object);
+
+  udisks_mdraid_set_sync_action (iface, sync_action);
+
+  if (sync_completed != NULL && g_strcmp0 (sync_completed, "none") != 0)
+    {
+      guint64 completed_sectors = 0;
+      guint64 num_sectors = 1;
+      if (sscanf (sync_completed, "%" G_GUINT64_FORMAT " / %" G_GUINT64_FORMAT,
+                  &completed_sectors, &num_sectors) == 2)
+        {
+          if (num_sectors != 0)
+            sync_completed_val = ((gdouble) completed_sectors) / ((gdouble) num_sectors);
+        }
+
+      /* this is KiB/s (see drivers/md/md.c:sync_speed_show() */
+      sync_rate = read_sysfs_attr_as_uint64 (raid_device->udev_device, "md/sync_speed") * 1024;
+      if (sync_rate > 0)
+        {
+          guint64 num_bytes_remaining = (num_sectors - completed_sectors) * 512ULL;
+          sync_remaining_time = ((guint64) G_USEC_PER_SEC) * num_bytes_remaining / sync_rate;
+        }
+    }
+
+  if (sync_action)
+    {
+      if (g_strcmp0 (sync_action, "idle") != 0)
+        {
+          if (! udisks_linux_mdraid_object_has_sync_job (object))
+            {
+              /* Launch a job */
+              job = udisks_daemon_launch_simple_job (daemon,
+                                                     UDISKS_OBJECT (object),
+                                                     sync_action_to_job_id (sync_action),
+                                                     0,
+                                                     NULL /* cancellable */);
+
+              /* Mark the job as not cancellable. It simply has to finish... */
+              udisks_job_set_cancelable (UDISKS_JOB (job), FALSE);
+              udisks_linux_mdraid_object_set_sync_job (object, job);
+            }
+          else
+            job = udisks_linux_mdraid_object_get_sync_job (object);
+
+          /* Update the job's interface */
+          udisks_job_set_progress (UDISKS_JOB (job), sync_completed_val);
+          udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
+          udisks_job_set_rate (UDISKS_JOB (job), sync_rate);
+
+          udisks_job_set_expected_end_time (UDISKS_JOB (job),
+                                            g_get_real_time () + sync_remaining_time);
+        }
+      else
+        {
+          if (udisks_linux_mdraid_object_has_sync_job (object))
+            {
+              /* Complete the job */
+              udisks_linux_mdraid_object_complete_sync_job (object,
+                                                            TRUE,
+                                                            "Finished");
+            }
+        }
+    }
+  udisks_mdraid_set_sync_completed (iface, sync_completed_val);
+  udisks_mdraid_set_sync_rate (iface, sync_rate);
+  udisks_mdraid_set_sync_remaining_time (iface, sync_remaining_time);
+
+  /* ensure we poll, exactly when we need to */
+  if (g_strcmp0 (sync_action, "resync") == 0 ||
+      g_strcmp0 (sync_action, "recover") == 0 ||
+      g_strcmp0 (sync_action, "check") == 0 ||
+      g_strcmp0 (sync_action, "repair") == 0)
+    {
+      ensure_polling (mdraid, TRUE);
+    }
+  else
+    {
+      ensure_polling (mdraid, FALSE);
+    }
+}
+
 /**
  * udisks_linux_mdraid_update:
  * @mdraid: A #UDisksLinuxMDRaid.
@@ -297,14 +399,10 @@ udisks_linux_mdraid_update (UDisksLinuxMDRaid       *mdraid,
   gchar *bitmap_location = NULL;
   guint degraded = 0;
   guint64 chunk_size = 0;
-  gdouble sync_completed_val = 0.0;
-  guint64 sync_rate = 0;
-  guint64 sync_remaining_time = 0;
   GVariantBuilder builder;
   UDisksDaemon *daemon = NULL;
   gboolean has_redundancy = FALSE;
   gboolean has_stripes = FALSE;
-  UDisksBaseJob *job = NULL;
 
   daemon = udisks_linux_mdraid_object_get_daemon (object);
 
@@ -410,85 +508,10 @@ udisks_linux_mdraid_update (UDisksLinuxMDRaid       *mdraid,
         }
     }
   udisks_mdraid_set_degraded (iface, degraded);
-  udisks_mdraid_set_sync_action (iface, sync_action);
   udisks_mdraid_set_bitmap_location (iface, bitmap_location);
   udisks_mdraid_set_chunk_size (iface, chunk_size);
 
-  if (sync_completed != NULL && g_strcmp0 (sync_completed, "none") != 0)
-    {
-      guint64 completed_sectors = 0;
-      guint64 num_sectors = 1;
-      if (sscanf (sync_completed, "%" G_GUINT64_FORMAT " / %" G_GUINT64_FORMAT,
-                  &completed_sectors, &num_sectors) == 2)
-        {
-          if (num_sectors != 0)
-            sync_completed_val = ((gdouble) completed_sectors) / ((gdouble) num_sectors);
-        }
-
-      /* this is KiB/s (see drivers/md/md.c:sync_speed_show() */
-      sync_rate = read_sysfs_attr_as_uint64 (raid_device->udev_device, "md/sync_speed") * 1024;
-      if (sync_rate > 0)
-        {
-          guint64 num_bytes_remaining = (num_sectors - completed_sectors) * 512ULL;
-          sync_remaining_time = ((guint64) G_USEC_PER_SEC) * num_bytes_remaining / sync_rate;
-        }
-    }
-
-  if (sync_action)
-    {
-      if (g_strcmp0 (sync_action, "idle") != 0)
-        {
-          if (! udisks_linux_mdraid_object_has_sync_job (object))
-            {
-              /* Launch a job */
-              job = udisks_daemon_launch_simple_job (daemon,
-                                                     UDISKS_OBJECT (object),
-                                                     sync_action_to_job_id (sync_action),
-                                                     0,
-                                                     NULL /* cancellable */);
-
-              /* Mark the job as not cancellable. It simply has to finish... */
-              udisks_job_set_cancelable (UDISKS_JOB (job), FALSE);
-              udisks_linux_mdraid_object_set_sync_job (object, job);
-            }
-          else
-            job = udisks_linux_mdraid_object_get_sync_job (object);
-
-          /* Update the job's interface */
-          udisks_job_set_progress (UDISKS_JOB (job), sync_completed_val);
-          udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
-          udisks_job_set_rate (UDISKS_JOB (job), sync_rate);
-
-          udisks_job_set_expected_end_time (UDISKS_JOB (job),
-                                            g_get_real_time () + sync_remaining_time);
-        }
-      else
-        {
-          if (udisks_linux_mdraid_object_has_sync_job (object))
-            {
-              /* Complete the job */
-              udisks_linux_mdraid_object_complete_sync_job (object,
-                                                            TRUE,
-                                                            "Finished");
-            }
-        }
-    }
-  udisks_mdraid_set_sync_completed (iface, sync_completed_val);
-  udisks_mdraid_set_sync_rate (iface, sync_rate);
-  udisks_mdraid_set_sync_remaining_time (iface, sync_remaining_time);
-
-  /* ensure we poll, exactly when we need to */
-  if (g_strcmp0 (sync_action, "resync") == 0 ||
-      g_strcmp0 (sync_action, "recover") == 0 ||
-      g_strcmp0 (sync_action, "check") == 0 ||
-      g_strcmp0 (sync_action, "repair") == 0)
-    {
-      ensure_polling (mdraid, TRUE);
-    }
-  else
-    {
-      ensure_polling (mdraid, FALSE);
-    }
+  update_sync_progress (mdraid, object, raid_device, sync_action, sync_completed);
 
   /* figure out active devices */
   g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(oiasta{sv})"));
@@ -612,6 +635,60 @@ udisks_linux_mdraid_update (UDisksLinuxMDRaid       *mdraid,
   return ret;
 }
 
+/**
+ * udisks_linux_mdraid_update_sync_progress:
+ * @mdraid: A #UDisksLinuxMDRaid.
+ * @object: The enclosing #UDisksLinuxMDRaidObject instance.
+ *
+ * Updates only the sync related properties (and the sync job) by
+ * reading the <literal>md/sync_action</literal>,
+ * <literal>md/sync_completed</literal> and
+ * <literal>md/sync_speed</literal> sysfs attributes.
+ *
+ * This is cheap compared to udisks_linux_mdraid_update() and meant
+ * for tracking the progress of a running sync operation - everything
+ * else only changes on real uevents.
+ */
+void
+udisks_linux_mdraid_update_sync_progress (UDisksLinuxMDRaid       *mdraid,
+                                          UDisksLinuxMDRaidObject *object)
+{
+  UDisksLinuxDevice *raid_device = NULL;
+  const gchar *level;
+  gchar *sync_action = NULL;
+  gchar *sync_completed = NULL;
+
+  /* only the redundant levels have sync_action/sync_completed, see
+   * udisks_linux_mdraid_update()
+   */
+  level = udisks_mdraid_get_level (UDISKS_MDRAID (mdraid));
+  if (!(g_strcmp0 (level, "raid1") == 0 ||
+        g_strcmp0 (level, "raid4") == 0 ||
+        g_strcmp0 (level, "raid5") == 0 ||
+        g_strcmp0 (level, "raid6") == 0 ||
+        g_strcmp0 (level, "raid10") == 0))
+    goto out;
+
+  raid_device = udisks_linux_mdraid_object_get_device (object);
+  if (raid_device == NULL)
+    goto out;
+
+  /* Can't use GUdevDevice methods as they cache the result and these variables vary */
+  sync_action = read_sysfs_attr (raid_device->udev_device, "md/sync_action");
+  if (sync_action != NULL)
+    g_strstrip (sync_action);
+  sync_completed = read_sysfs_attr (raid_device->udev_device, "md/sync_completed");
+  if (sync_completed != NULL)
+    g_strstrip (sync_completed);
+
+  update_sync_progress (mdraid, object, raid_device, sync_action, sync_completed);
+
+ out:
+  g_free (sync_completed);
+  g_free (sync_action);
+  g_clear_object (&raid_device);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 static UDisksObject *
@@ -653,6 +730,7 @@ handle_start (UDisksMDRaid           *_mdraid,
               GVariant               *options)
 {
   UDisksLinuxMDRaid *mdraid = UDISKS_LINUX_MDRAID (_mdraid);
+  GCancellable *cancellable;
   UDisksDaemon *daemon;
   UDisksState *state;
   UDisksLinuxMDRaidObject *object;
@@ -752,12 +830,15 @@ handle_start (UDisksMDRaid           *_mdraid,
     }
 
   /* ... then, sit and wait for MD block device to show up */
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   block_object = udisks_daemon_wait_for_object_sync (daemon,
                                                      wait_for_md_block_object,
                                                      object,
                                                      NULL,
                                                      10, /* timeout_seconds */
+                                                     cancellable,
                                                      &error);
+  g_object_unref (cancellable);
   if (block_object == NULL)
     {
       g_prefix_error (&error,
@@ -72,6 +72,12 @@ struct _UDisksLinuxMDRaidObject
   /* watches for sysfs attr changes */
   GSource *sync_action_source;
   GSource *degraded_source;
+  GSource *sync_completed_source;
+
+  /* sync progress updates triggered by md/sync_completed, see sync_completed_changed() */
+  gint64 last_sync_notification;
+  gint64 last_sync_progress_update;
+  guint sync_progress_timeout;
 
   /* sync job */
   UDisksBaseJob *sync_job;
@@ -91,6 +97,11 @@ enum
   PROP_SYNC_JOB,
 };
 
+/* md/sync_completed may change a lot faster than anyone cares about,
+ * the sync progress is updated at most this often
+ */
+#define SYNC_PROGRESS_MIN_INTERVAL_MSEC 1000
+
 static void
 remove_watches (UDisksLinuxMDRaidObject *object)
 {
@@ -104,6 +115,16 @@ remove_watches (UDisksLinuxMDRaidObject *object)
       g_source_destroy (object->degraded_source);
       object->degraded_source = NULL;
     }
+  if (object->sync_completed_source != NULL)
+    {
+      g_source_destroy (object->sync_completed_source);
+      object->sync_completed_source = NULL;
+    }
+  if (object->sync_progress_timeout != 0)
+    {
+      g_source_remove (object->sync_progress_timeout);
+      object->sync_progress_timeout = 0;
+    }
 }
 
 G_DEFINE_TYPE (UDisksLinuxMDRaidObject, udisks_linux_mdraid_object, UDISKS_TYPE_OBJECT_SKELETON);
@@ -493,27 +514,21 @@ watch_attr (UDisksLinuxDevice *device,
 
 /* ----------------------------------------------------------------------------------------------------  */
 
+/* re-reads the attribute, which is needed to get notified of the next change */
 static gboolean
-attr_changed (GIOChannel   *channel,
-              GIOCondition  cond,
-              gpointer      user_data)
+reread_attr (UDisksLinuxMDRaidObject *object,
+             GIOChannel              *channel)
 {
-  UDisksLinuxMDRaidObject *object = UDISKS_LINUX_MDRAID_OBJECT (user_data);
-  gboolean bail = FALSE;
   GError *error = NULL;
   gchar *str = NULL;
   gsize len = 0;
 
-  if (cond & ~G_IO_ERR)
-    goto out;
-
   if (g_io_channel_seek_position (channel, 0, G_SEEK_SET, &error) != G_IO_STATUS_NORMAL)
     {
       udisks_debug ("Error seeking in channel (uuid %s): %s (%s, %d)",
                     object->uuid, error->message, g_quark_to_string (error->domain), error->code);
       g_clear_error (&error);
-      bail = TRUE;
-      goto out;
+      return FALSE;
     }
 
   if (g_io_channel_read_to_end (channel, &str, &len, &error) != G_IO_STATUS_NORMAL)
@@ -521,19 +536,90 @@ attr_changed (GIOChannel   *channel,
       udisks_debug ("Error reading (uuid %s): %s (%s, %d)",
                     object->uuid, error->message, g_quark_to_string (error->domain), error->code);
       g_clear_error (&error);
-      bail = TRUE;
-      goto out;
+      return FALSE;
     }
 
   g_free (str);
+  return TRUE;
+}
+
+static gboolean
+attr_changed (GIOChannel   *channel,
+              GIOCondition  cond,
+              gpointer      user_data)
+{
+  UDisksLinuxMDRaidObject *object = UDISKS_LINUX_MDRAID_OBJECT (user_data);
+
+  if (cond & ~G_IO_ERR)
+    goto out;
+
+  if (!reread_attr (object, channel))
+    {
+      remove_watches (object);
+      goto out;
+    }
 
   /* synthesize uevent */
   if (object->raid_device != NULL)
     udisks_linux_mdraid_object_uevent (object, "change", object->raid_device, FALSE);
 
  out:
-  if (bail)
-    remove_watches (object);
+  return TRUE; /* keep event source around */
+}
+
+static void
+update_sync_progress (UDisksLinuxMDRaidObject *object)
+{
+  object->last_sync_progress_update = g_get_monotonic_time ();
+
+  /* only the sync properties can have changed - no need for a full update */
+  if (object->iface_mdraid != NULL)
+    udisks_linux_mdraid_update_sync_progress (UDISKS_LINUX_MDRAID (object->iface_mdraid), object);
+}
+
+static gboolean
+on_sync_progress_timeout (gpointer user_data)
+{
+  UDisksLinuxMDRaidObject *object = UDISKS_LINUX_MDRAID_OBJECT (user_data);
+
+  object->sync_progress_timeout = 0;
+  update_sync_progress (object);
+
+  return FALSE; /* remove source */
+}
+
+static gboolean
+sync_completed_changed (GIOChannel   *channel,
+                        GIOCondition  cond,
+                        gpointer      user_data)
+{
+  UDisksLinuxMDRaidObject *object = UDISKS_LINUX_MDRAID_OBJECT (user_data);
+  gint64 msec_since_update;
+
+  if (cond & ~G_IO_ERR)
+    goto out;
+
+  if (!reread_attr (object, channel))
+    {
+      remove_watches (object);
+      goto out;
+    }
+
+  object->last_sync_notification = g_get_monotonic_time ();
+
+  /* throttle updates - if one is already pending, it will pick up this change */
+  if (object->sync_progress_timeout != 0)
+    goto out;
+
+  msec_since_update = (object->last_sync_notification - object->last_sync_progress_update) / 1000;
+  if (msec_since_update >= SYNC_PROGRESS_MIN_INTERVAL_MSEC)
+    update_sync_progress (object);
+  else
+    object->sync_progress_timeout = g_timeout_add (SYNC_PROGRESS_MIN_INTERVAL_MSEC - msec_since_update,
+                                                   on_sync_progress_timeout,
+                                                   object);
+
+ out:
   return TRUE; /* keep event source around */
 }
 
@@ -554,6 +640,7 @@ raid_device_added (UDisksLinuxMDRaidObject *object,
 {
   g_assert (object->sync_action_source == NULL);
   g_assert (object->degraded_source == NULL);
+  g_assert (object->sync_completed_source == NULL);
 
   /* udisks_debug ("start watching %s", g_udev_device_get_sysfs_path (device->udev_device)); */
   object->sync_action_source = watch_attr (device,
@@ -564,6 +651,11 @@ raid_device_added (UDisksLinuxMDRaidObject *object,
                                         "md/degraded",
                                         (GSourceFunc) attr_changed,
                                         object);
+  /* the kernel notifies this one periodically while syncing */
+  object->sync_completed_source = watch_attr (device,
+                                              "md/sync_completed",
+                                              (GSourceFunc) sync_completed_changed,
+                                              object);
 }
 
 static void
@@ -805,4 +897,21 @@ udisks_linux_mdraid_object_get_uuid (UDisksLinuxMDRaidObject *object)
   return object->uuid;
 }
 
-
+/**
+ * udisks_linux_mdraid_object_get_last_sync_notification:
+ * @object: A #UDisksLinuxMDRaidObject.
+ *
+ * Gets the time the kernel last notified about a change to the
+ * <literal>md/sync_completed</literal> sysfs attribute of the RAID
+ * device. This can be used for deciding whether the sync progress
+ * needs to be polled.
+ *
+ * Returns: A monotonic time (see g_get_monotonic_time()) or 0 if
+ *   no notification has been received.
+ */
+gint64
+udisks_linux_mdraid_object_get_last_sync_notification (UDisksLinuxMDRaidObject *object)
+{
+  g_return_val_if_fail (UDISKS_IS_LINUX_MDRAID_OBJECT (object), 0);
+  return object->last_sync_notification;
+}
@@ -51,6 +51,7 @@ gboolean                   udisks_linux_mdraid_object_complete_sync_job (UDisksL
                                                                          gboolean                 success,
                                                                          const gchar             *message);
 gboolean                   udisks_linux_mdraid_object_has_sync_job      (UDisksLinuxMDRaidObject *object);
+gint64                     udisks_linux_mdraid_object_get_last_sync_notification (UDisksLinuxMDRaidObject *object);
 
 G_END_DECLS
 
@@ -335,6 +335,7 @@ udisks_linux_partition_table_handle_create_partition (UDisksPartitionTable   *ta
                                                       GVariant               *options)
 {
   const gchar *action_id = NULL;
+  GCancellable *cancellable;
   const gchar *message = NULL;
   UDisksBlock *block = NULL;
   UDisksObject *object = NULL;
@@ -671,12 +672,15 @@ partition_table_created:
   g_warn_if_fail (wait_data->pos_to_wait_for > 0);
   wait_data->partition_table_object = object;
   error = NULL;
+  cancellable = udisks_daemon_util_new_caller_cancellable (invocation);
   partition_object = udisks_daemon_wait_for_object_sync (daemon,
                                                          wait_for_partition,
                                                          wait_data,
                                                          NULL,
                                                          30,
+                                                         cancellable,
                                                          &error);
+  g_object_unref (cancellable);
   if (partition_object == NULL)
     {
       g_prefix_error (&error, "Error waiting for partition to appear: ");
@@ -25,15 +25,24 @@
 
 #include "udiskslogging.h"
 #include "udisksdaemon.h"
+#include "udisksdaemonutil.h"
 #include "udisksprovider.h"
 #include "udiskslinuxprovider.h"
 #include "udiskslinuxblockobject.h"
 #include "udiskslinuxdriveobject.h"
 #include "udiskslinuxmdraidobject.h"
 #include "udiskslinuxmanager.h"
+#include "udiskslinuxmanagermetrics.h"
 #include "udisksstate.h"
 #include "udiskslinuxdevice.h"
 #include "udisksmodulemanager.h"
+#include "udisksconfigmanager.h"
+#include "udisksmetrics.h"
+#include "udiskstrace.h"
+#include "udisksmountmonitor.h"
+#include "udisksmount.h"
+#include "udisksfstabentry.h"
+#include "udiskscrypttabentry.h"
 
 #include <modules/udisksmoduleifacetypes.h>
 #include <modules/udisksmoduleobject.h>
@@ -61,26 +70,57 @@ struct _UDisksLinuxProvider
   UDisksProvider parent_instance;
 
   GUdevClient *gudev_client;
+
+  /* queue of ProbeChain instances waiting for a probing thread */
   GAsyncQueue *probe_request_queue;
-  GThread *probe_request_thread;
+  GPtrArray *probe_request_threads;
+
+  /* protects probe_chains - maps from ordering key to ProbeChain instances -
+   * as well as probed_requests and probed_idle_source
+   */
+  GMutex probe_lock;
+  GHashTable *probe_chains;
+
+  /* probed requests waiting to be dispatched in the main thread */
+  GQueue probed_requests;
+  guint probed_idle_source;
+  /* when probed_idle_source was added, for the main-loop-lag metric */
+  gint64 probed_idle_added_at;
+
+  /* number of uevents received but not yet probed, accessed atomically */
+  gint probe_queue_depth;
 
   UDisksObjectSkeleton *manager_object;
 
-  /* maps from sysfs path to UDisksLinuxBlockObject objects */
+  /* The object tables below are only modified by uevent processing in
+   * the main thread, which therefore reads them without locking. Each
+   * table that is also read from other threads has its own lock, which
+   * the main thread takes for writing only around the modification
+   * itself and other threads take for reading only to copy what they
+   * need - so housekeeping never holds up uevent processing.
+   */
+
+  /* maps from sysfs path to UDisksLinuxBlockObject objects, only used in the main thread */
   GHashTable *sysfs_to_block;
 
-  /* maps from VPD (serial, wwn) and sysfs_path to UDisksLinuxDriveObject instances */
+  /* maps from VPD (serial, wwn) and sysfs_path to UDisksLinuxDriveObject instances,
+   * protected by drives_lock */
   GHashTable *vpd_to_drive;
   GHashTable *sysfs_path_to_drive;
+  GRWLock drives_lock;
 
-  /* maps from array UUID and sysfs_path to UDisksLinuxMDRaidObject instances */
+  /* maps from array UUID and sysfs_path to UDisksLinuxMDRaidObject instances,
+   * only accessed from the main thread */
   GHashTable *uuid_to_mdraid;
   GHashTable *sysfs_path_to_mdraid;
   GHashTable *sysfs_path_to_mdraid_members;
 
   /* maps from UDisksModuleObjectNewFuncs to nested hashtables containing object
-   * skeleton instances as keys and GLists of consumed sysfs path as values */
+   * skeleton instances as keys and GLists of consumed sysfs path as values,
+   * protected by modules_lock (except for the sysfs paths, which are only
+   * accessed from the main thread) */
   GHashTable *module_funcs_to_instances;
+  GRWLock modules_lock;
 
   GFileMonitor *etc_udisks2_dir_monitor;
 
@@ -91,11 +131,23 @@ struct _UDisksLinuxProvider
   gboolean coldplug;
 
   guint housekeeping_timeout;
-  guint64 housekeeping_last;
-  gboolean housekeeping_running;
+  guint64 housekeeping_modules_last;
+  /* accessed atomically */
+  gint housekeeping_running;
+
+  /* protects the HousekeepingRequest instances of the current pass and
+   * housekeeping_schedules - maps from UDisksLinuxDriveObject to
+   * HousekeepingSchedule instances
+   */
+  GMutex housekeeping_lock;
+  GCond housekeeping_cond;
+  GHashTable *housekeeping_schedules;
+  /* number of times housekeeping for a drive timed out, protected by housekeeping_lock */
+  guint64 housekeeping_num_timed_out;
 };
 
-G_LOCK_DEFINE_STATIC (provider_lock);
+/* How often to check for drives due for housekeeping, see on_housekeeping_timeout() */
+#define HOUSEKEEPING_TICK_SECONDS 30
 
 struct _UDisksLinuxProviderClass
 {
@@ -106,7 +158,12 @@ static void udisks_linux_provider_handle_uevent (UDisksLinuxProvider *provider,
                                                  const gchar         *action,
                                                  UDisksLinuxDevice   *device);
 
+static void probe_request_free (gpointer data);
+
 static gboolean on_housekeeping_timeout (gpointer user_data);
+static void housekeeping_schedule_free (gpointer data);
+static void schedule_initial_housekeeping_for_drive (UDisksLinuxProvider    *provider,
+                                                     UDisksLinuxDriveObject *object);
 
 static void fstab_monitor_on_entry_added (UDisksFstabMonitor *monitor,
                                           UDisksFstabEntry   *entry,
@@ -124,6 +181,10 @@ static void crypttab_monitor_on_entry_removed (UDisksCrypttabMonitor *monitor,
                                                UDisksCrypttabEntry   *entry,
                                                gpointer               user_data);
 
+static void mount_monitor_on_mount_changed (UDisksMountMonitor *monitor,
+                                            UDisksMount        *mount,
+                                            gpointer            user_data);
+
 static void on_etc_udisks2_dir_monitor_changed (GFileMonitor     *monitor,
                                                 GFile            *file,
                                                 GFile            *other_file,
@@ -139,12 +200,28 @@ udisks_linux_provider_finalize (GObject *object)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (object);
   UDisksDaemon *daemon;
+  guint n;
 
-  /* stop the request thread and wait for it */
-  g_async_queue_push (provider->probe_request_queue, (gpointer) 0xdeadbeef);
-  g_thread_join (provider->probe_request_thread);
-  g_thread_unref (provider->probe_request_thread);
+  /* stop the request threads and wait for them */
+  if (provider->probe_request_threads != NULL)
+    {
+      for (n = 0; n < provider->probe_request_threads->len; n++)
+        g_async_queue_push (provider->probe_request_queue, (gpointer) 0xdeadbeef);
+      for (n = 0; n < provider->probe_request_threads->len; n++)
+        g_thread_join (g_ptr_array_index (provider->probe_request_threads, n));
+      g_ptr_array_unref (provider->probe_request_threads);
+    }
   g_async_queue_unref (provider->probe_request_queue);
+  g_hash_table_unref (provider->probe_chains);
+  if (provider->probed_idle_source != 0)
+    g_source_remove (provider->probed_idle_source);
+  g_queue_foreach (&provider->probed_requests, (GFunc) probe_request_free, NULL);
+  g_queue_clear (&provider->probed_requests);
+  g_mutex_clear (&provider->probe_lock);
+
+  g_hash_table_unref (provider->housekeeping_schedules);
+  g_mutex_clear (&provider->housekeeping_lock);
+  g_cond_clear (&provider->housekeeping_cond);
 
   daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
 
@@ -163,16 +240,22 @@ udisks_linux_provider_finalize (GObject *object)
   g_hash_table_unref (provider->sysfs_path_to_mdraid);
   g_hash_table_unref (provider->sysfs_path_to_mdraid_members);
   g_hash_table_unref (provider->module_funcs_to_instances);
+  g_rw_lock_clear (&provider->drives_lock);
+  g_rw_lock_clear (&provider->modules_lock);
   g_object_unref (provider->gudev_client);
 
   g_list_free (provider->module_ifaces);
 
   udisks_object_skeleton_set_manager (provider->manager_object, NULL);
+  udisks_object_skeleton_set_manager_metrics (provider->manager_object, NULL);
   g_object_unref (provider->manager_object);
 
   if (provider->housekeeping_timeout > 0)
     g_source_remove (provider->housekeeping_timeout);
 
+  g_signal_handlers_disconnect_by_func (udisks_daemon_get_mount_monitor (daemon),
+                                        G_CALLBACK (mount_monitor_on_mount_changed),
+                                        provider);
   g_signal_handlers_disconnect_by_func (udisks_daemon_get_fstab_monitor (daemon),
                                         G_CALLBACK (fstab_monitor_on_entry_added),
                                         provider);
@@ -197,28 +280,149 @@ typedef struct
   UDisksLinuxProvider *provider;
   GUdevDevice *udev_device;
   UDisksLinuxDevice *udisks_device;
+  /* when the uevent was received, see on_uevent() */
+  gint64 received_at;
 } ProbeRequest;
 
 static void
-probe_request_free (ProbeRequest *request)
+probe_request_free (gpointer data)
 {
+  ProbeRequest *request = data;
+
   g_clear_object (&request->provider);
   g_clear_object (&request->udev_device);
   g_clear_object (&request->udisks_device);
   g_slice_free (ProbeRequest, request);
 }
 
+/* A ProbeChain holds the pending requests for a single ordering key (see
+ * dup_probe_ordering_key()). A chain is owned by at most one probing thread
+ * at a time which guarantees that uevents for the same device are probed and
+ * handed over to the main thread in the order they were received, while
+ * uevents for unrelated devices are probed concurrently.
+ */
+typedef struct
+{
+  gchar *key;
+  GQueue requests;
+} ProbeChain;
+
+static void
+probe_chain_free (ProbeChain *chain)
+{
+  g_queue_foreach (&chain->requests, (GFunc) probe_request_free, NULL);
+  g_queue_clear (&chain->requests);
+  g_free (chain->key);
+  g_slice_free (ProbeChain, chain);
+}
+
+/* Partitions share the ordering key of the whole disk they belong to so that
+ * e.g. a "remove" of the disk never overtakes a "change" of one of its
+ * partitions.
+ */
+static gchar *
+dup_probe_ordering_key (GUdevDevice *device)
+{
+  const gchar *sysfs_path;
+
+  sysfs_path = g_udev_device_get_sysfs_path (device);
+  if (g_strcmp0 (g_udev_device_get_devtype (device), "partition") == 0)
+    return g_path_get_dirname (sysfs_path);
+
+  return g_strdup (sysfs_path);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* called in main thread with a processed ProbeRequest struct - see probe_request_thread_func() */
+/* Drops "change" uevents that are superseded by a newer "change" uevent for
+ * the same device in @requests. Since a "change" uevent makes us re-read
+ * everything about the device, only the newest one carries any
+ * information. Any other action (such as "add" or "remove") acts as a
+ * barrier, i.e. "change" uevents are never moved across it.
+ */
+static void
+coalesce_probed_requests (GQueue *requests)
+{
+  GHashTable *newer_change;
+  GList *l, *prev;
+  guint num_dropped = 0;
+
+  newer_change = g_hash_table_new (g_str_hash, g_str_equal);
+  for (l = requests->tail; l != NULL; l = prev)
+    {
+      ProbeRequest *request = l->data;
+      const gchar *sysfs_path = g_udev_device_get_sysfs_path (request->udev_device);
+
+      prev = l->prev;
+      if (g_strcmp0 (g_udev_device_get_action (request->udev_device), "change") == 0)
+        {
+          if (g_hash_table_contains (newer_change, sysfs_path))
+            {
+              g_queue_delete_link (requests, l);
+              probe_request_free (request);
+              num_dropped++;
+            }
+          else
+            {
+              g_hash_table_add (newer_change, (gpointer) sysfs_path);
+            }
+        }
+      else
+        {
+          g_hash_table_remove (newer_change, sysfs_path);
+        }
+    }
+  g_hash_table_unref (newer_change);
+
+  if (num_dropped > 0)
+    udisks_debug ("Coalesced %u superseded change uevents", num_dropped);
+}
+
+/* called in main thread with a batch of processed ProbeRequest structs - see probe_request_thread_func() */
 static gboolean
-on_idle_with_probed_uevent (gpointer user_data)
+on_idle_with_probed_uevents (gpointer user_data)
 {
-  ProbeRequest *request = user_data;
-  udisks_linux_provider_handle_uevent (request->provider,
-                                       g_udev_device_get_action (request->udev_device),
-                                       request->udisks_device);
-  probe_request_free (request);
+  UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
+  GQueue requests = G_QUEUE_INIT;
+  ProbeRequest *request;
+  UDisksState *state;
+  gint64 idle_added_at;
+
+  g_mutex_lock (&provider->probe_lock);
+  requests = provider->probed_requests;
+  g_queue_init (&provider->probed_requests);
+  provider->probed_idle_source = 0;
+  idle_added_at = provider->probed_idle_added_at;
+  g_mutex_unlock (&provider->probe_lock);
+
+  udisks_metrics_add_since (udisks_daemon_get_metrics (udisks_provider_get_daemon (UDISKS_PROVIDER (provider))),
+                            "main-loop-lag",
+                            idle_added_at);
+
+  coalesce_probed_requests (&requests);
+
+  /* keep @provider alive - the requests hold the only references to it */
+  g_object_ref (provider);
+  state = udisks_daemon_get_state (udisks_provider_get_daemon (UDISKS_PROVIDER (provider)));
+  while ((request = g_queue_pop_head (&requests)) != NULL)
+    {
+      const gchar *action = g_udev_device_get_action (request->udev_device);
+      dev_t dev = g_udev_device_get_device_number (request->udev_device);
+
+      udisks_linux_provider_handle_uevent (provider, action, request->udisks_device);
+
+      /* Possibly need to clean up - the requests are merged into a
+       * single pass over the entries referring to the devices
+       */
+      if (g_strcmp0 (action, "add") != 0 && dev != 0)
+        udisks_state_check_device (state, dev);
+      probe_request_free (request);
+    }
+
+  /* wake up anyone waiting for objects to appear, see udisks_daemon_wait_for_object_sync() */
+  udisks_provider_emit_changed (UDISKS_PROVIDER (provider));
+  g_object_unref (provider);
+
   return FALSE; /* remove source */
 }
 
@@ -228,23 +432,62 @@ gpointer
 probe_request_thread_func (gpointer user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
+  UDisksMetrics *metrics;
+  ProbeChain *chain;
   ProbeRequest *request;
 
+  metrics = udisks_daemon_get_metrics (udisks_provider_get_daemon (UDISKS_PROVIDER (provider)));
+
   do
     {
-      request = g_async_queue_pop (provider->probe_request_queue);
+      chain = g_async_queue_pop (provider->probe_request_queue);
 
       /* used by _finalize() above to stop this thread - if received, we can
        * no longer use @provider
        */
-      if (request == (gpointer) 0xdeadbeef)
+      if (chain == (gpointer) 0xdeadbeef)
         goto out;
 
-      /* probe the device - this may take a while */
-      request->udisks_device = udisks_linux_device_new_sync (request->udev_device);
+      g_mutex_lock (&provider->probe_lock);
+      request = g_queue_peek_head (&chain->requests);
+      g_mutex_unlock (&provider->probe_lock);
+
+      while (request != NULL)
+        {
+          gint64 probe_start;
+
+          /* probe the device - this may take a while */
+          probe_start = g_get_monotonic_time ();
+          udisks_metrics_add_duration (metrics, "uevent-probe-wait", probe_start - request->received_at);
+          request->udisks_device = udisks_linux_device_new_sync (request->udev_device);
+          udisks_metrics_add_since (metrics, "uevent-probe", probe_start);
+          g_atomic_int_add (&provider->probe_queue_depth, -1);
+
+          g_mutex_lock (&provider->probe_lock);
+          g_queue_pop_head (&chain->requests);
+
+          /* now that we've probed the device, post the request back to the
+           * main thread - this is done with the lock held so that a new chain
+           * for the same key can't overtake us. All requests probed before
+           * the main thread gets to run are dispatched as a single batch.
+           */
+          g_queue_push_tail (&provider->probed_requests, request);
+          if (provider->probed_idle_source == 0)
+            {
+              provider->probed_idle_source = g_idle_add (on_idle_with_probed_uevents, provider);
+              provider->probed_idle_added_at = g_get_monotonic_time ();
+            }
+
+          request = g_queue_peek_head (&chain->requests);
+          if (request == NULL)
+            {
+              gboolean removed;
 
-      /* now that we've probed the device, post the request back to the main thread */
-      g_idle_add (on_idle_with_probed_uevent, request);
+              removed = g_hash_table_remove (provider->probe_chains, chain->key);
+              g_warn_if_fail (removed);
+            }
+          g_mutex_unlock (&provider->probe_lock);
+        }
     }
   while (TRUE);
 
@@ -252,6 +495,28 @@ probe_request_thread_func (gpointer user_data)
   return NULL;
 }
 
+static void
+start_probe_request_threads (UDisksLinuxProvider *provider)
+{
+  UDisksDaemon *daemon;
+  guint num_threads;
+  guint n;
+
+  daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
+  num_threads = udisks_config_manager_get_probe_workers (udisks_daemon_get_config_manager (daemon));
+
+  provider->probe_request_threads = g_ptr_array_new_with_free_func ((GDestroyNotify) g_thread_unref);
+  for (n = 0; n < num_threads; n++)
+    {
+      gchar *name = g_strdup_printf ("probing-thread-%u", n);
+      g_ptr_array_add (provider->probe_request_threads,
+                       g_thread_new (name, probe_request_thread_func, provider));
+      g_free (name);
+    }
+
+  udisks_debug ("Started %u probing threads", num_threads);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 static void
@@ -262,13 +527,42 @@ on_uevent (GUdevClient  *client,
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
   ProbeRequest *request;
+  ProbeChain *chain;
+  gchar *key;
+  gint depth;
 
   request = g_slice_new0 (ProbeRequest);
   request->provider = g_object_ref (provider);
   request->udev_device = g_object_ref (device);
+  request->received_at = g_get_monotonic_time ();
+  UDISKS_TRACE2 (uevent_received, action, g_udev_device_get_sysfs_path (device));
+
+  key = dup_probe_ordering_key (device);
 
-  /* process uevent in "probing-thread" */
-  g_async_queue_push (provider->probe_request_queue, request);
+  g_mutex_lock (&provider->probe_lock);
+  depth = g_atomic_int_add (&provider->probe_queue_depth, 1) + 1;
+  chain = g_hash_table_lookup (provider->probe_chains, key);
+  if (chain != NULL)
+    {
+      /* a probing thread already owns the chain and will pick the request up */
+      g_queue_push_tail (&chain->requests, request);
+      g_free (key);
+    }
+  else
+    {
+      chain = g_slice_new0 (ProbeChain);
+      chain->key = key;
+      g_queue_init (&chain->requests);
+      g_queue_push_tail (&chain->requests, request);
+      g_hash_table_insert (provider->probe_chains, chain->key, chain);
+
+      /* process uevent in one of the "probing-thread"s */
+      g_async_queue_push (provider->probe_request_queue, chain);
+    }
+  g_mutex_unlock (&provider->probe_lock);
+
+  udisks_debug ("queued uevent %s %s (%d uevents waiting to be probed)",
+                action, g_udev_device_get_sysfs_path (device), depth);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -289,9 +583,22 @@ udisks_linux_provider_init (UDisksLinuxProvider *provider)
                     provider);
 
   provider->probe_request_queue = g_async_queue_new ();
-  provider->probe_request_thread = g_thread_new ("probing-thread",
-                                                 probe_request_thread_func,
-                                                 provider);
+  g_mutex_init (&provider->probe_lock);
+  provider->probe_chains = g_hash_table_new_full (g_str_hash,
+                                                  g_str_equal,
+                                                  NULL,
+                                                  (GDestroyNotify) probe_chain_free);
+  g_queue_init (&provider->probed_requests);
+
+  g_rw_lock_init (&provider->drives_lock);
+  g_rw_lock_init (&provider->modules_lock);
+
+  g_mutex_init (&provider->housekeeping_lock);
+  g_cond_init (&provider->housekeeping_cond);
+  provider->housekeeping_schedules = g_hash_table_new_full (g_direct_hash,
+                                                            g_direct_equal,
+                                                            g_object_unref,
+                                                            (GDestroyNotify) housekeeping_schedule_free);
 
   file = g_file_new_for_path (PACKAGE_SYSCONF_DIR "/udisks2");
   provider->etc_udisks2_dir_monitor = g_file_monitor_directory (file,
@@ -410,43 +717,194 @@ udev_device_name_cmp (GUdevDevice *a,
   return device_name_cmp (g_udev_device_get_name (a), g_udev_device_get_name (b));
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* A node in the dependency graph used for coldplugging - see get_udisks_devices() */
+typedef struct
+{
+  GUdevDevice *udev_device;
+  UDisksLinuxDevice *udisks_device;
+  GPtrArray *deps;
+  gboolean visited;
+} ColdplugNode;
+
+static void
+coldplug_node_free (ColdplugNode *node)
+{
+  g_clear_object (&node->udev_device);
+  g_clear_object (&node->udisks_device);
+  g_ptr_array_unref (node->deps);
+  g_slice_free (ColdplugNode, node);
+}
+
+/* runs in a thread from the coldplug thread pool */
+static void
+coldplug_probe_func (gpointer data,
+                     gpointer user_data)
+{
+  ColdplugNode *node = data;
+
+  node->udisks_device = udisks_linux_device_new_sync (node->udev_device);
+}
+
+/* Adds the devices @node depends on, i.e. the whole disk for a partition
+ * and the devices listed in the "slaves" directory (e.g. the members of a
+ * MD-RAID array or the backing device of a dm-crypt device)
+ */
+static void
+coldplug_node_add_deps (ColdplugNode *node,
+                        GHashTable   *name_to_node)
+{
+  const gchar *sysfs_path;
+  gchar *slaves_path;
+  ColdplugNode *dep;
+  GDir *dir;
+
+  sysfs_path = g_udev_device_get_sysfs_path (node->udev_device);
+
+  if (g_strcmp0 (g_udev_device_get_devtype (node->udev_device), "partition") == 0)
+    {
+      gchar *disk_path = g_path_get_dirname (sysfs_path);
+      gchar *disk_name = g_path_get_basename (disk_path);
+
+      dep = g_hash_table_lookup (name_to_node, disk_name);
+      if (dep != NULL && dep != node)
+        g_ptr_array_add (node->deps, dep);
+      g_free (disk_name);
+      g_free (disk_path);
+    }
+
+  slaves_path = g_build_filename (sysfs_path, "slaves", NULL);
+  dir = g_dir_open (slaves_path, 0, NULL);
+  if (dir != NULL)
+    {
+      const gchar *name;
+
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          dep = g_hash_table_lookup (name_to_node, name);
+          if (dep != NULL && dep != node)
+            g_ptr_array_add (node->deps, dep);
+        }
+      g_dir_close (dir);
+    }
+  g_free (slaves_path);
+}
+
+/* depth-first post-order traversal, dependencies end up before their holders */
+static void
+coldplug_node_visit (ColdplugNode  *node,
+                     GList        **ordered)
+{
+  guint n;
+
+  /* also breaks (bogus) dependency cycles */
+  if (node->visited)
+    return;
+  node->visited = TRUE;
+
+  for (n = 0; n < node->deps->len; n++)
+    coldplug_node_visit (g_ptr_array_index (node->deps, n), ordered);
+
+  *ordered = g_list_prepend (*ordered, g_object_ref (node->udisks_device));
+}
+
+/* Returns a list of probed UDisksLinuxDevice instances for all block
+ * devices, sorted such that a device always comes after the devices it
+ * depends on (partitions after the whole disk, holders after their slaves).
+ * Apart from that, the order is sda, sdz, sdaa, ...
+ *
+ * Probing (which may block on I/O) is done in parallel.
+ */
 static GList *
 get_udisks_devices (UDisksLinuxProvider *provider)
 {
+  UDisksDaemon *daemon;
   GList *devices;
   GList *udisks_devices;
   GList *l;
+  GPtrArray *nodes;
+  GHashTable *name_to_node;
+  GThreadPool *pool;
+  gint64 time_start;
+  gint64 time_probed;
+  guint n;
+
+  daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
+  time_start = g_get_monotonic_time ();
 
   devices = g_udev_client_query_by_subsystem (provider->gudev_client, "block");
 
   /* make sure we process sda before sdz and sdz before sdaa */
   devices = g_list_sort (devices, (GCompareFunc) udev_device_name_cmp);
 
-  udisks_devices = NULL;
+  nodes = g_ptr_array_new_with_free_func ((GDestroyNotify) coldplug_node_free);
+  name_to_node = g_hash_table_new (g_str_hash, g_str_equal);
   for (l = devices; l != NULL; l = l->next)
     {
       GUdevDevice *device = G_UDEV_DEVICE (l->data);
+      ColdplugNode *node;
+
       if (!g_udev_device_get_is_initialized (device))
         continue;
-      udisks_devices = g_list_prepend (udisks_devices, udisks_linux_device_new_sync (device));
+
+      node = g_slice_new0 (ColdplugNode);
+      node->udev_device = g_object_ref (device);
+      node->deps = g_ptr_array_new ();
+      g_ptr_array_add (nodes, node);
+      g_hash_table_insert (name_to_node, (gpointer) g_udev_device_get_name (device), node);
     }
-  udisks_devices = g_list_reverse (udisks_devices);
   g_list_free_full (devices, g_object_unref);
 
+  /* probe all devices, g_thread_pool_free() waits for all of them */
+  pool = g_thread_pool_new (coldplug_probe_func,
+                            NULL,
+                            udisks_config_manager_get_probe_workers (udisks_daemon_get_config_manager (daemon)),
+                            TRUE,
+                            NULL);
+  for (n = 0; n < nodes->len; n++)
+    g_thread_pool_push (pool, g_ptr_array_index (nodes, n), NULL);
+  g_thread_pool_free (pool, FALSE, TRUE);
+  time_probed = g_get_monotonic_time ();
+
+  for (n = 0; n < nodes->len; n++)
+    coldplug_node_add_deps (g_ptr_array_index (nodes, n), name_to_node);
+
+  udisks_devices = NULL;
+  for (n = 0; n < nodes->len; n++)
+    coldplug_node_visit (g_ptr_array_index (nodes, n), &udisks_devices);
+  udisks_devices = g_list_reverse (udisks_devices);
+
+  udisks_info ("Probed %u devices in %.3f seconds, ordered dependencies in %.3f seconds",
+               nodes->len,
+               (time_probed - time_start) / ((gdouble) G_USEC_PER_SEC),
+               (g_get_monotonic_time () - time_probed) / ((gdouble) G_USEC_PER_SEC));
+
+  g_hash_table_unref (name_to_node);
+  g_ptr_array_unref (nodes);
+
   return udisks_devices;
 }
 
+/* @udisks_devices must be sorted such that dependencies come first - see get_udisks_devices() */
 static void
 do_coldplug (UDisksLinuxProvider *provider,
              GList               *udisks_devices)
 {
   GList *l;
+  gint64 time_start;
+
+  time_start = g_get_monotonic_time ();
 
   for (l = udisks_devices; l != NULL; l = l->next)
     {
       UDisksLinuxDevice *device = l->data;
       udisks_linux_provider_handle_uevent (provider, "add", device);
     }
+
+  udisks_info ("Processed %u devices in %.3f seconds",
+               g_list_length (udisks_devices),
+               (g_get_monotonic_time () - time_start) / ((gdouble) G_USEC_PER_SEC));
 }
 
 static void
@@ -588,9 +1046,9 @@ udisks_linux_provider_start (UDisksProvider *_provider)
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (_provider);
   UDisksDaemon *daemon;
   UDisksManager *manager;
+  UDisksManagerMetrics *manager_metrics;
   UDisksModuleManager *module_manager;
   GList *udisks_devices;
-  guint n;
   GDBusConnection *dbus_conn;
 
   provider->coldplug = TRUE;
@@ -629,10 +1087,15 @@ udisks_linux_provider_start (UDisksProvider *_provider)
 
   daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
 
+  start_probe_request_threads (provider);
+
   provider->manager_object = udisks_object_skeleton_new ("/org/freedesktop/UDisks2/Manager");
   manager = udisks_linux_manager_new (daemon);
   udisks_object_skeleton_set_manager (provider->manager_object, manager);
   g_object_unref (manager);
+  manager_metrics = udisks_linux_manager_metrics_new (daemon);
+  udisks_object_skeleton_set_manager_metrics (provider->manager_object, manager_metrics);
+  g_object_unref (manager_metrics);
 
   module_manager = udisks_daemon_get_module_manager (daemon);
   g_signal_connect_swapped (module_manager, "notify::modules-ready", G_CALLBACK (ensure_modules), provider);
@@ -641,21 +1104,33 @@ udisks_linux_provider_start (UDisksProvider *_provider)
   g_dbus_object_manager_server_export (udisks_daemon_get_object_manager (daemon),
                                        G_DBUS_OBJECT_SKELETON (provider->manager_object));
 
+  /* route mount changes to the affected block object only - connecting
+   * from every block object would make each change cost O(number of
+   * block devices)
+   */
+  g_signal_connect (udisks_daemon_get_mount_monitor (daemon),
+                    "mount-added",
+                    G_CALLBACK (mount_monitor_on_mount_changed),
+                    provider);
+  g_signal_connect (udisks_daemon_get_mount_monitor (daemon),
+                    "mount-removed",
+                    G_CALLBACK (mount_monitor_on_mount_changed),
+                    provider);
+
   /* probe for extra data we don't get from udev */
   udisks_info ("Initialization (device probing)");
   udisks_devices = get_udisks_devices (provider);
 
-  /* do two coldplug runs to handle dependencies between devices */
-  for (n = 0; n < 2; n++)
-    {
-      udisks_info ("Initialization (coldplug %u/2)", n + 1);
-      do_coldplug (provider, udisks_devices);
-    }
+  /* the devices are sorted such that a single coldplug run is enough to
+   * handle dependencies between devices
+   */
+  udisks_info ("Initialization (coldplug)");
+  do_coldplug (provider, udisks_devices);
   g_list_free_full (udisks_devices, g_object_unref);
   udisks_info ("Initialization complete");
 
-  /* schedule housekeeping for every 10 minutes */
-  provider->housekeeping_timeout = g_timeout_add_seconds (10*60,
+  /* check for drives due for housekeeping every now and then */
+  provider->housekeeping_timeout = g_timeout_add_seconds (HOUSEKEEPING_TICK_SECONDS,
                                                           on_housekeeping_timeout,
                                                           provider);
   /* ... and also do an initial run */
@@ -741,6 +1216,22 @@ udisks_linux_provider_get_udev_client (UDisksLinuxProvider *provider)
 }
 
 
+/**
+ * udisks_linux_provider_get_probe_queue_depth:
+ * @provider: A #UDisksLinuxProvider.
+ *
+ * Gets the number of uevents that have been received but not yet
+ * probed. This function is thread-safe.
+ *
+ * Returns: The number of uevents waiting to be probed.
+ */
+guint
+udisks_linux_provider_get_probe_queue_depth (UDisksLinuxProvider *provider)
+{
+  g_return_val_if_fail (UDISKS_IS_LINUX_PROVIDER (provider), 0);
+  return (guint) g_atomic_int_get (&provider->probe_queue_depth);
+}
+
 /**
  * udisks_linux_provider_get_coldplug:
  * @provider: A #UDisksLinuxProvider.
@@ -758,30 +1249,7 @@ udisks_linux_provider_get_coldplug (UDisksLinuxProvider *provider)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-static void
-perform_initial_housekeeping_for_drive (GTask           *task,
-                                        gpointer         source_object,
-                                        gpointer         task_data,
-                                        GCancellable    *cancellable)
-{
-  UDisksLinuxDriveObject *object = UDISKS_LINUX_DRIVE_OBJECT (task_data);
-  GError *error;
-
-  error = NULL;
-  if (!udisks_linux_drive_object_housekeeping (object, 0,
-                                               NULL, /* TODO: cancellable */
-                                               &error))
-    {
-      udisks_warning ("Error performing initial housekeeping for drive %s: %s (%s, %d)",
-                      g_dbus_object_get_object_path (G_DBUS_OBJECT (object)),
-                      error->message, g_quark_to_string (error->domain), error->code);
-      g_clear_error (&error);
-    }
-}
-
-/* ---------------------------------------------------------------------------------------------------- */
-
-/* called with lock held */
+/* called in the main thread */
 
 static void
 maybe_remove_mdraid_object (UDisksLinuxProvider     *provider,
@@ -797,6 +1265,7 @@ maybe_remove_mdraid_object (UDisksLinuxProvider     *provider,
   daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
 
   object_uuid = g_strdup (udisks_linux_mdraid_object_get_uuid (object));
+  udisks_daemon_unindex_object (daemon, UDISKS_OBJECT (object));
   g_dbus_object_manager_server_unexport (udisks_daemon_get_object_manager (daemon),
                                          g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
   g_warn_if_fail (g_hash_table_remove (provider->uuid_to_mdraid, object_uuid));
@@ -884,6 +1353,7 @@ handle_block_uevent_for_mdraid_with_uuid (UDisksLinuxProvider *provider,
           udisks_linux_mdraid_object_uevent (object, action, device, is_member);
           g_dbus_object_manager_server_export_uniquely (udisks_daemon_get_object_manager (daemon),
                                                         G_DBUS_OBJECT_SKELETON (object));
+          udisks_daemon_index_object (daemon, UDISKS_OBJECT (object));
           g_hash_table_insert (provider->uuid_to_mdraid, g_strdup (uuid), object);
           if (is_member)
             g_hash_table_insert (provider->sysfs_path_to_mdraid_members, g_strdup (sysfs_path), object);
@@ -931,7 +1401,7 @@ handle_block_uevent_for_mdraid (UDisksLinuxProvider *provider,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* called with lock held */
+/* called in the main thread */
 static void
 handle_block_uevent_for_drive (UDisksLinuxProvider *provider,
                                const gchar         *action,
@@ -939,7 +1409,6 @@ handle_block_uevent_for_drive (UDisksLinuxProvider *provider,
 {
   UDisksLinuxDriveObject *object;
   UDisksDaemon *daemon;
-  GTask *task;
   const gchar *sysfs_path;
   gchar *vpd;
 
@@ -956,16 +1425,25 @@ handle_block_uevent_for_drive (UDisksLinuxProvider *provider,
 
           udisks_linux_drive_object_uevent (object, action, device);
 
+          g_rw_lock_writer_lock (&provider->drives_lock);
           g_warn_if_fail (g_hash_table_remove (provider->sysfs_path_to_drive, sysfs_path));
+          g_rw_lock_writer_unlock (&provider->drives_lock);
 
           devices = udisks_linux_drive_object_get_devices (object);
           if (devices == NULL)
             {
               const gchar *existing_vpd;
               existing_vpd = g_object_get_data (G_OBJECT (object), "x-vpd");
+              udisks_daemon_unindex_object (daemon, UDISKS_OBJECT (object));
               g_dbus_object_manager_server_unexport (udisks_daemon_get_object_manager (daemon),
                                                      g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+              g_rw_lock_writer_lock (&provider->drives_lock);
               g_warn_if_fail (g_hash_table_remove (provider->vpd_to_drive, existing_vpd));
+              g_rw_lock_writer_unlock (&provider->drives_lock);
+            }
+          else
+            {
+              udisks_daemon_index_object (daemon, UDISKS_OBJECT (object));
             }
           g_list_foreach (devices, (GFunc) g_object_unref, NULL);
           g_list_free (devices);
@@ -986,8 +1464,13 @@ handle_block_uevent_for_drive (UDisksLinuxProvider *provider,
       if (object != NULL)
         {
           if (g_hash_table_lookup (provider->sysfs_path_to_drive, sysfs_path) == NULL)
-            g_hash_table_insert (provider->sysfs_path_to_drive, g_strdup (sysfs_path), object);
+            {
+              g_rw_lock_writer_lock (&provider->drives_lock);
+              g_hash_table_insert (provider->sysfs_path_to_drive, g_strdup (sysfs_path), object);
+              g_rw_lock_writer_unlock (&provider->drives_lock);
+            }
           udisks_linux_drive_object_uevent (object, action, device);
+          udisks_daemon_index_object (daemon, UDISKS_OBJECT (object));
         }
       else
         {
@@ -999,17 +1482,15 @@ handle_block_uevent_for_drive (UDisksLinuxProvider *provider,
                   g_object_set_data_full (G_OBJECT (object), "x-vpd", g_strdup (vpd), g_free);
                   g_dbus_object_manager_server_export_uniquely (udisks_daemon_get_object_manager (daemon),
                                                                 G_DBUS_OBJECT_SKELETON (object));
+                  udisks_daemon_index_object (daemon, UDISKS_OBJECT (object));
+                  g_rw_lock_writer_lock (&provider->drives_lock);
                   g_hash_table_insert (provider->vpd_to_drive, g_strdup (vpd), object);
                   g_hash_table_insert (provider->sysfs_path_to_drive, g_strdup (sysfs_path), object);
+                  g_rw_lock_writer_unlock (&provider->drives_lock);
 
                   /* schedule initial housekeeping for the drive unless coldplugging */
                   if (!provider->coldplug)
-                    {
-                      task = g_task_new (NULL, NULL, NULL, NULL);
-                      g_task_set_task_data (task, g_object_ref (object), NULL);
-                      g_task_run_in_thread (task, perform_initial_housekeeping_for_drive);
-                      g_object_unref (task);
-                    }
+                    schedule_initial_housekeeping_for_drive (provider, object);
                 }
             }
         }
@@ -1021,7 +1502,7 @@ handle_block_uevent_for_drive (UDisksLinuxProvider *provider,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* called with lock held */
+/* called in the main thread */
 static void
 handle_block_uevent_for_block (UDisksLinuxProvider *provider,
                                const gchar         *action,
@@ -1039,6 +1520,7 @@ handle_block_uevent_for_block (UDisksLinuxProvider *provider,
       object = g_hash_table_lookup (provider->sysfs_to_block, sysfs_path);
       if (object != NULL)
         {
+          udisks_daemon_unindex_object (daemon, UDISKS_OBJECT (object));
           g_dbus_object_manager_server_unexport (udisks_daemon_get_object_manager (daemon),
                                                  g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
           g_warn_if_fail (g_hash_table_remove (provider->sysfs_to_block, sysfs_path));
@@ -1050,12 +1532,14 @@ handle_block_uevent_for_block (UDisksLinuxProvider *provider,
       if (object != NULL)
         {
           udisks_linux_block_object_uevent (object, action, device);
+          udisks_daemon_index_object (daemon, UDISKS_OBJECT (object));
         }
       else
         {
           object = udisks_linux_block_object_new (daemon, device);
           g_dbus_object_manager_server_export_uniquely (udisks_daemon_get_object_manager (daemon),
                                                         G_DBUS_OBJECT_SKELETON (object));
+          udisks_daemon_index_object (daemon, UDISKS_OBJECT (object));
           g_hash_table_insert (provider->sysfs_to_block, g_strdup (sysfs_path), object);
         }
     }
@@ -1063,7 +1547,7 @@ handle_block_uevent_for_block (UDisksLinuxProvider *provider,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* called with lock held */
+/* called in the main thread */
 static void
 handle_block_uevent_for_modules (UDisksLinuxProvider *provider,
                                  const gchar         *action,
@@ -1162,7 +1646,9 @@ handle_block_uevent_for_modules (UDisksLinuxProvider *provider,
                   object = ll->data;
                   g_dbus_object_manager_server_unexport (udisks_daemon_get_object_manager (daemon),
                                                          g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+                  g_rw_lock_writer_lock (&provider->modules_lock);
                   g_warn_if_fail (g_hash_table_remove (inst_table, object));
+                  g_rw_lock_writer_unlock (&provider->modules_lock);
                 }
               if (g_hash_table_size (inst_table) == 0)
                 {
@@ -1187,6 +1673,7 @@ handle_block_uevent_for_modules (UDisksLinuxProvider *provider,
                                                         (GDestroyNotify) g_free,
                                                         NULL);
               g_hash_table_add (inst_sysfs_paths, g_strdup (sysfs_path));
+              g_rw_lock_writer_lock (&provider->modules_lock);
               if (inst_table == NULL)
                 {
                   inst_table = g_hash_table_new_full (g_direct_hash,
@@ -1196,6 +1683,7 @@ handle_block_uevent_for_modules (UDisksLinuxProvider *provider,
                   g_hash_table_insert (provider->module_funcs_to_instances, module_object_new_func, inst_table);
                 }
               g_hash_table_insert (inst_table, object, inst_sysfs_paths);
+              g_rw_lock_writer_unlock (&provider->modules_lock);
             }
         }
     }
@@ -1203,15 +1691,38 @@ handle_block_uevent_for_modules (UDisksLinuxProvider *provider,
   /* Remove empty funcs */
   if (funcs_to_remove != NULL)
     {
+      g_rw_lock_writer_lock (&provider->modules_lock);
       for (ll = funcs_to_remove; ll; ll = ll->next)
         g_warn_if_fail (g_hash_table_remove (provider->module_funcs_to_instances, ll->data));
+      g_rw_lock_writer_unlock (&provider->modules_lock);
       g_list_free (funcs_to_remove);
     }
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* called with lock held */
+/* called in the main thread - runs @func and records how long it took as the metric @name */
+static void
+handle_block_uevent_stage (UDisksLinuxProvider *provider,
+                           const gchar         *name,
+                           void               (*func) (UDisksLinuxProvider *provider,
+                                                       const gchar         *action,
+                                                       UDisksLinuxDevice   *device),
+                           const gchar         *action,
+                           UDisksLinuxDevice   *device)
+{
+  gint64 time_start;
+
+  UDISKS_TRACE3 (uevent_stage_start, name, action, g_udev_device_get_sysfs_path (device->udev_device));
+  time_start = g_get_monotonic_time ();
+  func (provider, action, device);
+  UDISKS_TRACE3 (uevent_stage_end, name, action, g_udev_device_get_sysfs_path (device->udev_device));
+  udisks_metrics_add_since (udisks_daemon_get_metrics (udisks_provider_get_daemon (UDISKS_PROVIDER (provider))),
+                            name,
+                            time_start);
+}
+
+/* called in the main thread */
 static void
 handle_block_uevent (UDisksLinuxProvider *provider,
                      const gchar         *action,
@@ -1228,10 +1739,10 @@ handle_block_uevent (UDisksLinuxProvider *provider,
    */
   if (g_strcmp0 (action, "remove") == 0)
     {
-      handle_block_uevent_for_block (provider, action, device);
-      handle_block_uevent_for_drive (provider, action, device);
-      handle_block_uevent_for_mdraid (provider, action, device);
-      handle_block_uevent_for_modules (provider, action, device);
+      handle_block_uevent_stage (provider, "uevent-block", handle_block_uevent_for_block, action, device);
+      handle_block_uevent_stage (provider, "uevent-drive", handle_block_uevent_for_drive, action, device);
+      handle_block_uevent_stage (provider, "uevent-mdraid", handle_block_uevent_for_mdraid, action, device);
+      handle_block_uevent_stage (provider, "uevent-modules", handle_block_uevent_for_modules, action, device);
     }
   else
     {
@@ -1248,21 +1759,17 @@ handle_block_uevent (UDisksLinuxProvider *provider,
         }
       else
         {
-          handle_block_uevent_for_modules (provider, action, device);
-          handle_block_uevent_for_mdraid (provider, action, device);
-          handle_block_uevent_for_drive (provider, action, device);
-          handle_block_uevent_for_block (provider, action, device);
+          handle_block_uevent_stage (provider, "uevent-modules", handle_block_uevent_for_modules, action, device);
+          handle_block_uevent_stage (provider, "uevent-mdraid", handle_block_uevent_for_mdraid, action, device);
+          handle_block_uevent_stage (provider, "uevent-drive", handle_block_uevent_for_drive, action, device);
+          handle_block_uevent_stage (provider, "uevent-block", handle_block_uevent_for_block, action, device);
         }
     }
-
-  if (g_strcmp0 (action, "add") != 0)
-    {
-      /* Possibly need to clean up */
-      udisks_state_check (udisks_daemon_get_state (udisks_provider_get_daemon (UDISKS_PROVIDER (provider))));
-    }
 }
 
-/* called without lock held */
+/* called in the main thread - the caller is responsible for calling
+ * udisks_state_check_device() for the devices in a batch of uevents
+ */
 static void
 udisks_linux_provider_handle_uevent (UDisksLinuxProvider *provider,
                                      const gchar         *action,
@@ -1270,8 +1777,6 @@ udisks_linux_provider_handle_uevent (UDisksLinuxProvider *provider,
 {
   const gchar *subsystem;
 
-  G_LOCK (provider_lock);
-
   udisks_debug ("uevent %s %s",
                 action,
                 g_udev_device_get_sysfs_path (device->udev_device));
@@ -1281,48 +1786,369 @@ udisks_linux_provider_handle_uevent (UDisksLinuxProvider *provider,
     {
       handle_block_uevent (provider, action, device);
     }
-
-  G_UNLOCK (provider_lock);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* Runs in housekeeping thread - called without lock held */
+/* How often to do housekeeping for module objects */
+#define HOUSEKEEPING_MODULES_INTERVAL_SECONDS (10*60)
+
+/* When the next housekeeping for a drive is due, see udisks_linux_drive_object_get_housekeeping_interval() */
+typedef struct
+{
+  /* monotonic time, G_MAXINT64 while housekeeping is in progress */
+  gint64 next_due;
+  /* monotonic time the last housekeeping started at or 0 if never */
+  gint64 last_started;
+  /* TRUE if the housekeeping in progress has timed out */
+  gboolean timed_out;
+} HousekeepingSchedule;
+
+static void
+housekeeping_schedule_free (gpointer data)
+{
+  g_slice_free (HousekeepingSchedule, data);
+}
+
+typedef struct
+{
+  volatile gint ref_count;
+  UDisksLinuxProvider *provider;
+  UDisksLinuxDriveObject *object;
+  guint secs_since_last;
+  GCancellable *cancellable;
+  /* the following are protected by housekeeping_lock */
+  gint64 started_at;
+  gboolean done;
+  gboolean timed_out;
+} HousekeepingRequest;
+
+/* called with housekeeping_lock held - marks the housekeeping for @object as in progress */
+static HousekeepingRequest *
+housekeeping_request_new (UDisksLinuxProvider    *provider,
+                          UDisksLinuxDriveObject *object)
+{
+  HousekeepingRequest *request;
+  HousekeepingSchedule *schedule;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+
+  schedule = g_hash_table_lookup (provider->housekeeping_schedules, object);
+  if (schedule == NULL)
+    {
+      schedule = g_slice_new0 (HousekeepingSchedule);
+      g_hash_table_insert (provider->housekeeping_schedules, g_object_ref (object), schedule);
+    }
+
+  request = g_slice_new0 (HousekeepingRequest);
+  request->ref_count = 1;
+  request->provider = g_object_ref (provider);
+  request->object = g_object_ref (object);
+  if (schedule->last_started > 0)
+    request->secs_since_last = (now - schedule->last_started) / G_USEC_PER_SEC;
+  request->cancellable = g_cancellable_new ();
+
+  schedule->last_started = now;
+  schedule->next_due = G_MAXINT64;
+
+  return request;
+}
+
+static HousekeepingRequest *
+housekeeping_request_ref (HousekeepingRequest *request)
+{
+  g_atomic_int_inc (&request->ref_count);
+  return request;
+}
+
+static void
+housekeeping_request_unref (HousekeepingRequest *request)
+{
+  if (g_atomic_int_dec_and_test (&request->ref_count))
+    {
+      g_object_unref (request->provider);
+      g_object_unref (request->object);
+      g_object_unref (request->cancellable);
+      g_slice_free (HousekeepingRequest, request);
+    }
+}
+
+/* Runs in a thread from the housekeeping pool */
+static void
+housekeeping_drive_func (gpointer data,
+                         gpointer user_data)
+{
+  HousekeepingRequest *request = data;
+  UDisksLinuxProvider *provider = request->provider;
+  HousekeepingSchedule *schedule;
+  GError *error;
+  guint interval;
+
+  g_mutex_lock (&provider->housekeeping_lock);
+  request->started_at = g_get_monotonic_time ();
+  g_cond_broadcast (&provider->housekeeping_cond);
+  g_mutex_unlock (&provider->housekeeping_lock);
+
+  error = NULL;
+  if (!udisks_linux_drive_object_housekeeping (request->object,
+                                               request->secs_since_last,
+                                               request->cancellable,
+                                               &error))
+    {
+      udisks_warning ("Error performing housekeeping for drive %s: %s (%s, %d)",
+                      g_dbus_object_get_object_path (G_DBUS_OBJECT (request->object)),
+                      error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+    }
+
+  interval = udisks_linux_drive_object_get_housekeeping_interval (request->object);
+
+  udisks_metrics_add_since (udisks_daemon_get_metrics (udisks_provider_get_daemon (UDISKS_PROVIDER (provider))),
+                            "drive-housekeeping",
+                            request->started_at);
+
+  g_mutex_lock (&provider->housekeeping_lock);
+  request->done = TRUE;
+  if (request->timed_out)
+    {
+      udisks_info ("Housekeeping for drive %s completed %.3f seconds after it started",
+                   g_dbus_object_get_object_path (G_DBUS_OBJECT (request->object)),
+                   (g_get_monotonic_time () - request->started_at) / ((gdouble) G_USEC_PER_SEC));
+    }
+
+  /* the schedule is gone if the drive was removed in the meantime */
+  schedule = g_hash_table_lookup (provider->housekeeping_schedules, request->object);
+  if (schedule != NULL)
+    {
+      schedule->timed_out = FALSE;
+
+      /* spread the drives found at start-up (or hotplugged at the same
+       * time) over the interval so they don't all get polled at once
+       */
+      if (request->secs_since_last == 0)
+        schedule->next_due = g_get_monotonic_time () + g_random_int_range (1, interval + 1) * G_USEC_PER_SEC;
+      else
+        schedule->next_due = schedule->last_started + interval * G_USEC_PER_SEC;
+    }
+
+  g_cond_broadcast (&provider->housekeeping_cond);
+  g_mutex_unlock (&provider->housekeeping_lock);
+
+  housekeeping_request_unref (request);
+}
+
+/* called in the main thread
+ *
+ * Marks @object as due and starts a housekeeping pass unless one is
+ * already running, in which case the next tick picks it up - either
+ * way the drive goes through the bounded pool and its timeout.
+ */
 static void
-housekeeping_all_drives (UDisksLinuxProvider *provider,
-                         guint                secs_since_last)
+schedule_initial_housekeeping_for_drive (UDisksLinuxProvider    *provider,
+                                         UDisksLinuxDriveObject *object)
+{
+  HousekeepingSchedule *schedule;
+
+  g_mutex_lock (&provider->housekeeping_lock);
+  schedule = g_hash_table_lookup (provider->housekeeping_schedules, object);
+  if (schedule == NULL)
+    {
+      schedule = g_slice_new0 (HousekeepingSchedule);
+      g_hash_table_insert (provider->housekeeping_schedules, g_object_ref (object), schedule);
+    }
+  if (schedule->next_due != G_MAXINT64)
+    schedule->next_due = 0;
+  g_mutex_unlock (&provider->housekeeping_lock);
+
+  on_housekeeping_timeout (provider);
+}
+
+/* Runs in housekeeping thread
+ *
+ * Does housekeeping in parallel for all drives that are due and
+ * returns once they are done or have exceeded the housekeeping_timeout
+ * configuration option. Drives that time out are left running in the
+ * background, are reported by udisks_linux_provider_get_housekeeping_stats()
+ * and are not scheduled again until they complete.
+ */
+static void
+housekeeping_due_drives (UDisksLinuxProvider *provider)
 {
   GList *objects;
   GList *l;
+  GHashTable *current;
+  GHashTableIter iter;
+  gpointer key;
+  GPtrArray *requests;
+  GThreadPool *pool;
+  guint num_pending;
+  guint num_timed_out = 0;
+  UDisksConfigManager *config_manager;
+  guint max_workers;
+  guint timeout_seconds;
+  gint64 time_start;
+  guint n;
 
-  G_LOCK (provider_lock);
+  time_start = g_get_monotonic_time ();
+
+  config_manager = udisks_daemon_get_config_manager (udisks_provider_get_daemon (UDISKS_PROVIDER (provider)));
+  max_workers = udisks_config_manager_get_housekeeping_workers (config_manager);
+  timeout_seconds = udisks_config_manager_get_housekeeping_timeout (config_manager);
+
+  g_rw_lock_reader_lock (&provider->drives_lock);
   objects = g_hash_table_get_values (provider->vpd_to_drive);
   g_list_foreach (objects, (GFunc) g_object_ref, NULL);
-  G_UNLOCK (provider_lock);
+  g_rw_lock_reader_unlock (&provider->drives_lock);
+
+  requests = g_ptr_array_new_with_free_func ((GDestroyNotify) housekeeping_request_unref);
+  pool = NULL;
+
+  g_mutex_lock (&provider->housekeeping_lock);
+
+  /* forget about drives that have been removed */
+  current = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (l = objects; l != NULL; l = l->next)
+    g_hash_table_add (current, l->data);
+  g_hash_table_iter_init (&iter, provider->housekeeping_schedules);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      if (!g_hash_table_contains (current, key))
+        g_hash_table_iter_remove (&iter);
+    }
+  g_hash_table_unref (current);
 
   for (l = objects; l != NULL; l = l->next)
     {
       UDisksLinuxDriveObject *object = UDISKS_LINUX_DRIVE_OBJECT (l->data);
-      GError *error;
+      HousekeepingSchedule *schedule;
+      HousekeepingRequest *request;
 
-      error = NULL;
-      if (!udisks_linux_drive_object_housekeeping (object,
-                                                   secs_since_last,
-                                                   NULL, /* TODO: cancellable */
-                                                   &error))
+      /* drives never seen before are due right away */
+      schedule = g_hash_table_lookup (provider->housekeeping_schedules, object);
+      if (schedule != NULL && schedule->next_due > time_start)
+        continue;
+
+      if (pool == NULL)
+        pool = g_thread_pool_new (housekeeping_drive_func,
+                                  NULL,
+                                  max_workers,
+                                  FALSE,
+                                  NULL);
+
+      request = housekeeping_request_new (provider, object);
+      g_ptr_array_add (requests, request);
+      g_thread_pool_push (pool, housekeeping_request_ref (request), NULL);
+    }
+
+  num_pending = requests->len;
+  while (num_pending > 0)
+    {
+      gint64 now;
+      gint64 wake_up_at;
+
+      now = g_get_monotonic_time ();
+      wake_up_at = G_MAXINT64;
+      num_pending = 0;
+      for (n = 0; n < requests->len; n++)
         {
-          udisks_warning ("Error performing housekeeping for drive %s: %s (%s, %d)",
-                          g_dbus_object_get_object_path (G_DBUS_OBJECT (object)),
-                          error->message, g_quark_to_string (error->domain), error->code);
-          g_clear_error (&error);
+          HousekeepingRequest *request = g_ptr_array_index (requests, n);
+          gint64 deadline;
+
+          if (request->done || request->timed_out)
+            continue;
+
+          num_pending++;
+          if (request->started_at == 0)
+            continue;
+
+          deadline = request->started_at + timeout_seconds * G_USEC_PER_SEC;
+          if (now >= deadline)
+            {
+              HousekeepingSchedule *schedule;
+
+              udisks_warning ("Housekeeping for drive %s timed out after %u seconds",
+                              g_dbus_object_get_object_path (G_DBUS_OBJECT (request->object)),
+                              timeout_seconds);
+              request->timed_out = TRUE;
+              g_cancellable_cancel (request->cancellable);
+              num_timed_out++;
+              num_pending--;
+
+              provider->housekeeping_num_timed_out++;
+              schedule = g_hash_table_lookup (provider->housekeeping_schedules, request->object);
+              if (schedule != NULL)
+                schedule->timed_out = TRUE;
+
+              /* don't let the stuck worker reduce parallelism for the other drives */
+              g_thread_pool_set_max_threads (pool, g_thread_pool_get_max_threads (pool) + 1, NULL);
+            }
+          else
+            {
+              wake_up_at = MIN (wake_up_at, deadline);
+            }
         }
+
+      if (num_pending > 0)
+        g_cond_wait_until (&provider->housekeeping_cond, &provider->housekeeping_lock, wake_up_at);
+    }
+  g_mutex_unlock (&provider->housekeeping_lock);
+
+  if (pool != NULL)
+    {
+      udisks_info ("Housekeeping for %u drives took %.3f seconds (%u timed out)",
+                   requests->len,
+                   (g_get_monotonic_time () - time_start) / ((gdouble) G_USEC_PER_SEC),
+                   num_timed_out);
+
+      /* doesn't wait for workers stuck on timed out drives */
+      g_thread_pool_free (pool, FALSE, FALSE);
     }
+  g_ptr_array_unref (requests);
 
   g_list_foreach (objects, (GFunc) g_object_unref, NULL);
   g_list_free (objects);
 }
 
-/* Runs in housekeeping thread - called without lock held */
+/**
+ * udisks_linux_provider_get_housekeeping_stats:
+ * @provider: A #UDisksLinuxProvider.
+ * @out_num_timed_out: (out) (allow-none): Return location for how often housekeeping for a drive has timed out or %NULL.
+ *
+ * Gets the drives whose housekeeping has timed out and is still
+ * stuck. This function is thread-safe.
+ *
+ * Returns: (transfer full): A %NULL-terminated array of drive object paths. Free with g_strfreev().
+ */
+gchar **
+udisks_linux_provider_get_housekeeping_stats (UDisksLinuxProvider *provider,
+                                              guint64             *out_num_timed_out)
+{
+  GPtrArray *stuck;
+  GHashTableIter iter;
+  UDisksLinuxDriveObject *object;
+  HousekeepingSchedule *schedule;
+
+  g_return_val_if_fail (UDISKS_IS_LINUX_PROVIDER (provider), NULL);
+
+  stuck = g_ptr_array_new ();
+
+  g_mutex_lock (&provider->housekeeping_lock);
+  g_hash_table_iter_init (&iter, provider->housekeeping_schedules);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &object, (gpointer *) &schedule))
+    {
+      if (schedule->timed_out)
+        g_ptr_array_add (stuck, g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object))));
+    }
+  if (out_num_timed_out != NULL)
+    *out_num_timed_out = provider->housekeeping_num_timed_out;
+  g_mutex_unlock (&provider->housekeeping_lock);
+
+  g_ptr_array_add (stuck, NULL);
+  return (gchar **) g_ptr_array_free (stuck, FALSE);
+}
+
+/* Runs in housekeeping thread */
 static void
 housekeeping_all_modules (UDisksLinuxProvider *provider,
                           guint                secs_since_last)
@@ -1333,15 +2159,16 @@ housekeeping_all_modules (UDisksLinuxProvider *provider,
   GHashTableIter iter_funcs, iter_inst;
   GDBusObjectSkeleton *inst;
 
-  G_LOCK (provider_lock);
+  g_rw_lock_reader_lock (&provider->modules_lock);
   g_hash_table_iter_init (&iter_funcs, provider->module_funcs_to_instances);
   while (g_hash_table_iter_next (&iter_funcs, NULL, (gpointer *) &inst_table))
     {
       g_hash_table_iter_init (&iter_inst, inst_table);
       while (g_hash_table_iter_next (&iter_inst, (gpointer *) &inst, NULL))
-        objects = g_list_append (objects, g_object_ref (inst));
+        objects = g_list_prepend (objects, g_object_ref (inst));
     }
-  G_UNLOCK (provider_lock);
+  g_rw_lock_reader_unlock (&provider->modules_lock);
+  objects = g_list_reverse (objects);
 
   for (l = objects; l != NULL; l = l->next)
     {
@@ -1377,68 +2204,190 @@ housekeeping_thread_func (GTask           *task,
   guint secs_since_last;
   guint64 now;
 
-  /* TODO: probably want some kind of timeout here to avoid faulty devices/drives blocking forever */
+  housekeeping_due_drives (provider);
 
-  secs_since_last = 0;
   now = time (NULL);
-  if (provider->housekeeping_last > 0)
-    secs_since_last = now - provider->housekeeping_last;
-  provider->housekeeping_last = now;
-
-  udisks_info ("Housekeeping initiated (%u seconds since last housekeeping)", secs_since_last);
-
-  housekeeping_all_drives (provider, secs_since_last);
-  housekeeping_all_modules (provider, secs_since_last);
+  if (provider->housekeeping_modules_last == 0 ||
+      now - provider->housekeeping_modules_last >= HOUSEKEEPING_MODULES_INTERVAL_SECONDS)
+    {
+      gint64 time_start;
+
+      time_start = g_get_monotonic_time ();
+      secs_since_last = 0;
+      if (provider->housekeeping_modules_last > 0)
+        secs_since_last = now - provider->housekeeping_modules_last;
+      provider->housekeeping_modules_last = now;
+
+      udisks_info ("Housekeeping initiated for module objects (%u seconds since last housekeeping)", secs_since_last);
+      housekeeping_all_modules (provider, secs_since_last);
+      udisks_info ("Housekeeping for module objects complete in %.3f seconds",
+                   (g_get_monotonic_time () - time_start) / ((gdouble) G_USEC_PER_SEC));
+    }
 
-  udisks_info ("Housekeeping complete");
-  G_LOCK (provider_lock);
-  provider->housekeeping_running = FALSE;
-  G_UNLOCK (provider_lock);
+  g_atomic_int_set (&provider->housekeeping_running, FALSE);
 }
 
-/* called from the main thread on start-up and every 10 minutes or so */
+/* called from the main thread on start-up and every HOUSEKEEPING_TICK_SECONDS */
 static gboolean
 on_housekeeping_timeout (gpointer user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
   GTask *task;
 
-  G_LOCK (provider_lock);
-  if (provider->housekeeping_running)
-    goto out;
-  provider->housekeeping_running = TRUE;
-  task = g_task_new (NULL, NULL, NULL, NULL);
-  g_task_set_task_data (task, g_object_ref (provider), NULL);
-  g_task_run_in_thread (task, housekeeping_thread_func);
-  g_object_unref (task);
-
- out:
-  G_UNLOCK (provider_lock);
+  if (g_atomic_int_compare_and_exchange (&provider->housekeeping_running, FALSE, TRUE))
+    {
+      task = g_task_new (NULL, NULL, NULL, NULL);
+      g_task_set_task_data (task, g_object_ref (provider), NULL);
+      g_task_run_in_thread (task, housekeeping_thread_func);
+      g_object_unref (task);
+    }
 
   return TRUE; /* keep timeout around */
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Sends a synthesized "change" uevent to the block or MD-RAID objects
+ * whose UUID is given by the x-parent= options in @options so their
+ * ChildConfiguration property is updated.
+ */
 static void
-update_all_block_objects (UDisksLinuxProvider *provider)
+update_parent_objects_for_options (UDisksLinuxProvider *provider,
+                                   const gchar         *options)
 {
+  UDisksDaemon *daemon;
+  gchar **tokens;
+  guint n;
+
+  if (options == NULL || strstr (options, "x-parent=") == NULL)
+    return;
+
+  daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
+  tokens = g_strsplit (options, ",", -1);
+  for (n = 0; tokens[n] != NULL; n++)
+    {
+      const gchar *uuid;
+      UDisksObject *object;
+      GList *objects;
+      GList *l;
+
+      if (!g_str_has_prefix (tokens[n], "x-parent="))
+        continue;
+      uuid = tokens[n] + strlen ("x-parent=");
+      if (uuid[0] == '\0')
+        continue;
+
+      /* an encrypted block device ... */
+      objects = udisks_daemon_find_blocks_by_identifier (daemon, UDISKS_DEVICE_SPEC_UUID, uuid);
+      for (l = objects; l != NULL; l = l->next)
+        udisks_linux_block_object_uevent (UDISKS_LINUX_BLOCK_OBJECT (l->data), "change", NULL);
+      g_list_free_full (objects, g_object_unref);
+
+      /* ... or a MD-RAID array */
+      object = udisks_daemon_find_mdraid (daemon, uuid);
+      if (object != NULL)
+        {
+          UDisksLinuxMDRaidObject *mdraid_object = UDISKS_LINUX_MDRAID_OBJECT (object);
+          UDisksLinuxDevice *device;
+          GList *members;
+
+          device = udisks_linux_mdraid_object_get_device (mdraid_object);
+          if (device != NULL)
+            {
+              udisks_linux_mdraid_object_uevent (mdraid_object, "change", device, FALSE);
+              g_object_unref (device);
+            }
+          else
+            {
+              /* the array is not running, update it through one of its members */
+              members = udisks_linux_mdraid_object_get_members (mdraid_object);
+              if (members != NULL)
+                udisks_linux_mdraid_object_uevent (mdraid_object, "change", UDISKS_LINUX_DEVICE (members->data), TRUE);
+              g_list_free_full (members, g_object_unref);
+            }
+          g_object_unref (object);
+        }
+    }
+  g_strfreev (tokens);
+}
+
+/* Sends a synthesized "change" uevent to the block objects that a
+ * fstab or crypttab entry for @spec (e.g. /dev/sda1 or UUID=...) can
+ * refer to, so their Block:Configuration property is updated, and to
+ * the parent objects named by x-parent= in @options. Entries not
+ * referring to a block device don't cause any updates at all.
+ */
+static void
+update_block_objects_for_spec (UDisksLinuxProvider *provider,
+                               const gchar         *spec,
+                               const gchar         *options)
+{
+  UDisksDaemon *daemon;
+  UDisksObject *object;
+  UDisksDeviceSpecType type;
+  const gchar *value;
   GList *objects;
   GList *l;
 
-  G_LOCK (provider_lock);
-  objects = g_hash_table_get_values (provider->sysfs_to_block);
-  g_list_foreach (objects, (GFunc) g_object_ref, NULL);
-  G_UNLOCK (provider_lock);
+  daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
+  objects = NULL;
+
+  type = udisks_daemon_util_parse_device_spec (spec, &value);
+  switch (type)
+    {
+    case UDISKS_DEVICE_SPEC_PATH:
+      if (!g_str_has_prefix (value, "/dev"))
+        break;
+      object = udisks_daemon_find_block_by_device_file (daemon, value);
+      if (object == NULL)
+        object = udisks_daemon_find_block_by_symlink (daemon, value);
+      if (object != NULL)
+        objects = g_list_prepend (objects, object);
+      break;
+
+    case UDISKS_DEVICE_SPEC_UUID:
+    case UDISKS_DEVICE_SPEC_LABEL:
+    case UDISKS_DEVICE_SPEC_PARTUUID:
+    case UDISKS_DEVICE_SPEC_PARTLABEL:
+      /* several block devices may share an identifier, e.g. RAID members */
+      objects = udisks_daemon_find_blocks_by_identifier (daemon, type, value);
+      break;
+
+    default:
+      /* ignore empty identifiers */
+      break;
+    }
 
   for (l = objects; l != NULL; l = l->next)
     {
-      UDisksLinuxBlockObject *object = UDISKS_LINUX_BLOCK_OBJECT (l->data);
-      udisks_linux_block_object_uevent (object, "change", NULL);
+      UDisksLinuxBlockObject *block_object = UDISKS_LINUX_BLOCK_OBJECT (l->data);
+      udisks_linux_block_object_uevent (block_object, "change", NULL);
     }
 
-  g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-  g_list_free (objects);
+  udisks_debug ("Updated %u block objects for %s", g_list_length (objects), spec);
+
+  g_list_free_full (objects, g_object_unref);
+
+  update_parent_objects_for_options (provider, options);
+}
+
+static void
+mount_monitor_on_mount_changed (UDisksMountMonitor *monitor,
+                                UDisksMount        *mount,
+                                gpointer            user_data)
+{
+  UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
+  UDisksDaemon *daemon;
+  UDisksObject *object;
+
+  daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
+  object = udisks_daemon_find_block (daemon, udisks_mount_get_dev (mount));
+  if (object != NULL)
+    {
+      if (UDISKS_IS_LINUX_BLOCK_OBJECT (object))
+        udisks_linux_block_object_uevent (UDISKS_LINUX_BLOCK_OBJECT (object), NULL, NULL);
+      g_object_unref (object);
+    }
 }
 
 static void
@@ -1447,7 +2396,9 @@ fstab_monitor_on_entry_added (UDisksFstabMonitor *monitor,
                               gpointer            user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_block_objects_for_spec (provider,
+                                 udisks_fstab_entry_get_fsname (entry),
+                                 udisks_fstab_entry_get_opts (entry));
 }
 
 static void
@@ -1456,7 +2407,9 @@ fstab_monitor_on_entry_removed (UDisksFstabMonitor *monitor,
                                 gpointer            user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_block_objects_for_spec (provider,
+                                 udisks_fstab_entry_get_fsname (entry),
+                                 udisks_fstab_entry_get_opts (entry));
 }
 
 static void
@@ -1465,7 +2418,9 @@ crypttab_monitor_on_entry_added (UDisksCrypttabMonitor *monitor,
                                  gpointer               user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_block_objects_for_spec (provider,
+                                 udisks_crypttab_entry_get_device (entry),
+                                 udisks_crypttab_entry_get_options (entry));
 }
 
 static void
@@ -1474,5 +2429,7 @@ crypttab_monitor_on_entry_removed (UDisksCrypttabMonitor *monitor,
                                    gpointer               user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_block_objects_for_spec (provider,
+                                 udisks_crypttab_entry_get_device (entry),
+                                 udisks_crypttab_entry_get_options (entry));
 }
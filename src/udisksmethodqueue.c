@@ -0,0 +1,371 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+
+#include <glib/gi18n-lib.h>
+
+#include "udisksmethodqueue.h"
+#include "udiskslogging.h"
+
+/**
+ * SECTION:udisksmethodqueue
+ * @title: UDisksMethodQueue
+ * @short_description: Limits the number of D-Bus method calls handled at once
+ *
+ * Most D-Bus method calls are handled in GDBus worker threads and can
+ * block for a long time, e.g. while waiting for a spawned job. A
+ * #UDisksMethodQueue bounds how many of them are handled at the same
+ * time - the others wait in udisks_method_queue_enter() until a call
+ * in flight has been completed.
+ *
+ * Note that this limits how many calls make progress, not how many
+ * threads are used: GDBus still runs every such call in a thread of
+ * the shared #GTask pool, and a call waiting here keeps its thread
+ * busy. Many waiting calls can thus delay other #GTask users until
+ * the pool has grown.
+ *
+ * Waiting calls are admitted round-robin between callers (D-Bus
+ * unique names) and in FIFO order for each caller, so one client
+ * issuing hundreds of calls can't starve the others. Calls with the
+ * same serialization key (typically the object path of the device
+ * they operate on) are never handled at the same time.
+ */
+
+typedef struct _UDisksMethodQueueClass UDisksMethodQueueClass;
+
+typedef struct
+{
+  gchar *sender;
+  GQueue calls;                 /* of MethodCall, oldest first */
+} Caller;
+
+typedef struct
+{
+  UDisksMethodQueue *queue;
+  gchar *serialize_key;
+  gboolean admitted;
+  gint64 enqueued_at;
+} MethodCall;
+
+/**
+ * UDisksMethodQueue:
+ *
+ * The #UDisksMethodQueue structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _UDisksMethodQueue
+{
+  GObject parent_instance;
+
+  guint max_in_flight;
+
+  /* protects all members below */
+  GMutex lock;
+  /* signalled whenever calls have been admitted */
+  GCond cond;
+
+  /* callers with waiting calls, in the order they are served */
+  GQueue callers;
+  /* maps from D-Bus unique name to Caller, for the callers in @callers */
+  GHashTable *callers_by_sender;
+  /* serialization keys of the calls in flight */
+  GHashTable *busy_keys;
+
+  guint num_queued;
+  guint num_in_flight;
+  guint max_queued;
+  guint64 num_dispatched;
+  gint64 total_wait_usec;
+};
+
+struct _UDisksMethodQueueClass
+{
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (UDisksMethodQueue, udisks_method_queue, G_TYPE_OBJECT);
+
+static void
+caller_free (Caller *caller)
+{
+  g_warn_if_fail (g_queue_is_empty (&caller->calls));
+  g_free (caller->sender);
+  g_free (caller);
+}
+
+static void
+udisks_method_queue_finalize (GObject *object)
+{
+  UDisksMethodQueue *queue = UDISKS_METHOD_QUEUE (object);
+
+  /* every waiting or in-flight call holds a reference */
+  g_warn_if_fail (g_queue_is_empty (&queue->callers));
+  g_hash_table_unref (queue->callers_by_sender);
+  g_hash_table_unref (queue->busy_keys);
+  g_mutex_clear (&queue->lock);
+  g_cond_clear (&queue->cond);
+
+  G_OBJECT_CLASS (udisks_method_queue_parent_class)->finalize (object);
+}
+
+static void
+udisks_method_queue_init (UDisksMethodQueue *queue)
+{
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+  g_queue_init (&queue->callers);
+  queue->callers_by_sender = g_hash_table_new_full (g_str_hash,
+                                                    g_str_equal,
+                                                    NULL,
+                                                    (GDestroyNotify) caller_free);
+  /* keys are owned by the MethodCall instances */
+  queue->busy_keys = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+static void
+udisks_method_queue_class_init (UDisksMethodQueueClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = udisks_method_queue_finalize;
+}
+
+/**
+ * udisks_method_queue_new:
+ * @max_in_flight: The maximum number of method calls to handle at the same time.
+ *
+ * Creates a new #UDisksMethodQueue.
+ *
+ * Returns: A #UDisksMethodQueue. Free with g_object_unref().
+ */
+UDisksMethodQueue *
+udisks_method_queue_new (guint max_in_flight)
+{
+  UDisksMethodQueue *queue;
+
+  g_return_val_if_fail (max_in_flight > 0, NULL);
+
+  queue = UDISKS_METHOD_QUEUE (g_object_new (UDISKS_TYPE_METHOD_QUEUE, NULL));
+  queue->max_in_flight = max_in_flight;
+
+  return queue;
+}
+
+/* Admits as many waiting calls as possible - must be called with the lock held */
+static void
+schedule (UDisksMethodQueue *queue)
+{
+  gboolean admitted_any = FALSE;
+
+  while (queue->num_in_flight < queue->max_in_flight)
+    {
+      MethodCall *call = NULL;
+      Caller *caller = NULL;
+      GList *l, *ll;
+
+      /* the first call, in caller order, that isn't serialized behind a call in flight */
+      for (l = queue->callers.head; l != NULL && call == NULL; l = l->next)
+        {
+          caller = l->data;
+          for (ll = caller->calls.head; ll != NULL; ll = ll->next)
+            {
+              MethodCall *candidate = ll->data;
+              if (candidate->serialize_key == NULL ||
+                  !g_hash_table_contains (queue->busy_keys, candidate->serialize_key))
+                {
+                  call = candidate;
+                  g_queue_delete_link (&caller->calls, ll);
+                  break;
+                }
+            }
+        }
+
+      if (call == NULL)
+        break;
+
+      /* the caller goes to the back of the line */
+      g_queue_remove (&queue->callers, caller);
+      if (g_queue_is_empty (&caller->calls))
+        g_hash_table_remove (queue->callers_by_sender, caller->sender);
+      else
+        g_queue_push_tail (&queue->callers, caller);
+
+      if (call->serialize_key != NULL)
+        g_hash_table_add (queue->busy_keys, call->serialize_key);
+
+      call->admitted = TRUE;
+      queue->num_queued--;
+      queue->num_in_flight++;
+      queue->num_dispatched++;
+      admitted_any = TRUE;
+    }
+
+  if (admitted_any)
+    g_cond_broadcast (&queue->cond);
+}
+
+static void
+on_invocation_finalized (gpointer  user_data,
+                         GObject  *where_the_object_was)
+{
+  MethodCall *call = user_data;
+  UDisksMethodQueue *queue = call->queue;
+
+  g_mutex_lock (&queue->lock);
+  if (call->serialize_key != NULL)
+    g_hash_table_remove (queue->busy_keys, call->serialize_key);
+  queue->num_in_flight--;
+  schedule (queue);
+  g_mutex_unlock (&queue->lock);
+
+  g_free (call->serialize_key);
+  g_free (call);
+  g_object_unref (queue);
+}
+
+/**
+ * udisks_method_queue_enter:
+ * @queue: A #UDisksMethodQueue.
+ * @invocation: The method call about to be handled.
+ * @serialize_key: (allow-none): Key for calls that must not be handled at the same time or %NULL.
+ *
+ * Blocks the calling thread until @invocation may be handled. The
+ * call counts as in flight until @invocation has been completed (that
+ * is, until its last reference is dropped).
+ *
+ * This must be called from the thread the method call is handled in,
+ * never from the main thread.
+ */
+void
+udisks_method_queue_enter (UDisksMethodQueue     *queue,
+                           GDBusMethodInvocation *invocation,
+                           const gchar           *serialize_key)
+{
+  const gchar *sender;
+
+  g_return_if_fail (UDISKS_IS_METHOD_QUEUE (queue));
+  g_return_if_fail (G_IS_DBUS_METHOD_INVOCATION (invocation));
+
+  sender = g_dbus_method_invocation_get_sender (invocation);
+  if (sender == NULL)
+    sender = ""; /* peer-to-peer connection */
+
+  udisks_method_queue_enter_for_caller (queue, G_OBJECT (invocation), sender, serialize_key);
+}
+
+/**
+ * udisks_method_queue_enter_for_caller:
+ * @queue: A #UDisksMethodQueue.
+ * @call_object: An object representing the call about to be handled.
+ * @sender: The caller, e.g. the D-Bus unique name of the sender.
+ * @serialize_key: (allow-none): Key for calls that must not be handled at the same time or %NULL.
+ *
+ * Like udisks_method_queue_enter() but for any object representing a
+ * call - the call counts as in flight until @call_object is finalized. Calls
+ * are admitted round-robin between different @sender values.
+ */
+void
+udisks_method_queue_enter_for_caller (UDisksMethodQueue *queue,
+                                      GObject           *call_object,
+                                      const gchar       *sender,
+                                      const gchar       *serialize_key)
+{
+  MethodCall *call;
+  Caller *caller;
+
+  g_return_if_fail (UDISKS_IS_METHOD_QUEUE (queue));
+  g_return_if_fail (G_IS_OBJECT (call_object));
+  g_return_if_fail (sender != NULL);
+
+  call = g_new0 (MethodCall, 1);
+  call->queue = g_object_ref (queue);
+  call->serialize_key = g_strdup (serialize_key);
+  call->enqueued_at = g_get_monotonic_time ();
+
+  g_mutex_lock (&queue->lock);
+
+  caller = g_hash_table_lookup (queue->callers_by_sender, sender);
+  if (caller == NULL)
+    {
+      caller = g_new0 (Caller, 1);
+      caller->sender = g_strdup (sender);
+      g_queue_init (&caller->calls);
+      g_hash_table_insert (queue->callers_by_sender, caller->sender, caller);
+      g_queue_push_tail (&queue->callers, caller);
+    }
+  g_queue_push_tail (&caller->calls, call);
+
+  queue->num_queued++;
+  queue->max_queued = MAX (queue->max_queued, queue->num_queued);
+
+  schedule (queue);
+  if (!call->admitted)
+    {
+      udisks_debug ("Queueing call from %s for %s (%u queued, %u in flight)",
+                    sender,
+                    serialize_key != NULL ? serialize_key : "(any)",
+                    queue->num_queued,
+                    queue->num_in_flight);
+      while (!call->admitted)
+        g_cond_wait (&queue->cond, &queue->lock);
+    }
+  queue->total_wait_usec += g_get_monotonic_time () - call->enqueued_at;
+
+  g_mutex_unlock (&queue->lock);
+
+  g_object_weak_ref (call_object, on_invocation_finalized, call);
+}
+
+/**
+ * udisks_method_queue_get_stats:
+ * @queue: A #UDisksMethodQueue.
+ * @out_num_queued: (out) (allow-none): Return location for the number of calls waiting or %NULL.
+ * @out_num_in_flight: (out) (allow-none): Return location for the number of calls being handled or %NULL.
+ * @out_max_queued: (out) (allow-none): Return location for the highest number of calls waiting at the same time or %NULL.
+ * @out_num_dispatched: (out) (allow-none): Return location for the number of calls admitted so far or %NULL.
+ * @out_total_wait_usec: (out) (allow-none): Return location for the time all admitted calls spent waiting, in micro-seconds, or %NULL.
+ *
+ * Gets statistics about @queue.
+ */
+void
+udisks_method_queue_get_stats (UDisksMethodQueue *queue,
+                               guint             *out_num_queued,
+                               guint             *out_num_in_flight,
+                               guint             *out_max_queued,
+                               guint64           *out_num_dispatched,
+                               gint64            *out_total_wait_usec)
+{
+  g_return_if_fail (UDISKS_IS_METHOD_QUEUE (queue));
+
+  g_mutex_lock (&queue->lock);
+  if (out_num_queued != NULL)
+    *out_num_queued = queue->num_queued;
+  if (out_num_in_flight != NULL)
+    *out_num_in_flight = queue->num_in_flight;
+  if (out_max_queued != NULL)
+    *out_max_queued = queue->max_queued;
+  if (out_num_dispatched != NULL)
+    *out_num_dispatched = queue->num_dispatched;
+  if (out_total_wait_usec != NULL)
+    *out_total_wait_usec = queue->total_wait_usec;
+  g_mutex_unlock (&queue->lock);
+}
@@ -0,0 +1,50 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_METHOD_QUEUE_H__
+#define __UDISKS_METHOD_QUEUE_H__
+
+#include "udisksdaemontypes.h"
+
+G_BEGIN_DECLS
+
+#define UDISKS_TYPE_METHOD_QUEUE         (udisks_method_queue_get_type ())
+#define UDISKS_METHOD_QUEUE(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_METHOD_QUEUE, UDisksMethodQueue))
+#define UDISKS_IS_METHOD_QUEUE(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_METHOD_QUEUE))
+
+GType               udisks_method_queue_get_type  (void) G_GNUC_CONST;
+UDisksMethodQueue  *udisks_method_queue_new       (guint                   max_in_flight);
+void                udisks_method_queue_enter     (UDisksMethodQueue      *queue,
+                                                   GDBusMethodInvocation  *invocation,
+                                                   const gchar            *serialize_key);
+void                udisks_method_queue_enter_for_caller (UDisksMethodQueue *queue,
+                                                          GObject           *call_object,
+                                                          const gchar       *sender,
+                                                          const gchar       *serialize_key);
+void                udisks_method_queue_get_stats (UDisksMethodQueue      *queue,
+                                                   guint                  *out_num_queued,
+                                                   guint                  *out_num_in_flight,
+                                                   guint                  *out_max_queued,
+                                                   guint64                *out_num_dispatched,
+                                                   gint64                 *out_total_wait_usec);
+
+G_END_DECLS
+
+#endif /* __UDISKS_METHOD_QUEUE_H__ */
@@ -0,0 +1,302 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+
+#include <glib/gi18n-lib.h>
+
+#include "udisksmetrics.h"
+
+/**
+ * SECTION:udisksmetrics
+ * @title: UDisksMetrics
+ * @short_description: Collects timing metrics
+ *
+ * This type collects how long the daemon spends on its various
+ * activities, e.g. probing devices or running jobs. For each
+ * activity the number of samples, their sum and maximum and a
+ * histogram with power-of-two buckets are kept - recording a sample
+ * is cheap enough to be done at all times. Events that have no
+ * duration, e.g. a poll being skipped, are simply counted.
+ *
+ * The metrics are exported on the
+ * #org.freedesktop.UDisks2.Manager.Metrics D-Bus interface.
+ */
+
+/* Bucket n counts samples of at least 2^(n-1) but less than 2^n
+ * micro-seconds, bucket 0 counts samples of 0 micro-seconds and the
+ * last bucket also counts everything longer (i.e. ~36 minutes and up)
+ */
+#define NUM_BUCKETS 33
+
+typedef struct
+{
+  guint64 count;
+  guint64 total_usec;
+  guint64 max_usec;
+  guint64 buckets[NUM_BUCKETS];
+} Histogram;
+
+typedef struct _UDisksMetricsClass UDisksMetricsClass;
+
+/**
+ * UDisksMetrics:
+ *
+ * The #UDisksMetrics structure contains only private data and should
+ * only be accessed using the provided API.
+ */
+struct _UDisksMetrics
+{
+  GObject parent_instance;
+
+  /* protects @durations and @counters */
+  GMutex lock;
+  /* maps from activity name to Histogram */
+  GHashTable *durations;
+  /* maps from event name to a guint64 */
+  GHashTable *counters;
+};
+
+struct _UDisksMetricsClass
+{
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (UDisksMetrics, udisks_metrics, G_TYPE_OBJECT);
+
+static void
+udisks_metrics_finalize (GObject *object)
+{
+  UDisksMetrics *metrics = UDISKS_METRICS (object);
+
+  g_hash_table_unref (metrics->durations);
+  g_hash_table_unref (metrics->counters);
+  g_mutex_clear (&metrics->lock);
+
+  G_OBJECT_CLASS (udisks_metrics_parent_class)->finalize (object);
+}
+
+static void
+udisks_metrics_init (UDisksMetrics *metrics)
+{
+  g_mutex_init (&metrics->lock);
+  metrics->durations = g_hash_table_new_full (g_str_hash,
+                                              g_str_equal,
+                                              g_free,
+                                              g_free);
+  metrics->counters = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             g_free,
+                                             g_free);
+}
+
+static void
+udisks_metrics_class_init (UDisksMetricsClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = udisks_metrics_finalize;
+}
+
+/**
+ * udisks_metrics_new:
+ *
+ * Creates a new #UDisksMetrics object without any samples.
+ *
+ * Returns: A #UDisksMetrics. Free with g_object_unref().
+ */
+UDisksMetrics *
+udisks_metrics_new (void)
+{
+  return UDISKS_METRICS (g_object_new (UDISKS_TYPE_METRICS, NULL));
+}
+
+/**
+ * udisks_metrics_add_duration:
+ * @metrics: A #UDisksMetrics.
+ * @name: The name of the activity, e.g. <literal>uevent-probe</literal>.
+ * @usec: How long the activity took, in micro-seconds.
+ *
+ * Records that the activity @name took @usec micro-seconds.
+ *
+ * This can be called from any thread.
+ */
+void
+udisks_metrics_add_duration (UDisksMetrics *metrics,
+                             const gchar   *name,
+                             gint64         usec)
+{
+  Histogram *histogram;
+  guint bucket;
+
+  g_return_if_fail (UDISKS_IS_METRICS (metrics));
+  g_return_if_fail (name != NULL);
+
+  /* the clock is monotonic, but be careful anyway */
+  if (usec < 0)
+    usec = 0;
+
+  bucket = usec > 0 ? g_bit_storage (usec) : 0;
+  if (bucket >= NUM_BUCKETS)
+    bucket = NUM_BUCKETS - 1;
+
+  g_mutex_lock (&metrics->lock);
+  histogram = g_hash_table_lookup (metrics->durations, name);
+  if (histogram == NULL)
+    {
+      histogram = g_new0 (Histogram, 1);
+      g_hash_table_insert (metrics->durations, g_strdup (name), histogram);
+    }
+  histogram->count++;
+  histogram->total_usec += usec;
+  histogram->max_usec = MAX (histogram->max_usec, (guint64) usec);
+  histogram->buckets[bucket]++;
+  g_mutex_unlock (&metrics->lock);
+}
+
+/**
+ * udisks_metrics_add_since:
+ * @metrics: A #UDisksMetrics.
+ * @name: The name of the activity.
+ * @start_usec: When the activity started, as returned by g_get_monotonic_time().
+ *
+ * Like udisks_metrics_add_duration() but for an activity started at
+ * @start_usec and ending now.
+ */
+void
+udisks_metrics_add_since (UDisksMetrics *metrics,
+                          const gchar   *name,
+                          gint64         start_usec)
+{
+  udisks_metrics_add_duration (metrics, name, g_get_monotonic_time () - start_usec);
+}
+
+/**
+ * udisks_metrics_get_durations:
+ * @metrics: A #UDisksMetrics.
+ *
+ * Gets the samples recorded so far, see the
+ * org.freedesktop.UDisks2.Manager.Metrics.GetMetrics() D-Bus method
+ * for the format.
+ *
+ * Returns: A floating #GVariant of type <literal>a{sv}</literal>.
+ */
+GVariant *
+udisks_metrics_get_durations (UDisksMetrics *metrics)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  const gchar *name;
+  Histogram *histogram;
+
+  g_return_val_if_fail (UDISKS_IS_METRICS (metrics), NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+  g_mutex_lock (&metrics->lock);
+  g_hash_table_iter_init (&iter, metrics->durations);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &histogram))
+    {
+      GVariantBuilder dict_builder;
+      guint num_buckets;
+
+      /* leave out the empty buckets at the end */
+      num_buckets = NUM_BUCKETS;
+      while (num_buckets > 0 && histogram->buckets[num_buckets - 1] == 0)
+        num_buckets--;
+
+      g_variant_builder_init (&dict_builder, G_VARIANT_TYPE_VARDICT);
+      g_variant_builder_add (&dict_builder, "{sv}", "count", g_variant_new_uint64 (histogram->count));
+      g_variant_builder_add (&dict_builder, "{sv}", "total-usec", g_variant_new_uint64 (histogram->total_usec));
+      g_variant_builder_add (&dict_builder, "{sv}", "max-usec", g_variant_new_uint64 (histogram->max_usec));
+      g_variant_builder_add (&dict_builder, "{sv}", "buckets",
+                             g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                        histogram->buckets,
+                                                        num_buckets,
+                                                        sizeof (guint64)));
+      g_variant_builder_add (&builder, "{sv}", name, g_variant_builder_end (&dict_builder));
+    }
+  g_mutex_unlock (&metrics->lock);
+
+  return g_variant_builder_end (&builder);
+}
+
+/**
+ * udisks_metrics_add_count:
+ * @metrics: A #UDisksMetrics.
+ * @name: The name of the event, e.g. <literal>lvm2-polls-skipped</literal>.
+ * @count: How many times the event happened.
+ *
+ * Records that the event @name happened @count more times.
+ *
+ * This can be called from any thread.
+ */
+void
+udisks_metrics_add_count (UDisksMetrics *metrics,
+                          const gchar   *name,
+                          guint64        count)
+{
+  guint64 *counter;
+
+  g_return_if_fail (UDISKS_IS_METRICS (metrics));
+  g_return_if_fail (name != NULL);
+
+  g_mutex_lock (&metrics->lock);
+  counter = g_hash_table_lookup (metrics->counters, name);
+  if (counter == NULL)
+    {
+      counter = g_new0 (guint64, 1);
+      g_hash_table_insert (metrics->counters, g_strdup (name), counter);
+    }
+  *counter += count;
+  g_mutex_unlock (&metrics->lock);
+}
+
+/**
+ * udisks_metrics_get_counters:
+ * @metrics: A #UDisksMetrics.
+ *
+ * Gets the events counted so far, see the
+ * org.freedesktop.UDisks2.Manager.Metrics.GetMetrics() D-Bus method
+ * for the format.
+ *
+ * Returns: A floating #GVariant of type <literal>a{st}</literal>.
+ */
+GVariant *
+udisks_metrics_get_counters (UDisksMetrics *metrics)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  const gchar *name;
+  guint64 *counter;
+
+  g_return_val_if_fail (UDISKS_IS_METRICS (metrics), NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{st}"));
+
+  g_mutex_lock (&metrics->lock);
+  g_hash_table_iter_init (&iter, metrics->counters);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &counter))
+    g_variant_builder_add (&builder, "{st}", name, *counter);
+  g_mutex_unlock (&metrics->lock);
+
+  return g_variant_builder_end (&builder);
+}
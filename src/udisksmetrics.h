@@ -0,0 +1,48 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_METRICS_H__
+#define __UDISKS_METRICS_H__
+
+#include "udisksdaemontypes.h"
+
+G_BEGIN_DECLS
+
+#define UDISKS_TYPE_METRICS         (udisks_metrics_get_type ())
+#define UDISKS_METRICS(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_METRICS, UDisksMetrics))
+#define UDISKS_IS_METRICS(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_METRICS))
+
+GType           udisks_metrics_get_type       (void) G_GNUC_CONST;
+UDisksMetrics  *udisks_metrics_new            (void);
+void            udisks_metrics_add_duration   (UDisksMetrics  *metrics,
+                                               const gchar    *name,
+                                               gint64          usec);
+void            udisks_metrics_add_since      (UDisksMetrics  *metrics,
+                                               const gchar    *name,
+                                               gint64          start_usec);
+GVariant       *udisks_metrics_get_durations  (UDisksMetrics  *metrics);
+void            udisks_metrics_add_count      (UDisksMetrics  *metrics,
+                                               const gchar    *name,
+                                               guint64         count);
+GVariant       *udisks_metrics_get_counters   (UDisksMetrics  *metrics);
+
+G_END_DECLS
+
+#endif /* __UDISKS_METRICS_H__ */
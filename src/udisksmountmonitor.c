@@ -71,10 +71,51 @@ struct _UDisksMountMonitor
   GIOChannel *swaps_channel;
   GSource *swaps_watch_source;
 
+  /* protects everything below - the monitor is queried from other
+   * threads than the one it was created in
+   */
+  GMutex lock;
   gboolean have_data;
-  GList *mounts;
+
+  /* maps from a "type:major:minor:path" key to a MountRef - owns the UDisksMount instances */
+  GHashTable *mounts_by_key;
+  /* maps from dev_t (as guint64) to a GQueue of the UDisksMount instances in @mounts_by_key for it */
+  GHashTable *mounts_by_dev;
+
+  /* maps from mountinfo mount ID to a MountEntry */
+  GHashTable *mountinfo_entries;
+  /* maps from swap device file name to a MountEntry */
+  GHashTable *swaps_entries;
+  /* bumped on every update, used for spotting entries that went away */
+  guint generation;
+
+  /* statistics about the last update */
+  gint64 last_update_usec;
+  guint last_num_parsed;
+  guint last_num_allocated;
+  guint64 total_num_allocated;
 };
 
+/* A UDisksMount instance shared by all lines in mountinfo/swaps referring to it */
+typedef struct
+{
+  gchar *key;
+  UDisksMount *mount;
+  guint users;
+  /* the link for @mount in its queue in mounts_by_dev, for O(1) removal */
+  GList *dev_link;
+} MountRef;
+
+/* A line in mountinfo or swaps we have already seen */
+typedef struct
+{
+  /* the raw mountinfo line, used for detecting changes; NULL for swaps */
+  gchar *line;
+  /* NULL if the line isn't about a block device */
+  MountRef *ref;
+  guint generation;
+} MountEntry;
+
 typedef struct _UDisksMountMonitorClass UDisksMountMonitorClass;
 
 struct _UDisksMountMonitorClass
@@ -101,9 +142,27 @@ static guint signals[LAST_SIGNAL] = { 0 };
 G_DEFINE_TYPE (UDisksMountMonitor, udisks_mount_monitor, G_TYPE_OBJECT)
 
 static void udisks_mount_monitor_ensure (UDisksMountMonitor *monitor);
-static void udisks_mount_monitor_invalidate (UDisksMountMonitor *monitor);
+static void udisks_mount_monitor_update (UDisksMountMonitor  *monitor,
+                                         GList              **added,
+                                         GList              **removed);
 static void udisks_mount_monitor_constructed (GObject *object);
 
+static void
+mount_ref_free (MountRef *ref)
+{
+  g_free (ref->key);
+  g_object_unref (ref->mount);
+  g_slice_free (MountRef, ref);
+}
+
+static void
+mount_entry_free (MountEntry *entry)
+{
+  /* entry->ref is released by the monitor before the entry is freed */
+  g_free (entry->line);
+  g_slice_free (MountEntry, entry);
+}
+
 static void
 udisks_mount_monitor_finalize (GObject *object)
 {
@@ -119,8 +178,11 @@ udisks_mount_monitor_finalize (GObject *object)
   if (monitor->swaps_watch_source != NULL)
     g_source_destroy (monitor->swaps_watch_source);
 
-  g_list_foreach (monitor->mounts, (GFunc) g_object_unref, NULL);
-  g_list_free (monitor->mounts);
+  g_hash_table_unref (monitor->mountinfo_entries);
+  g_hash_table_unref (monitor->swaps_entries);
+  g_hash_table_unref (monitor->mounts_by_dev);
+  g_hash_table_unref (monitor->mounts_by_key);
+  g_mutex_clear (&monitor->lock);
 
   if (G_OBJECT_CLASS (udisks_mount_monitor_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_mount_monitor_parent_class)->finalize (object);
@@ -129,7 +191,23 @@ udisks_mount_monitor_finalize (GObject *object)
 static void
 udisks_mount_monitor_init (UDisksMountMonitor *monitor)
 {
-  monitor->mounts = NULL;
+  g_mutex_init (&monitor->lock);
+  monitor->mounts_by_key = g_hash_table_new_full (g_str_hash,
+                                                  g_str_equal,
+                                                  NULL, /* owned by the MountRef */
+                                                  (GDestroyNotify) mount_ref_free);
+  monitor->mounts_by_dev = g_hash_table_new_full (g_int64_hash,
+                                                  g_int64_equal,
+                                                  g_free,
+                                                  (GDestroyNotify) g_queue_free);
+  monitor->mountinfo_entries = g_hash_table_new_full (g_direct_hash,
+                                                      g_direct_equal,
+                                                      NULL,
+                                                      (GDestroyNotify) mount_entry_free);
+  monitor->swaps_entries = g_hash_table_new_full (g_str_hash,
+                                                  g_str_equal,
+                                                  g_free,
+                                                  (GDestroyNotify) mount_entry_free);
 }
 
 static void
@@ -185,71 +263,22 @@ udisks_mount_monitor_class_init (UDisksMountMonitorClass *klass)
                                                 UDISKS_TYPE_MOUNT);
 }
 
-static void
-diff_sorted_lists (GList *list1,
-                   GList *list2,
-                   GCompareFunc compare,
-                   GList **added,
-                   GList **removed)
-{
-  int order;
-
-  *added = *removed = NULL;
-
-  while (list1 != NULL && list2 != NULL)
-    {
-      order = (*compare) (list1->data, list2->data);
-      if (order < 0)
-        {
-          *removed = g_list_prepend (*removed, list1->data);
-          list1 = list1->next;
-        }
-      else if (order > 0)
-        {
-          *added = g_list_prepend (*added, list2->data);
-          list2 = list2->next;
-        }
-      else
-        { /* same item */
-          list1 = list1->next;
-          list2 = list2->next;
-        }
-    }
-
-  while (list1 != NULL)
-    {
-      *removed = g_list_prepend (*removed, list1->data);
-      list1 = list1->next;
-    }
-  while (list2 != NULL)
-    {
-      *added = g_list_prepend (*added, list2->data);
-      list2 = list2->next;
-    }
-}
-
 static void
 reload_mounts (UDisksMountMonitor *monitor)
 {
-  GList *old_mounts;
-  GList *cur_mounts;
   GList *added;
   GList *removed;
   GList *l;
 
-  udisks_mount_monitor_ensure (monitor);
-
-  old_mounts = g_list_copy (monitor->mounts);
-  g_list_foreach (old_mounts, (GFunc) g_object_ref, NULL);
+  added = NULL;
+  removed = NULL;
 
-  udisks_mount_monitor_invalidate (monitor);
+  g_mutex_lock (&monitor->lock);
+  /* the initial load is not reported as changes */
   udisks_mount_monitor_ensure (monitor);
-
-  cur_mounts = g_list_copy (monitor->mounts);
-
-  old_mounts = g_list_sort (old_mounts, (GCompareFunc) udisks_mount_compare);
-  cur_mounts = g_list_sort (cur_mounts, (GCompareFunc) udisks_mount_compare);
-  diff_sorted_lists (old_mounts, cur_mounts, (GCompareFunc) udisks_mount_compare, &added, &removed);
+  udisks_mount_monitor_update (monitor, &added, &removed);
+  /* don't hold the lock while emitting signals - handlers query the monitor */
+  g_mutex_unlock (&monitor->lock);
 
   for (l = removed; l != NULL; l = l->next)
     {
@@ -263,11 +292,8 @@ reload_mounts (UDisksMountMonitor *monitor)
       g_signal_emit (monitor, signals[MOUNT_ADDED_SIGNAL], 0, mount);
     }
 
-  g_list_foreach (old_mounts, (GFunc) g_object_unref, NULL);
-  g_list_free (old_mounts);
-  g_list_free (cur_mounts);
-  g_list_free (removed);
-  g_list_free (added);
+  g_list_free_full (removed, g_object_unref);
+  g_list_free_full (added, g_object_unref);
 }
 
 static gboolean
@@ -357,58 +383,245 @@ udisks_mount_monitor_new (void)
   return UDISKS_MOUNT_MONITOR (g_object_new (UDISKS_TYPE_MOUNT_MONITOR, NULL));
 }
 
-static void
-udisks_mount_monitor_invalidate (UDisksMountMonitor *monitor)
+/* called with lock held - returns the mounts for @dev, owned by @monitor */
+static GList *
+lookup_mounts_for_dev (UDisksMountMonitor *monitor,
+                       dev_t               dev)
 {
-  monitor->have_data = FALSE;
+  guint64 key = dev;
+  GQueue *mounts;
 
-  g_list_foreach (monitor->mounts, (GFunc) g_object_unref, NULL);
-  g_list_free (monitor->mounts);
-  monitor->mounts = NULL;
+  mounts = g_hash_table_lookup (monitor->mounts_by_dev, &key);
+  return mounts != NULL ? mounts->head : NULL;
 }
 
-static gboolean
-have_mount (UDisksMountMonitor *monitor,
-            dev_t               dev,
-            const gchar        *mount_point)
+/* called with lock held
+ *
+ * Returns the shared MountRef for the given mount, creating the
+ * UDisksMount instance (and adding a reference to it to @added, if
+ * not %NULL) only if no other line refers to the same mount.
+ */
+static MountRef *
+acquire_mount (UDisksMountMonitor  *monitor,
+               dev_t                dev,
+               const gchar         *mount_path,
+               UDisksMountType      type,
+               GList              **added)
 {
-  GList *l;
-  gboolean ret;
+  guint64 dev_key = dev;
+  MountRef *ref;
+  GQueue *mounts;
+  gchar *key;
+
+  key = g_strdup_printf ("%d:%u:%u:%s", type, major (dev), minor (dev), mount_path != NULL ? mount_path : "");
+  ref = g_hash_table_lookup (monitor->mounts_by_key, key);
+  if (ref != NULL)
+    {
+      g_free (key);
+      ref->users++;
+      goto out;
+    }
 
-  ret = FALSE;
+  ref = g_slice_new0 (MountRef);
+  ref->key = key;
+  ref->mount = _udisks_mount_new (dev, mount_path, type);
+  ref->users = 1;
+  g_hash_table_insert (monitor->mounts_by_key, ref->key, ref);
+  monitor->last_num_allocated++;
 
-  for (l = monitor->mounts; l != NULL; l = l->next)
+  mounts = g_hash_table_lookup (monitor->mounts_by_dev, &dev_key);
+  if (mounts == NULL)
     {
-      UDisksMount *mount = UDISKS_MOUNT (l->data);
-      if (udisks_mount_get_dev (mount) == dev &&
-          g_strcmp0 (udisks_mount_get_mount_path (mount), mount_point) == 0)
+      guint64 *new_key;
+
+      new_key = g_new (guint64, 1);
+      *new_key = dev_key;
+      mounts = g_queue_new ();
+      g_hash_table_insert (monitor->mounts_by_dev, new_key, mounts);
+    }
+  g_queue_push_tail (mounts, ref->mount);
+  ref->dev_link = mounts->tail;
+
+  if (added != NULL)
+    *added = g_list_prepend (*added, g_object_ref (ref->mount));
+
+ out:
+  return ref;
+}
+
+/* called with lock held
+ *
+ * Drops a user of @ref. If it was the last one, the UDisksMount
+ * instance is dropped as well and a reference to it is added to
+ * @removed, if not %NULL.
+ */
+static void
+release_mount (UDisksMountMonitor  *monitor,
+               MountRef            *ref,
+               GList              **removed)
+{
+  guint64 dev_key;
+  GQueue *mounts;
+
+  if (ref == NULL)
+    return;
+
+  g_assert (ref->users > 0);
+  if (--ref->users > 0)
+    return;
+
+  dev_key = udisks_mount_get_dev (ref->mount);
+  mounts = g_hash_table_lookup (monitor->mounts_by_dev, &dev_key);
+  g_assert (mounts != NULL);
+  g_queue_delete_link (mounts, ref->dev_link);
+  ref->dev_link = NULL;
+  if (g_queue_is_empty (mounts))
+    g_hash_table_remove (monitor->mounts_by_dev, &dev_key);
+
+  if (removed != NULL)
+    *removed = g_list_prepend (*removed, g_object_ref (ref->mount));
+
+  g_hash_table_remove (monitor->mounts_by_key, ref->key);
+}
+
+/* called with lock held - drops all entries not seen in the current update */
+static void
+prune_entries (UDisksMountMonitor  *monitor,
+               GHashTable          *entries,
+               GList              **removed)
+{
+  GHashTableIter iter;
+  MountEntry *entry;
+
+  g_hash_table_iter_init (&iter, entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+      if (entry->generation != monitor->generation)
         {
-          ret = TRUE;
-          break;
+          release_mount (monitor, entry->ref, removed);
+          g_hash_table_iter_remove (&iter);
         }
     }
-
-  return ret;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Parses a line from /proc/self/mountinfo - returns %FALSE if the line is not about a block device */
+static gboolean
+parse_mountinfo_line (const gchar  *line,
+                      dev_t        *out_dev,
+                      gchar       **out_mount_point)
+{
+  guint mount_id;
+  guint parent_id;
+  guint major, minor;
+  gchar encoded_root[PATH_MAX + 1];
+  gchar encoded_mount_point[PATH_MAX + 1];
+  dev_t dev;
+
+  if (sscanf (line,
+              "%u %u %u:%u " PATH_MAX_FMT " " PATH_MAX_FMT,
+              &mount_id,
+              &parent_id,
+              &major,
+              &minor,
+              encoded_root,
+              encoded_mount_point) != 6)
+    {
+      udisks_warning ("Error parsing line '%s'", line);
+      return FALSE;
+    }
+  encoded_root[sizeof encoded_root - 1] = '\0';
+  encoded_mount_point[sizeof encoded_mount_point - 1] = '\0';
+
+  /* Temporary work-around for btrfs, see
+   *
+   *  https://bugzilla.redhat.com/show_bug.cgi?id=495152#c31
+   *  http://article.gmane.org/gmane.comp.file-systems.btrfs/2851
+   *
+   * for details.
+   */
+  if (major == 0)
+    {
+      const gchar *sep;
+      sep = strstr (line, " - ");
+      if (sep != NULL)
+        {
+          gchar fstype[PATH_MAX + 1];
+          gchar mount_source[PATH_MAX + 1];
+          struct stat statbuf;
+
+          if (sscanf (sep + 3, PATH_MAX_FMT " " PATH_MAX_FMT, fstype, mount_source) != 2)
+            {
+              udisks_warning ("Error parsing things past - for '%s'", line);
+              return FALSE;
+            }
+          fstype[sizeof fstype - 1] = '\0';
+          mount_source[sizeof mount_source - 1] = '\0';
+
+          if (g_strcmp0 (fstype, "btrfs") != 0)
+            return FALSE;
+
+          if (!g_str_has_prefix (mount_source, "/dev/"))
+            return FALSE;
+
+          if (stat (mount_source, &statbuf) != 0)
+            {
+              udisks_warning ("Error statting %s: %m", mount_source);
+              return FALSE;
+            }
+
+          if (!S_ISBLK (statbuf.st_mode))
+            {
+              udisks_warning ("%s is not a block device", mount_source);
+              return FALSE;
+            }
+
+          dev = statbuf.st_rdev;
+        }
+      else
+        {
+          return FALSE;
+        }
+    }
+  else
+    {
+      dev = makedev (major, minor);
+    }
+
+  *out_dev = dev;
+  *out_mount_point = g_strcompress (encoded_mount_point);
+
+  return TRUE;
+}
+
+/* called with lock held
+ *
+ * Reads /proc/self/mountinfo line by line. Lines are keyed by their
+ * mount ID and only parsed if they are new or changed since the last
+ * time - unchanged lines are just marked as seen.
+ */
 static gboolean
 udisks_mount_monitor_get_mountinfo (UDisksMountMonitor  *monitor,
+                                    GList              **added,
+                                    GList              **removed,
                                     GError             **error)
 {
   gboolean ret;
-  gchar *contents;
-  gchar **lines;
-  guint n;
+  FILE *f;
+  gchar *line;
+  size_t line_size;
+  ssize_t len;
 
   ret = FALSE;
-  contents = NULL;
-  lines = NULL;
+  line = NULL;
+  line_size = 0;
 
-  if (!g_file_get_contents ("/proc/self/mountinfo", &contents, NULL, error))
+  f = fopen ("/proc/self/mountinfo", "re");
+  if (f == NULL)
     {
-      g_prefix_error (error, "Error reading /proc/self/mountinfo: ");
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Error reading /proc/self/mountinfo: %m");
       goto out;
     }
 
@@ -416,116 +629,80 @@ udisks_mount_monitor_get_mountinfo (UDisksMountMonitor  *monitor,
    *
    * Note that things like space are encoded as \020.
    */
-  lines = g_strsplit (contents, "\n", 0);
-  for (n = 0; lines[n] != NULL; n++)
+  while ((len = getline (&line, &line_size, f)) != -1)
     {
+      MountEntry *entry;
+      MountRef *ref;
       guint mount_id;
-      guint parent_id;
-      guint major, minor;
-      gchar encoded_root[PATH_MAX + 1];
-      gchar encoded_mount_point[PATH_MAX + 1];
+      gchar *endp;
       gchar *mount_point;
       dev_t dev;
 
-      if (strlen (lines[n]) == 0)
+      if (len > 0 && line[len - 1] == '\n')
+        line[--len] = '\0';
+      if (len == 0)
         continue;
 
-      if (sscanf (lines[n],
-                  "%u %u %u:%u " PATH_MAX_FMT " " PATH_MAX_FMT,
-                  &mount_id,
-                  &parent_id,
-                  &major,
-                  &minor,
-                  encoded_root,
-                  encoded_mount_point) != 6)
+      mount_id = strtoul (line, &endp, 10);
+      if (endp == line)
         {
-          udisks_warning ("Error parsing line '%s'", lines[n]);
+          udisks_warning ("Error parsing line '%s'", line);
           continue;
         }
-      encoded_root[sizeof encoded_root - 1] = '\0';
-      encoded_mount_point[sizeof encoded_mount_point - 1] = '\0';
-
-      /* Temporary work-around for btrfs, see
-       *
-       *  https://bugzilla.redhat.com/show_bug.cgi?id=495152#c31
-       *  http://article.gmane.org/gmane.comp.file-systems.btrfs/2851
-       *
-       * for details.
-       */
-      if (major == 0)
-        {
-          const gchar *sep;
-          sep = strstr (lines[n], " - ");
-          if (sep != NULL)
-            {
-              gchar fstype[PATH_MAX + 1];
-              gchar mount_source[PATH_MAX + 1];
-              struct stat statbuf;
-
-              if (sscanf (sep + 3, PATH_MAX_FMT " " PATH_MAX_FMT, fstype, mount_source) != 2)
-                {
-                  udisks_warning ("Error parsing things past - for '%s'", lines[n]);
-                  continue;
-                }
-              fstype[sizeof fstype - 1] = '\0';
-              mount_source[sizeof mount_source - 1] = '\0';
-
-              if (g_strcmp0 (fstype, "btrfs") != 0)
-                continue;
-
-              if (!g_str_has_prefix (mount_source, "/dev/"))
-                continue;
-
-              if (stat (mount_source, &statbuf) != 0)
-                {
-                  udisks_warning ("Error statting %s: %m", mount_source);
-                  continue;
-                }
-
-              if (!S_ISBLK (statbuf.st_mode))
-                {
-                  udisks_warning ("%s is not a block device", mount_source);
-                  continue;
-                }
-
-              dev = statbuf.st_rdev;
-            }
-          else
-            {
-              continue;
-            }
-        }
-      else
+
+      entry = g_hash_table_lookup (monitor->mountinfo_entries, GUINT_TO_POINTER (mount_id));
+      if (entry != NULL && g_strcmp0 (entry->line, line) == 0)
         {
-          dev = makedev (major, minor);
+          entry->generation = monitor->generation;
+          continue;
         }
 
-      mount_point = g_strcompress (encoded_mount_point);
+      monitor->last_num_parsed++;
 
-      /* TODO: we can probably use a hash table or something if this turns out to be slow */
-      if (!have_mount (monitor, dev, mount_point))
+      /* acquire the new mount before releasing the old one so a mount
+       * whose line changed in unrelated ways is reported as neither
+       * removed nor added
+       */
+      ref = NULL;
+      mount_point = NULL;
+      if (parse_mountinfo_line (line, &dev, &mount_point))
+        ref = acquire_mount (monitor, dev, mount_point, UDISKS_MOUNT_TYPE_FILESYSTEM, added);
+      g_free (mount_point);
+
+      if (entry != NULL)
         {
-          UDisksMount *mount;
-          mount = _udisks_mount_new (dev, mount_point, UDISKS_MOUNT_TYPE_FILESYSTEM);
-          monitor->mounts = g_list_prepend (monitor->mounts, mount);
+          release_mount (monitor, entry->ref, removed);
+          g_free (entry->line);
         }
-
-      g_free (mount_point);
+      else
+        {
+          entry = g_slice_new0 (MountEntry);
+          g_hash_table_insert (monitor->mountinfo_entries, GUINT_TO_POINTER (mount_id), entry);
+        }
+      entry->line = g_strdup (line);
+      entry->ref = ref;
+      entry->generation = monitor->generation;
     }
 
+  prune_entries (monitor, monitor->mountinfo_entries, removed);
+
   ret = TRUE;
 
  out:
-  g_free (contents);
-  g_strfreev (lines);
+  if (f != NULL)
+    fclose (f);
+  free (line);
 
   return ret;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* called with lock held - swap areas are keyed by their file name */
 static gboolean
 udisks_mount_monitor_get_swaps (UDisksMountMonitor  *monitor,
+                                GList              **added,
+                                GList              **removed,
                                 GError             **error)
 {
   gboolean ret;
@@ -543,6 +720,7 @@ udisks_mount_monitor_get_swaps (UDisksMountMonitor  *monitor,
       if (local_error->domain == G_FILE_ERROR && local_error->code == G_FILE_ERROR_NOENT)
         {
           g_clear_error (&local_error);
+          prune_entries (monitor, monitor->swaps_entries, removed);
           ret = TRUE;
           goto out;
         }
@@ -558,7 +736,7 @@ udisks_mount_monitor_get_swaps (UDisksMountMonitor  *monitor,
     {
       gchar filename[PATH_MAX + 1];
       struct stat statbuf;
-      dev_t dev;
+      MountEntry *entry;
 
       /* skip first line of explanatory text */
       if (n == 0)
@@ -574,22 +752,29 @@ udisks_mount_monitor_get_swaps (UDisksMountMonitor  *monitor,
         }
       filename[sizeof filename - 1] = '\0';
 
-      if (stat (filename, &statbuf) != 0)
+      entry = g_hash_table_lookup (monitor->swaps_entries, filename);
+      if (entry != NULL)
         {
-          udisks_warning ("Error statting %s: %m", filename);
+          entry->generation = monitor->generation;
           continue;
         }
 
-      dev = statbuf.st_rdev;
+      monitor->last_num_parsed++;
 
-      if (!have_mount (monitor, dev, NULL))
+      if (stat (filename, &statbuf) != 0)
         {
-          UDisksMount *mount;
-          mount = _udisks_mount_new (dev, NULL, UDISKS_MOUNT_TYPE_SWAP);
-          monitor->mounts = g_list_prepend (monitor->mounts, mount);
+          udisks_warning ("Error statting %s: %m", filename);
+          continue;
         }
+
+      entry = g_slice_new0 (MountEntry);
+      entry->ref = acquire_mount (monitor, statbuf.st_rdev, NULL, UDISKS_MOUNT_TYPE_SWAP, added);
+      entry->generation = monitor->generation;
+      g_hash_table_insert (monitor->swaps_entries, g_strdup (filename), entry);
     }
 
+  prune_entries (monitor, monitor->swaps_entries, removed);
+
   ret = TRUE;
 
  out:
@@ -601,16 +786,27 @@ udisks_mount_monitor_get_swaps (UDisksMountMonitor  *monitor,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* called with lock held
+ *
+ * Brings the monitor up to date with mountinfo and swaps. References
+ * to UDisksMount instances that appeared or went away are added to
+ * @added and @removed, if not %NULL.
+ */
 static void
-udisks_mount_monitor_ensure (UDisksMountMonitor *monitor)
+udisks_mount_monitor_update (UDisksMountMonitor  *monitor,
+                             GList              **added,
+                             GList              **removed)
 {
   GError *error;
+  gint64 time_start;
 
-  if (monitor->have_data)
-    goto out;
+  time_start = g_get_monotonic_time ();
+  monitor->generation++;
+  monitor->last_num_parsed = 0;
+  monitor->last_num_allocated = 0;
 
   error = NULL;
-  if (!udisks_mount_monitor_get_mountinfo (monitor, &error))
+  if (!udisks_mount_monitor_get_mountinfo (monitor, added, removed, &error))
     {
       udisks_warning ("Error getting mounts: %s (%s, %d)",
                       error->message, g_quark_to_string (error->domain), error->code);
@@ -618,13 +814,31 @@ udisks_mount_monitor_ensure (UDisksMountMonitor *monitor)
     }
 
   error = NULL;
-  if (!udisks_mount_monitor_get_swaps (monitor, &error))
+  if (!udisks_mount_monitor_get_swaps (monitor, added, removed, &error))
     {
       udisks_warning ("Error getting swaps: %s (%s, %d)",
                       error->message, g_quark_to_string (error->domain), error->code);
       g_clear_error (&error);
     }
 
+  monitor->last_update_usec = g_get_monotonic_time () - time_start;
+  monitor->total_num_allocated += monitor->last_num_allocated;
+
+  udisks_debug ("Updated mounts in %" G_GINT64_FORMAT " usec (%u lines parsed, %u mounts allocated, %u mounts total)",
+                monitor->last_update_usec,
+                monitor->last_num_parsed,
+                monitor->last_num_allocated,
+                g_hash_table_size (monitor->mounts_by_key));
+}
+
+/* called with lock held */
+static void
+udisks_mount_monitor_ensure (UDisksMountMonitor *monitor)
+{
+  if (monitor->have_data)
+    goto out;
+
+  udisks_mount_monitor_update (monitor, NULL, NULL);
   monitor->have_data = TRUE;
 
  out:
@@ -651,17 +865,11 @@ udisks_mount_monitor_get_mounts_for_dev (UDisksMountMonitor *monitor,
 
   ret = NULL;
 
+  g_mutex_lock (&monitor->lock);
   udisks_mount_monitor_ensure (monitor);
-
-  for (l = monitor->mounts; l != NULL; l = l->next)
-    {
-      UDisksMount *mount = UDISKS_MOUNT (l->data);
-
-      if (udisks_mount_get_dev (mount) == dev)
-        {
-          ret = g_list_prepend (ret, g_object_ref (mount));
-        }
-    }
+  for (l = lookup_mounts_for_dev (monitor, dev); l != NULL; l = l->next)
+    ret = g_list_prepend (ret, g_object_ref (l->data));
+  g_mutex_unlock (&monitor->lock);
 
   /* Sort the list to ensure that shortest mount paths appear first */
   ret = g_list_sort (ret, (GCompareFunc) udisks_mount_compare);
@@ -685,23 +893,58 @@ udisks_mount_monitor_is_dev_in_use (UDisksMountMonitor  *monitor,
                                     UDisksMountType     *out_type)
 {
   gboolean ret;
-  GList *l;
+  GList *mounts;
 
   ret = FALSE;
+
+  g_mutex_lock (&monitor->lock);
   udisks_mount_monitor_ensure (monitor);
-  for (l = monitor->mounts; l != NULL; l = l->next)
+  mounts = lookup_mounts_for_dev (monitor, dev);
+  if (mounts != NULL)
     {
-      UDisksMount *mount = UDISKS_MOUNT (l->data);
-
-      if (udisks_mount_get_dev (mount) == dev)
-        {
-          if (out_type != NULL)
-            *out_type = udisks_mount_get_mount_type (mount);
-          ret = TRUE;
-          goto out;
-        }
+      if (out_type != NULL)
+        *out_type = udisks_mount_get_mount_type (UDISKS_MOUNT (mounts->data));
+      ret = TRUE;
     }
+  g_mutex_unlock (&monitor->lock);
 
- out:
   return ret;
 }
+
+/**
+ * udisks_mount_monitor_get_stats:
+ * @monitor: A #UDisksMountMonitor.
+ * @out_update_usec: (out allow-none): Return location for the time spent on the last update, in microseconds, or %NULL.
+ * @out_num_parsed: (out allow-none): Return location for the number of new or changed lines parsed in the last update or %NULL.
+ * @out_num_allocated: (out allow-none): Return location for the number of #UDisksMount objects allocated in the last update or %NULL.
+ * @out_total_num_allocated: (out allow-none): Return location for the number of #UDisksMount objects allocated since @monitor was created or %NULL.
+ *
+ * Gets statistics about how much work @monitor did when it last
+ * re-read <literal>/proc/self/mountinfo</literal> and
+ * <literal>/proc/swaps</literal>. Lines that did not change since
+ * the previous update are not parsed and existing #UDisksMount
+ * objects are reused for them.
+ *
+ * This is intended for debugging and benchmarking.
+ */
+void
+udisks_mount_monitor_get_stats (UDisksMountMonitor *monitor,
+                                gint64             *out_update_usec,
+                                guint              *out_num_parsed,
+                                guint              *out_num_allocated,
+                                guint64            *out_total_num_allocated)
+{
+  g_return_if_fail (UDISKS_IS_MOUNT_MONITOR (monitor));
+
+  g_mutex_lock (&monitor->lock);
+  udisks_mount_monitor_ensure (monitor);
+  if (out_update_usec != NULL)
+    *out_update_usec = monitor->last_update_usec;
+  if (out_num_parsed != NULL)
+    *out_num_parsed = monitor->last_num_parsed;
+  if (out_num_allocated != NULL)
+    *out_num_allocated = monitor->last_num_allocated;
+  if (out_total_num_allocated != NULL)
+    *out_total_num_allocated = monitor->total_num_allocated;
+  g_mutex_unlock (&monitor->lock);
+}
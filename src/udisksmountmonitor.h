@@ -36,6 +36,11 @@ GList               *udisks_mount_monitor_get_mounts_for_dev (UDisksMountMonitor
 gboolean             udisks_mount_monitor_is_dev_in_use      (UDisksMountMonitor  *monitor,
                                                               dev_t                dev,
                                                               UDisksMountType     *out_type);
+void                 udisks_mount_monitor_get_stats          (UDisksMountMonitor  *monitor,
+                                                              gint64              *out_update_usec,
+                                                              guint               *out_num_parsed,
+                                                              guint               *out_num_allocated,
+                                                              guint64             *out_total_num_allocated);
 
 G_END_DECLS
 
@@ -35,6 +35,7 @@
 #include "udisks-daemon-marshal.h"
 #include "udisksdaemon.h"
 #include "udisksdaemonutil.h"
+#include "udiskstrace.h"
 
 /**
  * SECTION:udisksspawnedjob
@@ -370,6 +371,7 @@ child_watch_cb (GPid     pid,
     }
 
   //g_debug ("helper(pid %5d): completed with exit code %d\n", job->child_pid, WEXITSTATUS (status));
+  UDISKS_TRACE3 (spawned_job_exit, job->command_line, (gint) pid, status);
 
   /* take a reference so it's safe for a signal-handler to release the last one */
   g_object_ref (job);
@@ -976,6 +978,8 @@ void udisks_spawned_job_start (UDisksSpawnedJob *job)
       goto out;
     }
 
+  UDISKS_TRACE2 (spawned_job_spawn, job->command_line, (gint) job->child_pid);
+
   job->child_watch_source = g_child_watch_source_new (job->child_pid);
   g_source_set_callback (job->child_watch_source, (GSourceFunc) child_watch_cb, job, NULL);
   g_source_attach (job->child_watch_source, job->main_context);
@@ -37,6 +37,7 @@
 #include "udiskslogging.h"
 #include "udiskslinuxprovider.h"
 #include "udisksdaemonutil.h"
+#include "udisksmetrics.h"
 
 /**
  * SECTION:udisksstate
@@ -122,6 +123,11 @@
  *     </tbody>
  *   </tgroup>
  * </table>
+ * Changes to these files are batched - a file is replaced
+ * atomically shortly after the first of a series of changes to it
+ * so e.g. mounting lots of filesystems at once doesn't rewrite the
+ * file for each of them. The files are mapped into memory when read.
+ *
  * Cleaning up is implemented by running a thread (to ensure that
  * actions are serialized) that checks all data in the files mentioned
  * above and cleans up the entry in question by e.g. unmounting a
@@ -136,6 +142,17 @@
  * to the attention of the system administrator.
  */
 
+/* Changes made while a write is in progress are written out
+ * together by the next one (group commit) - the callers of
+ * udisks_state_set() share a FlushBatch and all get its result
+ */
+typedef struct
+{
+  gint ref_count;
+  gboolean done;
+  GError *error;
+} FlushBatch;
+
 /**
  * UDisksState:
  *
@@ -154,8 +171,34 @@ struct _UDisksState
   GMainContext *context;
   GMainLoop *loop;
 
-  /* key-path -> GVariant */
+  /* protects the members below - separate from @lock since
+   * udisks_state_flush() writes out files without holding @lock
+   */
+  GMutex store_lock;
+  /* key -> GVariant, the current value of each key */
   GHashTable *cache;
+  /* set of keys whose value has not been written out yet */
+  GHashTable *dirty;
+  /* key -> WriteStats */
+  GHashTable *write_stats;
+
+  /* protected by @lock, see udisks_state_set() */
+  GCond flush_cond;
+  /* the batch the keys in @dirty will be written out with */
+  FlushBatch *pending_batch;
+  /* whether udisks_state_flush() is writing out files */
+  gboolean flushing;
+
+  /* protects the pending check request below - separate from @lock
+   * since that is held for the whole duration of a check
+   */
+  GMutex check_lock;
+  /* set of dev_t (as guint64) that the pending check should look at */
+  GHashTable *check_devs;
+  /* whether the pending check should look at all entries */
+  gboolean check_all;
+  /* whether a check has been queued but not yet started */
+  gboolean check_scheduled;
 };
 
 typedef struct _UDisksStateClass UDisksStateClass;
@@ -171,16 +214,27 @@ enum
   PROP_DAEMON
 };
 
-static void      udisks_state_check_in_thread     (UDisksState          *state);
+typedef struct
+{
+  guint64 num_sets;
+  guint64 num_writes;
+} WriteStats;
+
+static void      udisks_state_check_in_thread     (UDisksState          *state,
+                                                   GHashTable           *devs);
 static void      udisks_state_check_mounted_fs    (UDisksState          *state,
+                                                   GHashTable           *devs,
                                                    GArray               *devs_to_clean);
 static void      udisks_state_check_unlocked_luks (UDisksState          *state,
+                                                   GHashTable           *devs,
                                                    gboolean              check_only,
                                                    GArray               *devs_to_clean);
 static void      udisks_state_check_loop          (UDisksState          *state,
+                                                   GHashTable           *devs,
                                                    gboolean              check_only,
                                                    GArray               *devs_to_clean);
 static void      udisks_state_check_mdraid        (UDisksState          *state,
+                                                   GHashTable           *devs,
                                                    gboolean              check_only,
                                                    GArray               *devs_to_clean);
 static GVariant *udisks_state_get                 (UDisksState          *state,
@@ -192,6 +246,7 @@ static gboolean  udisks_state_set                 (UDisksState          *state,
                                                    const GVariantType   *type,
                                                    GVariant             *value,
                                                    GError              **error);
+static void      udisks_state_flush               (UDisksState          *state);
 
 G_DEFINE_TYPE (UDisksState, udisks_state, G_TYPE_OBJECT);
 
@@ -199,7 +254,12 @@ static void
 udisks_state_init (UDisksState *state)
 {
   g_mutex_init (&state->lock);
+  g_mutex_init (&state->store_lock);
+  g_cond_init (&state->flush_cond);
   state->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref);
+  state->dirty = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  state->write_stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_mutex_init (&state->check_lock);
 }
 
 static void
@@ -207,8 +267,20 @@ udisks_state_finalize (GObject *object)
 {
   UDisksState *state = UDISKS_STATE (object);
 
+  /* make sure pending changes are not lost */
+  g_mutex_lock (&state->lock);
+  udisks_state_flush (state);
+  g_mutex_unlock (&state->lock);
+
   g_hash_table_unref (state->cache);
+  g_hash_table_unref (state->dirty);
+  g_hash_table_unref (state->write_stats);
+  g_mutex_clear (&state->store_lock);
+  g_cond_clear (&state->flush_cond);
   g_mutex_clear (&state->lock);
+  if (state->check_devs != NULL)
+    g_hash_table_unref (state->check_devs);
+  g_mutex_clear (&state->check_lock);
 
   G_OBJECT_CLASS (udisks_state_parent_class)->finalize (object);
 }
@@ -359,16 +431,51 @@ udisks_state_stop_cleanup (UDisksState *state)
   thread = state->thread;
   g_main_loop_quit (state->loop);
   g_thread_join (thread);
+
+  /* we're likely about to exit - don't leave changes unwritten */
+  g_mutex_lock (&state->lock);
+  udisks_state_flush (state);
+  g_mutex_unlock (&state->lock);
 }
 
 static gboolean
 udisks_state_check_func (gpointer user_data)
 {
   UDisksState *state = UDISKS_STATE (user_data);
-  udisks_state_check_in_thread (state);
+  GHashTable *devs;
+  gboolean check_all;
+
+  /* take everything requested so far - requests coming in while
+   * checking are merged into the next pass
+   */
+  g_mutex_lock (&state->check_lock);
+  devs = state->check_devs;
+  check_all = state->check_all;
+  state->check_devs = NULL;
+  state->check_all = FALSE;
+  state->check_scheduled = FALSE;
+  g_mutex_unlock (&state->check_lock);
+
+  udisks_state_check_in_thread (state, check_all ? NULL : devs);
+
+  if (devs != NULL)
+    g_hash_table_unref (devs);
   return FALSE;
 }
 
+/* called with check_lock held */
+static void
+udisks_state_schedule_check (UDisksState *state)
+{
+  if (state->check_scheduled)
+    return;
+
+  state->check_scheduled = TRUE;
+  g_main_context_invoke (state->context,
+                         udisks_state_check_func,
+                         state);
+}
+
 /**
  * udisks_state_check:
  * @state: A #UDisksState.
@@ -383,9 +490,49 @@ udisks_state_check (UDisksState *state)
   g_return_if_fail (UDISKS_IS_STATE (state));
   g_return_if_fail (state->thread != NULL);
 
-  g_main_context_invoke (state->context,
-                         udisks_state_check_func,
-                         state);
+  g_mutex_lock (&state->check_lock);
+  state->check_all = TRUE;
+  udisks_state_schedule_check (state);
+  g_mutex_unlock (&state->check_lock);
+}
+
+/**
+ * udisks_state_check_device:
+ * @state: A #UDisksState.
+ * @dev: The #dev_t of a device that changed or went away.
+ *
+ * Like udisks_state_check() but only checks entries referring to
+ * @dev, e.g. a mounted filesystem on it, a LUKS device backed by
+ * it or a loop device backed by a file on it (as well as entries
+ * for devices that would be cleaned up as a consequence).
+ *
+ * Requests made before the clean-up thread gets around to handling
+ * them are merged into a single check.
+ *
+ * This can be called from any thread and will not block the calling thread.
+ */
+void
+udisks_state_check_device (UDisksState *state,
+                           dev_t        dev)
+{
+  guint64 key = dev;
+
+  g_return_if_fail (UDISKS_IS_STATE (state));
+  g_return_if_fail (state->thread != NULL);
+
+  g_mutex_lock (&state->check_lock);
+  if (!state->check_all)
+    {
+      guint64 *new_key;
+
+      if (state->check_devs == NULL)
+        state->check_devs = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+      new_key = g_new (guint64, 1);
+      *new_key = key;
+      g_hash_table_add (state->check_devs, new_key);
+    }
+  udisks_state_schedule_check (state);
+  g_mutex_unlock (&state->check_lock);
 }
 
 /**
@@ -405,57 +552,130 @@ udisks_state_get_daemon (UDisksState *state)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* must be called from state thread */
+/* returns TRUE if @dev is in @devs or if @devs is %NULL (meaning all devices) */
+static gboolean
+dev_is_relevant (GHashTable *devs,
+                 guint64     dev)
+{
+  return devs == NULL || g_hash_table_contains (devs, &dev);
+}
+
+/* returns TRUE if the entry keyed by a #dev_t, with the #dev_t given
+ * by @details_key in its details also referring to it, is relevant
+ */
+static gboolean
+dev_entry_is_relevant (GVariant    *value,
+                       GHashTable  *devs,
+                       const gchar *details_key)
+{
+  guint64 dev;
+  GVariant *details;
+  gboolean ret;
+
+  if (devs == NULL)
+    return TRUE;
+
+  g_variant_get (value, "{t@a{sv}}", &dev, &details);
+  ret = dev_is_relevant (devs, dev);
+  if (!ret && details_key != NULL)
+    {
+      guint64 other_dev;
+      /* entries lacking the detail are invalid - check them to get them cleaned up */
+      if (!g_variant_lookup (details, details_key, "t", &other_dev) || dev_is_relevant (devs, other_dev))
+        ret = TRUE;
+    }
+  g_variant_unref (details);
+
+  return ret;
+}
+
+/* must be called from state thread
+ *
+ * If @devs is not %NULL, only entries referring to the #dev_t values
+ * in it are checked.
+ */
 static void
-udisks_state_check_in_thread (UDisksState *state)
+udisks_state_check_in_thread (UDisksState *state,
+                              GHashTable  *devs)
 {
   GArray *devs_to_clean;
+  guint n;
+  gint64 time_start;
 
   g_mutex_lock (&state->lock);
 
+  time_start = g_get_monotonic_time ();
+
   /* We have to do a two-stage clean-up since fake block devices
    * can't be stopped if they are in use
    */
 
-  udisks_info ("Cleanup check start");
+  if (devs == NULL)
+    udisks_info ("Cleanup check start");
+  else
+    udisks_debug ("Cleanup check start (%u devices)", g_hash_table_size (devs));
 
   /* First go through all block devices we might tear down
    * but only check + record devices marked for cleaning
    */
   devs_to_clean = g_array_new (FALSE, FALSE, sizeof (dev_t));
   udisks_state_check_unlocked_luks (state,
+                                    devs,
                                     TRUE, /* check_only */
                                     devs_to_clean);
   udisks_state_check_loop (state,
+                           devs,
                            TRUE, /* check_only */
                            devs_to_clean);
 
   udisks_state_check_mdraid (state,
+                             devs,
                              TRUE, /* check_only */
                              devs_to_clean);
 
+  /* The devices we intend to clean may have filesystems mounted that
+   * are not on any of the devices we were asked to look at
+   */
+  if (devs != NULL)
+    {
+      for (n = 0; n < devs_to_clean->len; n++)
+        {
+          guint64 *dev = g_new (guint64, 1);
+          *dev = g_array_index (devs_to_clean, dev_t, n);
+          g_hash_table_add (devs, dev);
+        }
+    }
+
   /* Then go through all mounted filesystems and pass the
    * devices that we intend to clean...
    */
-  udisks_state_check_mounted_fs (state, devs_to_clean);
+  udisks_state_check_mounted_fs (state, devs, devs_to_clean);
 
   /* Then go through all block devices and clear them up
    * ... for real this time
    */
   udisks_state_check_unlocked_luks (state,
+                                    devs,
                                     FALSE, /* check_only */
                                     NULL);
   udisks_state_check_loop (state,
+                           devs,
                            FALSE, /* check_only */
                            NULL);
 
   udisks_state_check_mdraid (state,
+                             devs,
                              FALSE, /* check_only */
                              NULL);
 
   g_array_unref (devs_to_clean);
 
-  udisks_info ("Cleanup check end");
+  udisks_metrics_add_since (udisks_daemon_get_metrics (state->daemon), "state-cleanup", time_start);
+
+  if (devs == NULL)
+    udisks_info ("Cleanup check end");
+  else
+    udisks_debug ("Cleanup check end");
 
   g_mutex_unlock (&state->lock);
 }
@@ -764,9 +984,30 @@ udisks_state_check_mounted_fs_entry (UDisksState  *state,
   return keep;
 }
 
+/* returns TRUE if the mounted-fs entry refers to a device in @devs */
+static gboolean
+mounted_fs_entry_is_relevant (GVariant   *value,
+                              GHashTable *devs)
+{
+  GVariant *details;
+  guint64 block_device;
+  gboolean ret;
+
+  if (devs == NULL)
+    return TRUE;
+
+  g_variant_get (value, "{&s@a{sv}}", NULL, &details);
+  /* entries lacking the block-device are invalid - check them to get them cleaned up */
+  ret = !g_variant_lookup (details, "block-device", "t", &block_device) || dev_is_relevant (devs, block_device);
+  g_variant_unref (details);
+
+  return ret;
+}
+
 /* called with mutex->lock held */
 static void
 udisks_state_check_mounted_fs (UDisksState *state,
+                               GHashTable  *devs,
                                GArray      *devs_to_clean)
 {
   gboolean changed;
@@ -800,7 +1041,8 @@ udisks_state_check_mounted_fs (UDisksState *state,
       g_variant_iter_init (&iter, value);
       while ((child = g_variant_iter_next_value (&iter)) != NULL)
         {
-          if (udisks_state_check_mounted_fs_entry (state, child, devs_to_clean))
+          if (!mounted_fs_entry_is_relevant (child, devs) ||
+              udisks_state_check_mounted_fs_entry (state, child, devs_to_clean))
             g_variant_builder_add_value (&builder, child);
           else
             changed = TRUE;
@@ -1233,6 +1475,7 @@ udisks_state_check_unlocked_luks_entry (UDisksState  *state,
 /* called with mutex->lock held */
 static void
 udisks_state_check_unlocked_luks (UDisksState *state,
+                                  GHashTable  *devs,
                                   gboolean     check_only,
                                   GArray      *devs_to_clean)
 {
@@ -1267,7 +1510,8 @@ udisks_state_check_unlocked_luks (UDisksState *state,
       g_variant_iter_init (&iter, value);
       while ((child = g_variant_iter_next_value (&iter)) != NULL)
         {
-          if (udisks_state_check_unlocked_luks_entry (state, child, check_only, devs_to_clean))
+          if (!dev_entry_is_relevant (child, devs, "crypto-device") ||
+              udisks_state_check_unlocked_luks_entry (state, child, check_only, devs_to_clean))
             g_variant_builder_add_value (&builder, child);
           else
             changed = TRUE;
@@ -1610,8 +1854,37 @@ udisks_state_check_loop_entry (UDisksState  *state,
   return keep;
 }
 
+/* returns TRUE if the loop entry refers to a device in @devs */
+static gboolean
+loop_entry_is_relevant (GVariant   *value,
+                        GHashTable *devs)
+{
+  const gchar *loop_device;
+  GVariant *details;
+  guint64 backing_file_device;
+  struct stat statbuf;
+  gboolean ret;
+
+  if (devs == NULL)
+    return TRUE;
+
+  g_variant_get (value, "{&s@a{sv}}", &loop_device, &details);
+  /* if the device file is gone, the loop device is gone as well */
+  if (stat (loop_device, &statbuf) != 0 || dev_is_relevant (devs, statbuf.st_rdev))
+    ret = TRUE;
+  else if (g_variant_lookup (details, "backing-file-device", "t", &backing_file_device) &&
+           backing_file_device != 0 && dev_is_relevant (devs, backing_file_device))
+    ret = TRUE;
+  else
+    ret = FALSE;
+  g_variant_unref (details);
+
+  return ret;
+}
+
 static void
 udisks_state_check_loop (UDisksState *state,
+                         GHashTable  *devs,
                          gboolean     check_only,
                          GArray      *devs_to_clean)
 {
@@ -1646,7 +1919,8 @@ udisks_state_check_loop (UDisksState *state,
       g_variant_iter_init (&iter, value);
       while ((child = g_variant_iter_next_value (&iter)) != NULL)
         {
-          if (udisks_state_check_loop_entry (state, child, check_only, devs_to_clean))
+          if (!loop_entry_is_relevant (child, devs) ||
+              udisks_state_check_loop_entry (state, child, check_only, devs_to_clean))
             g_variant_builder_add_value (&builder, child);
           else
             changed = TRUE;
@@ -1958,6 +2232,7 @@ udisks_state_check_mdraid_entry (UDisksState  *state,
 
 static void
 udisks_state_check_mdraid (UDisksState *state,
+                           GHashTable  *devs,
                            gboolean     check_only,
                            GArray      *devs_to_clean)
 {
@@ -1992,7 +2267,8 @@ udisks_state_check_mdraid (UDisksState *state,
       g_variant_iter_init (&iter, value);
       while ((child = g_variant_iter_next_value (&iter)) != NULL)
         {
-          if (udisks_state_check_mdraid_entry (state, child, check_only, devs_to_clean))
+          if (!dev_entry_is_relevant (child, devs, NULL) ||
+              udisks_state_check_mdraid_entry (state, child, check_only, devs_to_clean))
             g_variant_builder_add_value (&builder, child);
           else
             changed = TRUE;
@@ -2213,6 +2489,34 @@ udisks_state_has_mdraid (UDisksState   *state,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Returns the file for @key, free with g_free() */
+static gchar *
+get_path_for_key (const gchar *key)
+{
+#ifdef HAVE_FHS_MEDIA
+  /* /media usually isn't on a tmpfs, so we need to make this persistant */
+  if (strcmp (key, "mounted-fs") == 0)
+    return g_strdup_printf (PACKAGE_LOCALSTATE_DIR "/lib/udisks2/%s", key);
+#endif
+  return g_strdup_printf ("/run/udisks2/%s", key);
+}
+
+/* called with store_lock held */
+static WriteStats *
+get_write_stats (UDisksState *state,
+                 const gchar *key)
+{
+  WriteStats *stats;
+
+  stats = g_hash_table_lookup (state->write_stats, key);
+  if (stats == NULL)
+    {
+      stats = g_new0 (WriteStats, 1);
+      g_hash_table_insert (state->write_stats, g_strdup (key), stats);
+    }
+  return stats;
+}
+
 static GVariant *
 udisks_state_get (UDisksState           *state,
                   const gchar           *key,
@@ -2221,42 +2525,34 @@ udisks_state_get (UDisksState           *state,
 {
   gchar *path = NULL;
   GVariant *ret = NULL;
-  gchar *contents = NULL;
+  GMappedFile *mapped_file = NULL;
+  GBytes *bytes = NULL;
   GError *local_error = NULL;
-  gsize length = 0;
 
   g_return_val_if_fail (UDISKS_IS_STATE (state), NULL);
   g_return_val_if_fail (key != NULL, NULL);
   g_return_val_if_fail (g_variant_type_is_definite (type), NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-  /* TODO:
-   *
-   * - could use a cache here to avoid loading files all the time
-   * - could also mmap the file
-   */
-
-#ifdef HAVE_FHS_MEDIA
-  /* /media usually isn't on a tmpfs, so we need to make this persistant */
-  if (strcmp (key, "mounted-fs") == 0)
-    path = g_strdup_printf (PACKAGE_LOCALSTATE_DIR "/lib/udisks2/%s", key);
-  else
-#endif
-    path = g_strdup_printf ("/run/udisks2/%s", key);
-
+  g_mutex_lock (&state->store_lock);
 
-  /* see if it's already in the cache */
-  ret = g_hash_table_lookup (state->cache, path);
+  /* see if it's already in the cache - this is always the case once
+   * the key has been set, the file might not have been written yet
+   */
+  ret = g_hash_table_lookup (state->cache, key);
   if (ret != NULL)
     {
       g_variant_ref (ret);
       goto out;
     }
 
-  if (!g_file_get_contents (path,
-                            &contents,
-                            &length,
-                            &local_error))
+  path = get_path_for_key (key);
+
+  /* map the file instead of reading it - the file is only ever
+   * replaced (never modified in place) so the mapping stays valid
+   */
+  mapped_file = g_mapped_file_new (path, FALSE, &local_error);
+  if (mapped_file == NULL)
     {
       if (local_error->domain == G_FILE_ERROR && local_error->code == G_FILE_ERROR_NOENT)
         {
@@ -2268,22 +2564,149 @@ udisks_state_get (UDisksState           *state,
       goto out;
     }
 
-  ret = g_variant_new_from_data (type,
-                                 (gconstpointer) contents,
-                                 length,
-                                 FALSE,
-                                 g_free,
-                                 contents);
+  bytes = g_mapped_file_get_bytes (mapped_file);
+  ret = g_variant_new_from_bytes (type, bytes, FALSE);
   g_variant_ref_sink (ret);
 
-  contents = NULL; /* ownership transfered to the returned GVariant */
+  g_hash_table_insert (state->cache, g_strdup (key), g_variant_ref (ret));
 
  out:
-  g_free (contents);
+  g_mutex_unlock (&state->store_lock);
+  if (bytes != NULL)
+    g_bytes_unref (bytes);
+  if (mapped_file != NULL)
+    g_mapped_file_unref (mapped_file);
   g_free (path);
   return ret;
 }
 
+static FlushBatch *
+flush_batch_ref (FlushBatch *batch)
+{
+  batch->ref_count++;
+  return batch;
+}
+
+static void
+flush_batch_unref (FlushBatch *batch)
+{
+  if (--batch->ref_count > 0)
+    return;
+  if (batch->error != NULL)
+    g_error_free (batch->error);
+  g_slice_free (FlushBatch, batch);
+}
+
+/* Writes out all keys changed since the last flush and completes the
+ * pending batch with the first error, if any. Each file is replaced
+ * atomically so a crash never leaves a partially written file behind.
+ *
+ * Must be called with @lock held. The lock is released while writing
+ * so other threads can make changes for the next batch meanwhile.
+ */
+static void
+udisks_state_flush (UDisksState *state)
+{
+  GHashTableIter iter;
+  const gchar *key;
+  FlushBatch *batch;
+  GPtrArray *keys;
+  GPtrArray *values;
+  GError *batch_error = NULL;
+  guint n;
+
+  /* only one flush at a time, the next one picks up the changes made meanwhile */
+  while (state->flushing)
+    g_cond_wait (&state->flush_cond, &state->lock);
+
+  batch = state->pending_batch;
+  state->pending_batch = NULL;
+
+  /* take a snapshot of the dirty keys so the store isn't locked while writing */
+  keys = g_ptr_array_new_with_free_func (g_free);
+  values = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+  g_mutex_lock (&state->store_lock);
+  g_hash_table_iter_init (&iter, state->dirty);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, NULL))
+    {
+      g_ptr_array_add (keys, g_strdup (key));
+      g_ptr_array_add (values, g_variant_ref (g_hash_table_lookup (state->cache, key)));
+    }
+  g_hash_table_remove_all (state->dirty);
+  g_mutex_unlock (&state->store_lock);
+
+  state->flushing = TRUE;
+  g_mutex_unlock (&state->lock);
+
+  for (n = 0; n < keys->len; n++)
+    {
+      GVariant *normalized;
+      GError *error = NULL;
+      gchar *path;
+      gchar *data;
+      gsize size;
+
+      key = g_ptr_array_index (keys, n);
+      normalized = g_variant_get_normal_form (g_ptr_array_index (values, n));
+      size = g_variant_get_size (normalized);
+      data = g_malloc (size);
+      g_variant_store (normalized, data);
+
+      path = get_path_for_key (key);
+      if (!g_file_set_contents (path, data, size, &error))
+        {
+          udisks_warning ("Error writing %s: %s (%s, %d)",
+                          path, error->message, g_quark_to_string (error->domain), error->code);
+          if (batch_error == NULL)
+            batch_error = error;
+          else
+            g_error_free (error);
+        }
+      else
+        {
+          WriteStats *stats;
+
+          g_mutex_lock (&state->store_lock);
+          stats = get_write_stats (state, key);
+          stats->num_writes++;
+          udisks_debug ("Wrote %s (%" G_GSIZE_FORMAT " bytes, %" G_GUINT64_FORMAT " writes for %" G_GUINT64_FORMAT " changes)",
+                        path, size, stats->num_writes, stats->num_sets);
+          g_mutex_unlock (&state->store_lock);
+        }
+
+      g_free (path);
+      g_free (data);
+      g_variant_unref (normalized);
+    }
+
+  g_ptr_array_unref (values);
+  g_ptr_array_unref (keys);
+
+  g_mutex_lock (&state->lock);
+  state->flushing = FALSE;
+  if (batch != NULL)
+    {
+      batch->done = TRUE;
+      batch->error = batch_error;
+      flush_batch_unref (batch);
+    }
+  else if (batch_error != NULL)
+    {
+      g_error_free (batch_error);
+    }
+  g_cond_broadcast (&state->flush_cond);
+}
+
+/* The new value is visible to udisks_state_get() right away. The
+ * call returns once the file for @key has been written and fails if
+ * that write failed.
+ *
+ * Changes made by other threads while a write is in progress are
+ * collected and written out together afterwards by whichever caller
+ * made the first of them. Must be called with @lock held - like
+ * g_cond_wait() it is released while waiting, so the caller must not
+ * rely on the state not having been changed by others meanwhile.
+ */
 static gboolean
 udisks_state_set (UDisksState          *state,
                   const gchar          *key,
@@ -2291,11 +2714,9 @@ udisks_state_set (UDisksState          *state,
                   GVariant             *value,
                   GError              **error)
 {
-  gboolean ret = FALSE;
-  gsize size = 0;
-  gchar *path = NULL;
-  gchar *data= NULL;
-  GVariant *normalized = NULL;
+  FlushBatch *batch;
+  gboolean is_leader = FALSE;
+  gboolean ret = TRUE;
 
   g_return_val_if_fail (UDISKS_IS_STATE (state), FALSE);
   g_return_val_if_fail (key != NULL, FALSE);
@@ -2304,36 +2725,77 @@ udisks_state_set (UDisksState          *state,
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
   g_variant_ref_sink (value);
-  normalized = g_variant_get_normal_form (value);
-  size = g_variant_get_size (normalized);
-  data = g_malloc (size);
-  g_variant_store (normalized, data);
 
-#ifdef HAVE_FHS_MEDIA
-  /* /media usually isn't on a tmpfs, so we need to make this persistant */
-  if (strcmp (key, "mounted-fs") == 0)
-    path = g_strdup_printf (PACKAGE_LOCALSTATE_DIR "/lib/udisks2/%s", key);
-  else
-#endif
-    path = g_strdup_printf ("/run/udisks2/%s", key);
+  g_mutex_lock (&state->store_lock);
+  g_hash_table_insert (state->cache, g_strdup (key), value); /* steals @value */
+  g_hash_table_add (state->dirty, g_strdup (key));
+  get_write_stats (state, key)->num_sets++;
+  g_mutex_unlock (&state->store_lock);
 
-  g_hash_table_insert (state->cache, g_strdup (path), g_variant_ref (value));
+  if (state->pending_batch == NULL)
+    {
+      state->pending_batch = g_slice_new0 (FlushBatch);
+      state->pending_batch->ref_count = 1; /* owned by the flush */
+      is_leader = TRUE;
+    }
+  batch = flush_batch_ref (state->pending_batch);
 
-  if (!g_file_set_contents (path,
-                            data,
-                            size,
-                            error))
-    goto out;
+  /* the first caller of a batch writes it out once the previous
+   * write has finished - others may join the batch until then
+   */
+  if (is_leader)
+    {
+      while (state->flushing && !batch->done)
+        g_cond_wait (&state->flush_cond, &state->lock);
+      if (!batch->done)
+        udisks_state_flush (state);
+    }
 
-  ret = TRUE;
+  while (!batch->done)
+    g_cond_wait (&state->flush_cond, &state->lock);
 
- out:
+  if (batch->error != NULL)
+    {
+      if (error != NULL)
+        *error = g_error_copy (batch->error);
+      ret = FALSE;
+    }
+  flush_batch_unref (batch);
 
-  g_free (path);
-  g_free (data);
-  g_variant_unref (normalized);
-  g_variant_unref (value);
   return ret;
 }
 
+/**
+ * udisks_state_get_write_stats:
+ * @state: A #UDisksState.
+ * @key: The state file, e.g. <literal>mounted-fs</literal>.
+ * @out_num_sets: (out allow-none): Return location for the number of times @key was changed or %NULL.
+ * @out_num_writes: (out allow-none): Return location for the number of times the file for @key was written or %NULL.
+ *
+ * Gets counters for how often the state file for @key was changed
+ * and how often it was actually written - changes made while a
+ * write is in progress are written out together.
+ *
+ * This is intended for debugging and benchmarking.
+ */
+void
+udisks_state_get_write_stats (UDisksState *state,
+                              const gchar *key,
+                              guint64     *out_num_sets,
+                              guint64     *out_num_writes)
+{
+  WriteStats *stats;
+
+  g_return_if_fail (UDISKS_IS_STATE (state));
+  g_return_if_fail (key != NULL);
+
+  g_mutex_lock (&state->store_lock);
+  stats = g_hash_table_lookup (state->write_stats, key);
+  if (out_num_sets != NULL)
+    *out_num_sets = stats != NULL ? stats->num_sets : 0;
+  if (out_num_writes != NULL)
+    *out_num_writes = stats != NULL ? stats->num_writes : 0;
+  g_mutex_unlock (&state->store_lock);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
@@ -35,6 +35,12 @@ UDisksDaemon  *udisks_state_get_daemon           (UDisksState   *state);
 void           udisks_state_start_cleanup        (UDisksState   *state);
 void           udisks_state_stop_cleanup         (UDisksState   *state);
 void           udisks_state_check                (UDisksState   *state);
+void           udisks_state_check_device         (UDisksState   *state,
+                                                  dev_t          dev);
+void           udisks_state_get_write_stats      (UDisksState   *state,
+                                                  const gchar   *key,
+                                                  guint64       *out_num_sets,
+                                                  guint64       *out_num_writes);
 /* mounted-fs */
 void           udisks_state_add_mounted_fs       (UDisksState   *state,
                                                   const gchar   *mount_point,
@@ -0,0 +1,78 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_TRACE_H__
+#define __UDISKS_TRACE_H__
+
+#include "config.h"
+
+/**
+ * SECTION:udiskstrace
+ * @title: Tracing
+ * @short_description: Static tracepoints
+ *
+ * When configured with <literal>--enable-sdt</literal>, the daemon
+ * contains static (USDT) tracepoints in the <literal>udisks</literal>
+ * provider that tools like bpftrace or SystemTap can attach to while
+ * it is running, e.g.
+ * <literal>bpftrace -e 'usdt:/usr/libexec/udisks2/udisksd:udisks:uevent_received { printf("%s %s\n", str(arg0), str(arg1)); }'</literal>.
+ * Otherwise the tracepoints compile to nothing.
+ *
+ * The following tracepoints exist:
+ * <itemizedlist>
+ *   <listitem><para><literal>uevent_received</literal> (action, sysfs path)</para></listitem>
+ *   <listitem><para><literal>probe_start</literal>, <literal>probe_end</literal> (action, sysfs path)</para></listitem>
+ *   <listitem><para><literal>uevent_stage_start</literal>, <literal>uevent_stage_end</literal> (stage, action, sysfs path)</para></listitem>
+ *   <listitem><para><literal>job_create</literal> (job object path, operation, started-by uid)</para></listitem>
+ *   <listitem><para><literal>job_complete</literal> (job object path, operation, success, message)</para></listitem>
+ *   <listitem><para><literal>spawned_job_spawn</literal> (command-line, pid)</para></listitem>
+ *   <listitem><para><literal>spawned_job_exit</literal> (command-line, pid, wait status)</para></listitem>
+ *   <listitem><para><literal>auth_check_start</literal> (action id, caller, object path)</para></listitem>
+ *   <listitem><para><literal>auth_check_end</literal> (action id, caller, object path, authorized)</para></listitem>
+ * </itemizedlist>
+ * Strings are passed as pointers, object paths may be %NULL.
+ */
+
+#ifdef HAVE_SDT
+#include <sys/sdt.h>
+#endif
+
+/**
+ * UDISKS_TRACE1:
+ * @name: The name of the tracepoint.
+ * @a1: The argument.
+ *
+ * Tracepoint with one argument, see also UDISKS_TRACE2(),
+ * UDISKS_TRACE3() and UDISKS_TRACE4(). The arguments are not
+ * evaluated unless tracepoints are enabled at compile time.
+ */
+#ifdef HAVE_SDT
+#define UDISKS_TRACE1(name, a1)                 DTRACE_PROBE1 (udisks, name, a1)
+#define UDISKS_TRACE2(name, a1, a2)             DTRACE_PROBE2 (udisks, name, a1, a2)
+#define UDISKS_TRACE3(name, a1, a2, a3)         DTRACE_PROBE3 (udisks, name, a1, a2, a3)
+#define UDISKS_TRACE4(name, a1, a2, a3, a4)     DTRACE_PROBE4 (udisks, name, a1, a2, a3, a4)
+#else
+#define UDISKS_TRACE1(name, a1)                 do { } while (0)
+#define UDISKS_TRACE2(name, a1, a2)             do { } while (0)
+#define UDISKS_TRACE3(name, a1, a2, a3)         do { } while (0)
+#define UDISKS_TRACE4(name, a1, a2, a3, a4)     do { } while (0)
+#endif
+
+#endif /* __UDISKS_TRACE_H__ */